@@ -0,0 +1,176 @@
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include "Bench.h"
+
+namespace {
+   // every scenario gets its own location, a closing socket may still hold the last one
+   size_t gScenarios = 0;
+   const int kFirstTcpPort = 16000;
+   const int kTcpPorts = 8000;
+}
+
+/**
+ * @param scenario
+ *   Reported with the results
+ */
+Bench::Bench(const Scenario& scenario) :
+mScenario(scenario),
+mStart(0),
+mStop(0),
+mSent(0),
+mReceived(0),
+mBytes(0),
+mSorted(false) {
+   mLatencies.reserve(scenario.messages);
+}
+
+Bench::~Bench() {
+}
+
+/**
+ * @return a monotonic time in nanoseconds
+ */
+uint64_t Bench::Now() {
+   using namespace std::chrono;
+   return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Write the time of sending at the front of a message
+ * @param message
+ *   At least kStampBytes long
+ */
+void Bench::Stamp(void* message) {
+   const uint64_t now = Now();
+   memcpy(message, &now, sizeof (now));
+}
+
+/**
+ * @param message
+ * @param size
+ * @return
+ *   The nanoseconds since the message was stamped, 0 if it is too short
+ */
+uint64_t Bench::Stamped(const void* message, const size_t size) {
+   uint64_t stamp = 0;
+   if (size < kStampBytes) {
+      return 0;
+   }
+   memcpy(&stamp, message, sizeof (stamp));
+   return Now() - stamp;
+}
+
+/**
+ * @param scenario
+ * @return
+ *   A location of the scenario transport no other scenario used
+ */
+std::string Bench::Location(const Scenario& scenario) {
+   const size_t id = gScenarios++;
+   std::ostringstream location;
+   if (scenario.transport == "tcp") {
+      location << "tcp://127.0.0.1:" << kFirstTcpPort + (getpid() + id) % kTcpPorts;
+   } else if (scenario.transport == "ipc") {
+      location << "ipc:///tmp/qn_bench_" << scenario.pattern << "_" << getpid() << "_" << id << ".ipc";
+   } else {
+      location << "inproc://qn_bench_" << scenario.pattern << "_" << id;
+   }
+   return location.str();
+}
+
+/**
+ * The first message is sent now
+ */
+void Bench::Start() {
+   mStart = Now();
+}
+
+/**
+ * Called by the sending thread only
+ */
+void Bench::Sent() {
+   mSent++;
+}
+
+/**
+ * Called by the receiving thread only
+ * @param bytes
+ * @param latencyNs
+ */
+void Bench::Received(const size_t bytes, const uint64_t latencyNs) {
+   mReceived++;
+   mBytes += bytes;
+   mLatencies.push_back(latencyNs);
+   mStop = Now();
+}
+
+/**
+ * Nothing more will be received, the end of the run is the last receive
+ */
+void Bench::Stop() {
+   if (mStop == 0) {
+      mStop = Now();
+   }
+}
+
+/**
+ * @param reason
+ *   Why the pattern can't run the scenario
+ */
+void Bench::Skip(const std::string& reason) {
+   mSkipped = reason;
+}
+
+size_t Bench::Received() const {
+   return mReceived;
+}
+
+/**
+ * @param percentile
+ *   0 to 100
+ * @return
+ *   The latency in nanoseconds, 0 without messages
+ */
+uint64_t Bench::LatencyPercentile(const double percentile) {
+   if (mLatencies.empty()) {
+      return 0;
+   }
+   if (!mSorted) {
+      std::sort(mLatencies.begin(), mLatencies.end());
+      mSorted = true;
+   }
+   const size_t rank = static_cast<size_t> (percentile / 100 * (mLatencies.size() - 1) + 0.5);
+   return mLatencies[std::min(rank, mLatencies.size() - 1)];
+}
+
+/**
+ * @return one JSON object with the scenario and its results
+ */
+std::string Bench::ToJson() {
+   std::ostringstream json;
+   json << "{\"pattern\":\"" << mScenario.pattern << "\""
+           << ",\"transport\":\"" << mScenario.transport << "\""
+           << ",\"bytes\":" << mScenario.bytes
+           << ",\"io_threads\":" << mScenario.ioThreads
+           << ",\"hwm\":" << mScenario.hwm;
+   if (!mSkipped.empty()) {
+      json << ",\"skipped\":\"" << mSkipped << "\"}";
+      return json.str();
+   }
+   const double seconds = (mStop > mStart ? mStop - mStart : 1) / 1e9;
+   json << ",\"sent\":" << mSent
+           << ",\"received\":" << mReceived
+           << ",\"seconds\":" << seconds
+           << ",\"msgs_per_sec\":" << static_cast<uint64_t> (mReceived / seconds)
+           << ",\"mb_per_sec\":" << mBytes / seconds / (1024 * 1024)
+           << ",\"latency_ns\":{\"p50\":" << LatencyPercentile(50)
+           << ",\"p90\":" << LatencyPercentile(90)
+           << ",\"p99\":" << LatencyPercentile(99)
+           << ",\"p999\":" << LatencyPercentile(99.9)
+           << ",\"max\":" << LatencyPercentile(100)
+           << "}}";
+   return json.str();
+}
@@ -0,0 +1,69 @@
+/*
+ * File:   Bench.h
+ *
+ * What qn_bench measures for one scenario and how it reports it.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * One run of a pattern: the transport, message size and socket settings.
+ * ioThreads and hwm of 0 keep the default of the endpoint, patterns that
+ * can't change them are only run with 0.
+ */
+struct Scenario {
+   std::string pattern;
+   std::string transport;
+   size_t bytes;
+   int ioThreads;
+   int hwm;
+   size_t messages;
+};
+
+/**
+ * Throughput is counted from the first send to the last receive. Latency
+ * is one way for the queues, the sender stamps every message with the
+ * time it was sent, and the round trip for request reply patterns.
+ *
+ * A scenario the pattern can't run, i.e. inproc between endpoints that
+ * each own a ZeroMQ context, is reported as skipped with the reason.
+ */
+class Bench {
+public:
+   explicit Bench(const Scenario& scenario);
+   virtual ~Bench();
+
+   static uint64_t Now();
+   static void Stamp(void* message);
+   static uint64_t Stamped(const void* message, const size_t size);
+   static std::string Location(const Scenario& scenario);
+
+   void Start();
+   void Sent();
+   void Received(const size_t bytes, const uint64_t latencyNs);
+   void Stop();
+   void Skip(const std::string& reason);
+
+   size_t Received() const;
+   uint64_t LatencyPercentile(const double percentile);
+   std::string ToJson();
+
+   static const size_t kStampBytes = sizeof (uint64_t);
+
+private:
+   Bench(const Bench&) = delete;
+   Bench& operator=(const Bench&) = delete;
+
+   const Scenario mScenario;
+   std::string mSkipped;
+   uint64_t mStart;
+   uint64_t mStop;
+   size_t mSent;
+   size_t mReceived;
+   uint64_t mBytes;
+   std::vector<uint64_t> mLatencies;
+   bool mSorted;
+};
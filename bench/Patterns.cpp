@@ -0,0 +1,280 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <czmq.h>
+#include "Patterns.h"
+#include "Rifle.h"
+#include "Vampire.h"
+#include "Shotgun.h"
+#include "Alien.h"
+#include "Crowbar.h"
+#include "Headcrab.h"
+#include "BoomStick.h"
+#include "Kraken.h"
+#include "Harpoon.h"
+#include "QAPI.h"
+
+namespace {
+   // a receiver gives up after this long without messages, i.e. when a Shotgun dropped some
+   const int kIdleMs = 1000;
+   // time for an Alien subscription to reach the Shotgun
+   const int kSubscribeMs = 200;
+   const size_t kDefaultQueueSize = 1000;
+   const int kPollMs = 100;
+
+   /**
+    * A ROUTER sending every request back as the reply, what a BoomStick
+    * expects of its Skelleton
+    */
+   void Echo(const std::string& location, std::atomic<bool>& bound, std::atomic<bool>& stop) {
+      zctx_t* context = zctx_new();
+      void* face = zsocket_new(context, ZMQ_ROUTER);
+      bound = (zsocket_bind(face, location.c_str()) >= 0);
+      while (bound && !stop && !zctx_interrupted) {
+         if (zsocket_poll(face, kPollMs)) {
+            zmsg_t* msg = zmsg_recv(face);
+            if (msg) {
+               zmsg_send(&msg, face);
+            }
+         }
+      }
+      zctx_destroy(&context);
+   }
+}
+
+/**
+ * PUSH to PULL, one way latency
+ */
+void Patterns::RifleVampire(const Scenario& scenario, Bench& bench) {
+   if (scenario.transport == "inproc") {
+      bench.Skip("a Rifle and a Vampire each own a context");
+      return;
+   }
+   const std::string location = Bench::Location(scenario);
+   Rifle rifle(location);
+   Vampire vampire(location);
+   if (scenario.hwm > 0) {
+      rifle.SetHighWater(scenario.hwm);
+      vampire.SetHighWater(scenario.hwm);
+   }
+   if (scenario.ioThreads > 0) {
+      rifle.SetIOThreads(scenario.ioThreads);
+      vampire.SetIOThreads(scenario.ioThreads);
+   }
+   if (!rifle.Aim() || !vampire.PrepareToBeShot()) {
+      bench.Skip("can't use " + location);
+      return;
+   }
+   auto received = std::async(std::launch::async, [&scenario, &bench, &vampire]() {
+      std::string wound;
+      while (bench.Received() < scenario.messages && vampire.GetShot(wound, kIdleMs)) {
+         bench.Received(wound.size(), Bench::Stamped(wound.data(), wound.size()));
+      }
+   });
+   std::string bullet(scenario.bytes, 'a');
+   bench.Start();
+   for (size_t message = 0; message < scenario.messages && !zctx_interrupted; ++message) {
+      Bench::Stamp(&bullet[0]);
+      if (rifle.Fire(bullet)) {
+         bench.Sent();
+      }
+   }
+   received.wait();
+   bench.Stop();
+}
+
+/**
+ * PUB to SUB, one way latency. Messages beyond the high water mark are
+ * dropped by the Shotgun, received can be less than sent.
+ */
+void Patterns::ShotgunAlien(const Scenario& scenario, Bench& bench) {
+   if (scenario.transport == "inproc") {
+      bench.Skip("a Shotgun and an Alien each own a context");
+      return;
+   }
+   const std::string location = Bench::Location(scenario);
+   Shotgun shotgun;
+   Alien alien;
+   try {
+      shotgun.Aim(location);
+      alien.PrepareToBeShot(location);
+   } catch (const std::string& error) {
+      bench.Skip(error);
+      return;
+   }
+   std::this_thread::sleep_for(std::chrono::milliseconds(kSubscribeMs));
+   auto received = std::async(std::launch::async, [&scenario, &bench, &alien]() {
+      Alien::Shot shot;
+      while (bench.Received() < scenario.messages && alien.GetShot(kIdleMs, shot)) {
+         if (shot.Size() > 0) {
+            bench.Received(shot.Bullet(0).size(), Bench::Stamped(shot.Bullet(0).data(), shot.Bullet(0).size()));
+         }
+         shot.Clear();
+      }
+   });
+   std::vector<std::string> bullets(1, std::string(scenario.bytes, 'a'));
+   bench.Start();
+   for (size_t message = 0; message < scenario.messages && !zctx_interrupted; ++message) {
+      Bench::Stamp(&bullets[0][0]);
+      shotgun.Fire(bullets);
+      bench.Sent();
+   }
+   received.wait();
+   bench.Stop();
+}
+
+/**
+ * REQ to REP with the Headcrab sending every hit back, round trip latency.
+ * Over inproc the Crowbar shares the context of the Headcrab.
+ */
+void Patterns::CrowbarHeadcrab(const Scenario& scenario, Bench& bench) {
+   const std::string location = Bench::Location(scenario);
+   Headcrab headcrab(location);
+   if (!headcrab.ComeToLife()) {
+      bench.Skip("can't bind " + location);
+      return;
+   }
+   std::unique_ptr<Crowbar> crowbar(scenario.transport == "inproc" ?
+           new Crowbar(headcrab) : new Crowbar(location));
+   if (!crowbar->Wield()) {
+      bench.Skip("can't connect " + location);
+      return;
+   }
+   auto splattered = std::async(std::launch::async, [&scenario, &headcrab]() {
+      std::string hit;
+      for (size_t message = 0; message < scenario.messages && headcrab.GetHitWait(hit, kIdleMs); ++message) {
+         headcrab.SendSplatter(hit);
+      }
+   });
+   const std::string hit(scenario.bytes, 'a');
+   std::string gut;
+   bench.Start();
+   for (size_t message = 0; message < scenario.messages && !zctx_interrupted; ++message) {
+      const uint64_t start = Bench::Now();
+      if (!crowbar->Swing(hit)) {
+         break;
+      }
+      bench.Sent();
+      if (!crowbar->WaitForKill(gut, kIdleMs)) {
+         break;
+      }
+      bench.Received(gut.size(), Bench::Now() - start);
+   }
+   splattered.wait();
+   bench.Stop();
+}
+
+/**
+ * DEALER to a ROUTER echoing every request, round trip latency
+ */
+void Patterns::BoomStickEcho(const Scenario& scenario, Bench& bench) {
+   if (scenario.transport == "inproc") {
+      bench.Skip("a BoomStick owns its context");
+      return;
+   }
+   const std::string location = Bench::Location(scenario);
+   std::atomic<bool> bound(false);
+   std::atomic<bool> stop(false);
+   std::thread echo(Echo, location, std::ref(bound), std::ref(stop));
+   BoomStick stick(location);
+   if (scenario.hwm > 0) {
+      stick.SetSendHWM(scenario.hwm);
+      stick.SetRecvHWM(scenario.hwm);
+   }
+   if (stick.Initialize()) {
+      // the echo frames are C strings
+      const std::string command(scenario.bytes, 'a');
+      bench.Start();
+      for (size_t message = 0; message < scenario.messages && !zctx_interrupted; ++message) {
+         const uint64_t start = Bench::Now();
+         bench.Sent();
+         const std::string reply = stick.Send(command);
+         if (reply.empty()) {
+            break;
+         }
+         bench.Received(reply.size(), Bench::Now() - start);
+      }
+      bench.Stop();
+   }
+   stop = true;
+   echo.join();
+   if (!bound) {
+      bench.Skip("can't bind " + location);
+   }
+}
+
+/**
+ * Chunks sent by the Kraken as the Harpoon asks for them, one way latency
+ */
+void Patterns::KrakenHarpoon(const Scenario& scenario, Bench& bench) {
+   if (scenario.transport == "inproc") {
+      bench.Skip("a Kraken and a Harpoon each own a context");
+      return;
+   }
+   const std::string location = Bench::Location(scenario);
+   Kraken kraken;
+   kraken.MaxWaitInMs(kIdleMs);
+   if (kraken.SetLocation(location) != Kraken::Spear::IMPALED) {
+      bench.Skip("can't bind " + location);
+      return;
+   }
+   Harpoon harpoon;
+   harpoon.MaxWaitInMs(kIdleMs);
+   if (harpoon.Aim(location) != Harpoon::Spear::IMPALED) {
+      bench.Skip("can't connect " + location);
+      return;
+   }
+   auto received = std::async(std::launch::async, [&bench, &harpoon]() {
+      std::vector<uint8_t> chunk;
+      while (harpoon.Heave(chunk) == Harpoon::Battling::CONTINUE) {
+         bench.Received(chunk.size(), Bench::Stamped(chunk.data(), chunk.size()));
+      }
+   });
+   Kraken::Chunks chunk(scenario.bytes, 'a');
+   bench.Start();
+   for (size_t message = 0; message < scenario.messages && !zctx_interrupted; ++message) {
+      Bench::Stamp(chunk.data());
+      if (kraken.SendTidalWave(chunk) != Kraken::Battling::CONTINUE) {
+         break;
+      }
+      bench.Sent();
+   }
+   kraken.FinalBreach();
+   received.wait();
+   bench.Stop();
+}
+
+/**
+ * A lock free single producer single consumer queue between two threads,
+ * one way latency. The high water mark is the queue size.
+ */
+void Patterns::QueueSpsc(const Scenario& scenario, Bench& bench) {
+   if (scenario.transport != "inproc") {
+      bench.Skip("QAPI queues are in process");
+      return;
+   }
+   using QType = spsc::flexible::circular_fifo<std::string>;
+   auto queue = QAPI::CreateQueue<QType>(scenario.hwm > 0 ? scenario.hwm : kDefaultQueueSize);
+   auto& sender = std::get<QAPI::index::sender>(queue);
+   auto& receiver = std::get<QAPI::index::receiver>(queue);
+   auto received = std::async(std::launch::async, [&scenario, &bench, &receiver]() {
+      std::string item;
+      while (bench.Received() < scenario.messages &&
+              receiver.wait_and_pop(item, std::chrono::milliseconds(kIdleMs))) {
+         bench.Received(item.size(), Bench::Stamped(item.data(), item.size()));
+      }
+   });
+   bench.Start();
+   for (size_t message = 0; message < scenario.messages && !zctx_interrupted; ++message) {
+      std::string item(scenario.bytes, 'a');
+      Bench::Stamp(&item[0]);
+      while (!sender.push(item)) {
+         std::this_thread::yield();
+      }
+      bench.Sent();
+   }
+   received.wait();
+   bench.Stop();
+}
@@ -0,0 +1,19 @@
+/*
+ * File:   Patterns.h
+ *
+ * One qn_bench run per messaging pattern. Each sends scenario.messages
+ * messages of scenario.bytes from one endpoint to the other and records
+ * them in the Bench, or skips a scenario the pattern can't run.
+ */
+#pragma once
+
+#include "Bench.h"
+
+namespace Patterns {
+   void RifleVampire(const Scenario& scenario, Bench& bench);
+   void ShotgunAlien(const Scenario& scenario, Bench& bench);
+   void CrowbarHeadcrab(const Scenario& scenario, Bench& bench);
+   void BoomStickEcho(const Scenario& scenario, Bench& bench);
+   void KrakenHarpoon(const Scenario& scenario, Bench& bench);
+   void QueueSpsc(const Scenario& scenario, Bench& bench);
+}
@@ -0,0 +1,147 @@
+/*
+ * qn_bench: throughput and latency of every QueueNado pattern across
+ * transports, message sizes, IO threads and high water marks, as JSON.
+ *
+ *    qn_bench [--patterns rifle,shotgun,crowbar,boomstick,kraken,qapi]
+ *             [--transports inproc,ipc,tcp] [--sizes 64,1024,65536]
+ *             [--io-threads 1,2] [--hwm 1000,100000] [--messages 100000]
+ *
+ * Every option takes a comma separated list, every combination a pattern
+ * supports is run. Warnings go to a log file in /tmp, stdout is only JSON.
+ */
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <g3log/logworker.hpp>
+#include <g3log/g3log.hpp>
+#include <g3log/std2_make_unique.hpp>
+#include <g3sinks/LogRotate.h>
+#include "Bench.h"
+#include "Patterns.h"
+
+namespace {
+   typedef void (*Run)(const Scenario&, Bench&);
+
+   struct Pattern {
+      const char* name;
+      Run run;
+      // the knobs the pattern can change, the others are only run with the default
+      bool ioThreads;
+      bool hwm;
+   };
+
+   const Pattern kPatterns[] = {
+      {"rifle", Patterns::RifleVampire, true, true},
+      {"shotgun", Patterns::ShotgunAlien, false, false},
+      {"crowbar", Patterns::CrowbarHeadcrab, false, false},
+      {"boomstick", Patterns::BoomStickEcho, false, true},
+      {"kraken", Patterns::KrakenHarpoon, false, false},
+      {"qapi", Patterns::QueueSpsc, false, true},
+   };
+
+   std::vector<std::string> Split(const std::string& list) {
+      std::vector<std::string> items;
+      std::istringstream stream(list);
+      std::string item;
+      while (std::getline(stream, item, ',')) {
+         if (!item.empty()) {
+            items.push_back(item);
+         }
+      }
+      return items;
+   }
+
+   std::vector<int> Numbers(const std::string& list) {
+      std::vector<int> numbers;
+      for (const auto& item : Split(list)) {
+         numbers.push_back(atoi(item.c_str()));
+      }
+      return numbers;
+   }
+
+   void Usage(const char* name) {
+      std::cerr << "usage: " << name << " [--patterns rifle,shotgun,crowbar,boomstick,kraken,qapi]"
+              << " [--transports inproc,ipc,tcp] [--sizes 64,1024,65536]"
+              << " [--io-threads 1,2] [--hwm 1000,100000] [--messages 100000]" << std::endl;
+   }
+}
+
+int main(int argc, char* argv[]) {
+   std::vector<std::string> patterns;
+   for (const auto& pattern : kPatterns) {
+      patterns.push_back(pattern.name);
+   }
+   std::vector<std::string> transports = {"inproc", "ipc", "tcp"};
+   std::vector<int> sizes = {64, 1024, 65536};
+   std::vector<int> ioThreads = {1, 2};
+   std::vector<int> hwms = {1000, 100000};
+   size_t messages = 100000;
+
+   for (int arg = 1; arg < argc; ++arg) {
+      const std::string option = argv[arg];
+      if (arg + 1 == argc) {
+         Usage(argv[0]);
+         return 1;
+      }
+      const std::string value = argv[++arg];
+      if (option == "--patterns") {
+         patterns = Split(value);
+      } else if (option == "--transports") {
+         transports = Split(value);
+      } else if (option == "--sizes") {
+         sizes = Numbers(value);
+      } else if (option == "--io-threads") {
+         ioThreads = Numbers(value);
+      } else if (option == "--hwm") {
+         hwms = Numbers(value);
+      } else if (option == "--messages") {
+         messages = strtoul(value.c_str(), NULL, 10);
+      } else {
+         Usage(argv[0]);
+         return 1;
+      }
+   }
+
+   std::stringstream fileName;
+   fileName << "qn_bench" << geteuid();
+   auto logger = g3::LogWorker::createLogWorker();
+   auto handle = logger->addSink(std2::make_unique<LogRotate>(fileName.str(), "/tmp/"), &LogRotate::save);
+   g3::initializeLogging(logger.get());
+   std::cerr << "Logging to: " << handle->call(&LogRotate::logFileName).get() << std::endl;
+
+   std::cout << "{\"benchmarks\":[";
+   bool first = true;
+   for (const auto& name : patterns) {
+      const Pattern* pattern = std::find_if(std::begin(kPatterns), std::end(kPatterns),
+              [&name](const Pattern & candidate) {
+                 return name == candidate.name;
+              });
+      if (pattern == std::end(kPatterns)) {
+         std::cerr << "unknown pattern " << name << std::endl;
+         continue;
+      }
+      const std::vector<int> threads = pattern->ioThreads ? ioThreads : std::vector<int>(1, 0);
+      const std::vector<int> marks = pattern->hwm ? hwms : std::vector<int>(1, 0);
+      for (const auto& transport : transports) {
+         for (const auto size : sizes) {
+            for (const auto thread : threads) {
+               for (const auto hwm : marks) {
+                  const size_t bytes = std::max<size_t>(size, Bench::kStampBytes);
+                  const Scenario scenario = {pattern->name, transport, bytes, thread, hwm, messages};
+                  Bench bench(scenario);
+                  pattern->run(scenario, bench);
+                  std::cout << (first ? "\n" : ",\n") << bench.ToJson() << std::flush;
+                  first = false;
+               }
+            }
+         }
+      }
+   }
+   std::cout << "\n]}" << std::endl;
+   return 0;
+}
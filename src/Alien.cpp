@@ -4,11 +4,18 @@
 #include "g3log/g3log.hpp"
 
 #include "Alien.h"
+#include "CZMQToolkit.h"
+
+namespace {
+   // bound the draining so a Shotgun firing faster than we read cannot
+   // keep us from ever returning a shot
+   const int kMaxConflateDrain = 32 * 1024;
+}
 
 /**
  * Alien is a ZeroMQ Sub socket.
  */
-Alien::Alien() {
+Alien::Alien() : mSubscribedToAll(false), mConflate(false) {
    mCtx = zctx_new();
    CHECK(mCtx);
    mBody = zsocket_new(mCtx, ZMQ_SUB);
@@ -20,9 +27,11 @@ Alien::Alien() {
  * @param location
  */
 void Alien::PrepareToBeShot(const std::string& location) {
-   //Subscribe to everything
-   char dummy = '\0';
-   zsocket_set_subscribe(mBody, &dummy);
+   //Subscribe to everything unless told what topics to listen to
+   if (mSubscriptions.empty() && !mSubscribedToAll) {
+      zmq_setsockopt(mBody, ZMQ_SUBSCRIBE, "", 0);
+      mSubscribedToAll = true;
+   }
    zsocket_set_rcvhwm(mBody, 32 * 1024);
    zsocket_set_sndhwm(mBody, 32 * 1024);
    int rc = zsocket_connect(mBody, location.c_str());
@@ -33,6 +42,64 @@ void Alien::PrepareToBeShot(const std::string& location) {
    }
 }
 
+/**
+ * Only receive messages fired with a topic starting with the prefix. The
+ * filtering is done by the Shotgun so unwanted messages never reach us.
+ * Can be called before or after PrepareToBeShot and any number of times.
+ * @param prefix
+ */
+void Alien::Subscribe(const std::string& prefix) {
+   if (mSubscribedToAll) {
+      zmq_setsockopt(mBody, ZMQ_UNSUBSCRIBE, "", 0);
+      mSubscribedToAll = false;
+   }
+   if (mSubscriptions.insert(prefix).second) {
+      zmq_setsockopt(mBody, ZMQ_SUBSCRIBE, prefix.data(), prefix.size());
+   }
+}
+
+/**
+ * Stop receiving messages for a prefix given to Subscribe.
+ * @param prefix
+ */
+void Alien::Unsubscribe(const std::string& prefix) {
+   if (mSubscriptions.erase(prefix) > 0) {
+      zmq_setsockopt(mBody, ZMQ_UNSUBSCRIBE, prefix.data(), prefix.size());
+   }
+}
+
+/**
+ * Only keep the newest message per topic. Every time we get shot all the
+ * messages that are waiting are read and older messages on the same topic
+ * are dropped, a slow Alien then catches up with the current state of every
+ * topic instead of working through a backlog of stale updates.
+ *
+ * ZMQ_CONFLATE can not be used since it does not support multipart messages
+ * and would keep only one message over all topics.
+ * @param conflate
+ */
+void Alien::SetConflate(const bool conflate) {
+   mConflate = conflate;
+}
+
+/**
+ * The edge triggered file descriptor of the body, for an external event
+ * loop. See CZMQToolkit::GetFileDescriptor, when it fires keep getting shot
+ * while IsReadable.
+ * @return the descriptor
+ */
+int Alien::GetFileDescriptor() const {
+   return CZMQToolkit::GetFileDescriptor(mBody);
+}
+
+/**
+ * @return if a shot is waiting, including conflated shots already read
+ *   off the socket
+ */
+bool Alien::IsReadable() const {
+   return !mConflatedOrder.empty() || CZMQToolkit::IsReadable(mBody);
+}
+
 /**
  * Blocking call that returns when the alien has been shot.
  * @return 
@@ -54,46 +121,169 @@ std::vector<std::string> Alien::GetShot() {
  * @return 
  */
 void Alien::GetShot(const unsigned int timeout, std::vector<std::string>& bullets) {
+   std::string topic;
+   GetShot(timeout, topic, bullets);
+}
+
+/**
+ * Blocking call that returns when the alien has been shot.
+ * @param timeout
+ * @param topic
+ *   The topic the message was fired with
+ * @param bullets
+ */
+void Alien::GetShot(const unsigned int timeout, std::string& topic, std::vector<std::string>& bullets) {
    bullets.clear();
+   topic.clear();
+   if (GetShot(timeout, mShot)) {
+      topic.assign(mShot.Topic().data(), mShot.Topic().size());
+      bullets.reserve(mShot.Size());
+      for (size_t i = 0; i < mShot.Size(); i++) {
+         bullets.emplace_back(mShot.Bullet(i).data(), mShot.Bullet(i).size());
+      }
+      mShot.Clear();
+   }
+}
+
+/**
+ * Get shot without copying the message, the frames are kept in the shot
+ * until it is reused.
+ * @param timeout
+ * @param shot
+ *   Cleared, then filled with the received message
+ * @return
+ *   If a valid message was received
+ */
+bool Alien::GetShot(const unsigned int timeout, Shot& shot) {
+   shot.Clear();
    if (!mBody) {
       LOG(WARNING) << "Alien attempted to GetShot but is not properly initialized";
-      return;
+      return false;
    }
 
-   if (zsocket_poll(mBody, timeout)) {
-      zmsg_t* msg = zmsg_recv(mBody);
-      if (msg && zmsg_size(msg) >= 2) {
-         zframe_t* data = zmsg_pop(msg);
-         if (data) {
-            //remove the first frame
-            zframe_destroy(&data);
-         }
-         int msgSize = zmsg_size(msg);
-         for (int i = 0; i < msgSize; i++) {
-            data = zmsg_pop(msg);
-            if (data) {
-               std::string bullet;
-               bullet.assign(reinterpret_cast<char*> (zframe_data(data)), zframe_size(data));
-               bullets.push_back(bullet);
-               zframe_destroy(&data);
-            }
-         }
-      } else {
-         if (msg) {
-            LOG(WARNING) << "Got Invalid bullet of size: " << zmsg_size(msg);
+   zmsg_t* msg = NULL;
+   if (mConflate) {
+      if (!mConflatedOrder.empty() || zsocket_poll(mBody, timeout)) {
+         Conflate();
+      }
+      msg = NextConflated();
+   } else if (zsocket_poll(mBody, timeout)) {
+      msg = zmsg_recv(mBody);
+   }
+   if (msg) {
+      if (zmsg_size(msg) >= 2) {
+         //the first frame is the topic
+         for (zframe_t* frame = zmsg_first(msg); frame != NULL; frame = zmsg_next(msg)) {
+            shot.mFrames.push_back(frame);
          }
+         shot.mMessage = msg;
+         return true;
+      } 
+      LOG(WARNING) << "Got Invalid bullet of size: " << zmsg_size(msg);
+      zmsg_destroy(&msg);
+   }
+   return false;
+}
+
+/**
+ * Read every waiting message, replacing any older message held for the
+ * same topic. Topics keep the order in which they first arrived.
+ */
+void Alien::Conflate() {
+   for (int i = 0; i < kMaxConflateDrain && zsocket_poll(mBody, 0); i++) {
+      zmsg_t* msg = zmsg_recv(mBody);
+      if (!msg) {
+         break;
       }
-      if (msg) {
-         zmsg_destroy(&msg);
+      zframe_t* key = zmsg_first(msg);
+      std::string topic;
+      if (key) {
+         topic.assign(reinterpret_cast<const char*> (zframe_data(key)), zframe_size(key));
+      }
+      auto held = mConflated.find(topic);
+      if (held != mConflated.end()) {
+         zmsg_destroy(&held->second);
+         held->second = msg;
+      } else {
+         mConflated[topic] = msg;
+         mConflatedOrder.push_back(topic);
       }
    }
+}
 
+/**
+ * @return the newest message of the topic waiting the longest, NULL if no
+ *   message is held
+ */
+zmsg_t* Alien::NextConflated() {
+   if (mConflatedOrder.empty()) {
+      return NULL;
+   }
+   auto held = mConflated.find(mConflatedOrder.front());
+   mConflatedOrder.pop_front();
+   zmsg_t* msg = held->second;
+   mConflated.erase(held);
+   return msg;
+}
+
+Alien::Shot::Shot() : mMessage(NULL) {
+}
+
+Alien::Shot::~Shot() {
+   Clear();
+}
+
+/**
+ * @return if no message is held
+ */
+bool Alien::Shot::Empty() const {
+   return mFrames.empty();
+}
+
+/**
+ * @return the number of bullets, the topic not included
+ */
+size_t Alien::Shot::Size() const {
+   return mFrames.empty() ? 0 : mFrames.size() - 1;
+}
+
+/**
+ * @return the topic the message was fired with
+ */
+boost::string_ref Alien::Shot::Topic() const {
+   if (mFrames.empty()) {
+      return boost::string_ref();
+   }
+   return boost::string_ref(reinterpret_cast<const char*> (zframe_data(mFrames[0])), zframe_size(mFrames[0]));
+}
+
+/**
+ * @param index
+ *   Must be less than Size()
+ * @return a view of the bullet's data
+ */
+boost::string_ref Alien::Shot::Bullet(const size_t index) const {
+   zframe_t* frame = mFrames[index + 1];
+   return boost::string_ref(reinterpret_cast<const char*> (zframe_data(frame)), zframe_size(frame));
+}
+
+/**
+ * Release the message, the capacity for frames is kept for the next shot
+ */
+void Alien::Shot::Clear() {
+   mFrames.clear();
+   if (mMessage) {
+      zmsg_destroy(&mMessage);
+   }
 }
 
 /**
  * Destroy the body and context of the alien.
  */
 Alien::~Alien() {
+   for (auto& held : mConflated) {
+      zmsg_destroy(&held.second);
+   }
    zsocket_destroy(mCtx, mBody);
    zctx_destroy(&mCtx);
 }
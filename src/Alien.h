@@ -2,19 +2,66 @@
 
 
 #include <stdlib.h>
+#include <deque>
+#include <map>
+#include <set>
 #include <vector>
 #include <string>
+#include <boost/utility/string_ref.hpp>
 struct _zctx_t;
 typedef struct _zctx_t zctx_t;
+struct _zmsg_t;
+typedef struct _zmsg_t zmsg_t;
+struct _zframe_t;
+typedef struct _zframe_t zframe_t;
 class Alien {
 public:
+   /**
+    * A received message that is read in place. The views returned by Topic
+    * and Bullet point straight into the ZeroMQ frames and are only valid
+    * until the Shot is cleared, reused or destroyed.
+    */
+   class Shot {
+   public:
+      Shot();
+      ~Shot();
+      bool Empty() const;
+      size_t Size() const;
+      boost::string_ref Topic() const;
+      boost::string_ref Bullet(const size_t index) const;
+      void Clear();
+   private:
+      friend class Alien;
+      Shot(const Shot&) = delete;
+      Shot& operator=(const Shot&) = delete;
+      zmsg_t* mMessage;
+      std::vector<zframe_t*> mFrames;
+   };
+
    Alien();
    void PrepareToBeShot(const std::string& location);
+   void Subscribe(const std::string& prefix);
+   void Unsubscribe(const std::string& prefix);
+   void SetConflate(const bool conflate);
    std::vector<std::string> GetShot();
    void GetShot(const unsigned int timeout, std::vector<std::string>& bullets);
+   void GetShot(const unsigned int timeout, std::string& topic, std::vector<std::string>& bullets);
+   bool GetShot(const unsigned int timeout, Shot& shot);
+   int GetFileDescriptor() const;
+   bool IsReadable() const;
    virtual ~Alien();
     
 private:
+   friend class Poller;
+   void Conflate();
+   zmsg_t* NextConflated();
+
    void *mBody;
    zctx_t *mCtx;
+   std::set<std::string> mSubscriptions;
+   bool mSubscribedToAll;
+   Shot mShot;
+   bool mConflate;
+   std::map<std::string, zmsg_t*> mConflated;
+   std::deque<std::string> mConflatedOrder;
 };
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include <chrono>
 #include "QueueNadoMacros.h"
 #include "BoomStick.h"
+#include "CZMQToolkit.h"
 namespace {
 
    void ShrinkToFit(std::map<std::string, std::string>& map) {
@@ -68,6 +69,23 @@ zctx_t* BoomStick::GetContext() {
    return mCtx;
 }
 
+/**
+ * The edge triggered file descriptor of the chamber, see
+ * CZMQToolkit::GetFileDescriptor. Replies that were already read are kept
+ * in the unread cache and do not show up on the descriptor.
+ * @return the descriptor, -1 before Initialize
+ */
+int BoomStick::GetFileDescriptor() const {
+   return CZMQToolkit::GetFileDescriptor(mChamber);
+}
+
+/**
+ * @return if a reply is waiting on the chamber
+ */
+bool BoomStick::IsReadable() const {
+   return CZMQToolkit::IsReadable(mChamber);
+}
+
 /**
  * Swap internals
  * @param other
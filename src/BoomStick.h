@@ -23,6 +23,8 @@ public:
    void SetSendHWM(const int hwm);
    void SetRecvHWM(const int hwm);
    zctx_t* GetContext();
+   int GetFileDescriptor() const;
+   bool IsReadable() const;
 protected:
    virtual zctx_t* GetNewContext();
    virtual void* GetNewSocket(zctx_t* ctx);
@@ -40,6 +42,7 @@ protected:
    std::map<std::string, std::string> mUnreadReplies;
    time_t mLastGCTime;
 private:
+   friend class Poller;
    std::map<std::string, time_t> mPendingReplies;
    std::string mBinding;
    void *mChamber;
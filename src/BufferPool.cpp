@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <g3log/g3log.hpp>
+#include "BufferPool.h"
+
+namespace {
+   // buffers start on their own cache line so neighbouring buffers filled by
+   // different threads do not share one
+   const size_t kCacheLine = 64;
+
+   // the free list holds index + 1 in 32 bits
+   const size_t kMaxBufferCount = UINT32_MAX - 1;
+
+   size_t Stride(const size_t bufferSize) {
+      return (bufferSize + kCacheLine - 1) / kCacheLine * kCacheLine;
+   }
+
+   char* AllocateSlab(const size_t size) {
+      void* slab = NULL;
+      if (size == 0 || posix_memalign(&slab, kCacheLine, size) != 0) {
+         return NULL;
+      }
+      return reinterpret_cast<char*> (slab);
+   }
+
+   void FreeSlab(char* slab) {
+      free(slab);
+   }
+}
+
+/**
+ * Allocate all the buffers
+ * @param bufferSize
+ *   The size of every buffer
+ * @param bufferCount
+ *   The number of buffers, at most 2^32 - 1
+ */
+BufferPool::BufferPool(const size_t bufferSize, const size_t bufferCount) :
+BufferPool(bufferSize, bufferCount, AllocateSlab(SlabSize(bufferSize, bufferCount)), FreeSlab) {
+}
+
+/**
+ * Use memory allocated by a derived pool for the buffers
+ * @param bufferSize
+ * @param bufferCount
+ * @param slab
+ *   At least SlabSize bytes, cache line aligned. NULL if the allocation failed
+ * @param release
+ *   Frees the slab when the pool is destroyed
+ */
+BufferPool::BufferPool(const size_t bufferSize, const size_t bufferCount, char* slab, SlabRelease release) :
+mBufferSize(bufferSize),
+mBufferCount(std::min(bufferCount, kMaxBufferCount)),
+mStride(Stride(bufferSize)),
+mSlab(slab, release),
+mNext(new std::atomic<uint32_t>[mBufferCount]),
+mHead(0),
+mAvailable(0) {
+   if (!mSlab) {
+      LOG(WARNING) << "BufferPool could not allocate " << mBufferCount << " buffers of " << mBufferSize << " bytes";
+      return;
+   }
+   for (size_t i = mBufferCount; i > 0; i--) {
+      Push(i - 1);
+   }
+}
+
+BufferPool::~BufferPool() {
+   LOG_IF(WARNING, mSlab && Available() != mBufferCount) << "BufferPool destroyed with "
+           << mBufferCount - Available() << " buffers in use";
+}
+
+/**
+ * @param bufferSize
+ * @param bufferCount
+ * @return the bytes needed for the buffers, each padded to a cache line
+ */
+size_t BufferPool::SlabSize(const size_t bufferSize, const size_t bufferCount) {
+   return Stride(bufferSize) * std::min(bufferCount, kMaxBufferCount);
+}
+
+/**
+ * Take a buffer, it is owned by the caller until it is released
+ * @return
+ *   A buffer of BufferSize bytes, NULL if all buffers are in use
+ */
+char* BufferPool::Acquire() {
+   uint32_t index;
+   if (!Pop(index)) {
+      return NULL;
+   }
+   return mSlab.get() + index * mStride;
+}
+
+/**
+ * Give a buffer back, from any thread
+ * @param buffer
+ *   A buffer acquired from this pool
+ */
+void BufferPool::Release(void* buffer) {
+   if (!Owns(buffer)) {
+      LOG(WARNING) << "BufferPool asked to release a buffer it does not own";
+      return;
+   }
+   const size_t offset = reinterpret_cast<char*> (buffer) - mSlab.get();
+   Push(offset / mStride);
+}
+
+/**
+ * @param buffer
+ * @return if the buffer was acquired from this pool
+ */
+bool BufferPool::Owns(const void* buffer) const {
+   const char* start = mSlab.get();
+   const char* data = reinterpret_cast<const char*> (buffer);
+   return start && data >= start && data < start + mStride * mBufferCount &&
+           (data - start) % mStride == 0;
+}
+
+/**
+ * @return the size of every buffer
+ */
+size_t BufferPool::BufferSize() const {
+   return mBufferSize;
+}
+
+/**
+ * @return the number of buffers
+ */
+size_t BufferPool::BufferCount() const {
+   return mSlab ? mBufferCount : 0;
+}
+
+/**
+ * @return the number of buffers that can be acquired, a snapshot
+ */
+size_t BufferPool::Available() const {
+   return mAvailable.load(std::memory_order_relaxed);
+}
+
+/**
+ * ZeroMQ free function, pass the pool as the hint
+ * @param data
+ * @param pool
+ */
+void BufferPool::Free(void* data, void* pool) {
+   reinterpret_cast<BufferPool*> (pool)->Release(data);
+}
+
+/**
+ * Pop the top of the free list
+ * @param index
+ * @return if a buffer was free
+ */
+bool BufferPool::Pop(uint32_t& index) {
+   uint64_t head = mHead.load(std::memory_order_acquire);
+   while (true) {
+      const uint32_t top = static_cast<uint32_t> (head);
+      if (top == 0) {
+         return false;
+      }
+      const uint64_t next = mNext[top - 1].load(std::memory_order_relaxed);
+      const uint64_t replacement = (((head >> 32) + 1) << 32) | next;
+      if (mHead.compare_exchange_weak(head, replacement, std::memory_order_acq_rel, std::memory_order_acquire)) {
+         mAvailable.fetch_sub(1, std::memory_order_relaxed);
+         index = top - 1;
+         return true;
+      }
+   }
+}
+
+/**
+ * Push a buffer on the free list
+ * @param index
+ */
+void BufferPool::Push(const uint32_t index) {
+   // counted before it can be popped so the count never drops below zero
+   mAvailable.fetch_add(1, std::memory_order_relaxed);
+   uint64_t head = mHead.load(std::memory_order_relaxed);
+   uint64_t replacement;
+   do {
+      mNext[index].store(static_cast<uint32_t> (head), std::memory_order_relaxed);
+      replacement = (((head >> 32) + 1) << 32) | (index + 1);
+   } while (!mHead.compare_exchange_weak(head, replacement, std::memory_order_release, std::memory_order_relaxed));
+}
@@ -0,0 +1,58 @@
+/*
+ * File:   BufferPool.h
+ *
+ * Fixed size buffers for zero copy sends, allocated once up front.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/**
+ * A slab of equally sized buffers with a lock free free list. A buffer is
+ * acquired by the producer, filled and handed to Rifle::FireZeroCopy together
+ * with BufferPool::Free and the pool as the hint. ZeroMQ returns it to the
+ * pool from its IO thread once it is sent, so steady state sending does no
+ * malloc or free at all.
+ *
+ * The pool must outlive every socket its buffers were fired on.
+ */
+class BufferPool {
+public:
+   BufferPool(const size_t bufferSize, const size_t bufferCount);
+   virtual ~BufferPool();
+
+   char* Acquire();
+   void Release(void* buffer);
+   bool Owns(const void* buffer) const;
+   size_t BufferSize() const;
+   size_t BufferCount() const;
+   size_t Available() const;
+
+   static void Free(void* data, void* pool);
+
+protected:
+   typedef std::function<void(char*)> SlabRelease;
+   BufferPool(const size_t bufferSize, const size_t bufferCount, char* slab, SlabRelease release);
+   static size_t SlabSize(const size_t bufferSize, const size_t bufferCount);
+
+private:
+   BufferPool(const BufferPool&) = delete;
+   BufferPool& operator=(const BufferPool&) = delete;
+
+   bool Pop(uint32_t& index);
+   void Push(const uint32_t index);
+
+   const size_t mBufferSize;
+   const size_t mBufferCount;
+   const size_t mStride;
+   std::unique_ptr<char, SlabRelease> mSlab;
+   // links of the free list, index + 1 of the next free buffer, 0 ends it
+   std::unique_ptr<std::atomic<uint32_t>[]> mNext;
+   // version in the high half to avoid ABA, index + 1 of the top in the low half
+   std::atomic<uint64_t> mHead;
+   std::atomic<size_t> mAvailable;
+};
@@ -1,6 +1,33 @@
 #include "CZMQToolkit.h"
 #include "g3log/g3log.hpp"
 #include <czmq.h>
+#include <atomic>
+
+namespace {
+
+/**
+ * Owns the buffers of a zero copy message until ZeroMQ has released every
+ * frame that points into them.
+ */
+struct ZeroCopyFrames {
+   explicit ZeroCopyFrames(std::vector<std::string>&& moved) :
+   frames(std::move(moved)), pending(frames.size()) {
+   }
+   std::vector<std::string> frames;
+   std::atomic<size_t> pending;
+};
+
+/**
+ * ZeroMQ free function for the frames of a zero copy message
+ */
+void ReleaseZeroCopyFrames(void*, void* hint) {
+   ZeroCopyFrames* owner = reinterpret_cast<ZeroCopyFrames*> (hint);
+   if (--owner->pending == 0) {
+      delete owner;
+   }
+}
+
+} // namespace
 
 /**
  * Simple method to set all 4 variables needed to set our buffers and high water mark.
@@ -67,3 +94,72 @@ bool CZMQToolkit::SendExistingMessage(zmsg_t*& message, void* socket) {
    return success;
 }
 
+/**
+ * Send a multipart message without copying the frames. Ownership of the
+ * buffers is taken over, they are released when ZeroMQ is done with the
+ * last frame.
+ *
+ * @param frames
+ *   One string per frame, moved from. Must not be empty.
+ * @param socket
+ *   An open socket
+ * @return
+ *   If all frames were queued
+ */
+bool CZMQToolkit::SendZeroCopyFrames(std::vector<std::string>&& frames, void* socket) {
+   if (! socket || frames.empty()) {
+      LOG(WARNING) << "Failed on send, NULL socket or no frames";
+      return false;
+   }
+   ZeroCopyFrames* owner = new ZeroCopyFrames(std::move(frames));
+   const size_t count = owner->frames.size();
+   size_t sent = 0;
+   bool success = true;
+   for (; sent < count && success; sent ++) {
+      std::string& frame = owner->frames[sent];
+      zmq_msg_t message;
+      zmq_msg_init_data(&message, &frame[0], frame.size(), ReleaseZeroCopyFrames, owner);
+      const int flags = (sent + 1 < count) ? ZMQ_SNDMORE : 0;
+      if (zmq_msg_send(&message, socket, flags) < 0) {
+         LOG(WARNING) << "Failed on send " << zmq_strerror(zmq_errno());
+         zmq_msg_close(&message);
+         success = false;
+      }
+   }
+   // frames that were never handed to ZeroMQ will never be released by it
+   if (sent < count && (owner->pending -= (count - sent)) == 0) {
+      delete owner;
+   }
+   return success;
+}
+
+/**
+ * The file descriptor ZeroMQ signals socket activity on, so the socket can be
+ * waited on in an epoll/select loop together with other descriptors.
+ *
+ * The descriptor is edge triggered and readable only means that the state of
+ * the socket may have changed, not that a message is waiting. When it fires
+ * keep receiving while IsReadable is true, otherwise a message that arrived
+ * before the last read may never wake the loop again.
+ * @param socket
+ * @return the descriptor, -1 if the socket is not initialized
+ */
+int CZMQToolkit::GetFileDescriptor(void* socket) {
+   if (!socket) {
+      return -1;
+   }
+   return zsocket_fd(socket);
+}
+
+/**
+ * Check the socket's ZMQ_EVENTS for a message that can be received without
+ * blocking. Reading ZMQ_EVENTS also resets the edge of the file descriptor.
+ * @param socket
+ * @return if a message is waiting
+ */
+bool CZMQToolkit::IsReadable(void* socket) {
+   if (!socket) {
+      return false;
+   }
+   return (zsocket_events(socket) & ZMQ_POLLIN) != 0;
+}
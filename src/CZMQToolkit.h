@@ -7,6 +7,7 @@
 
 #pragma once
 #include <string>
+#include <vector>
 #include <zlib.h>
 
 struct _zmsg_t;
@@ -18,5 +19,8 @@ public:
    static void setHWMAndBuffer(void* socket, const int size);
    static void PrintCurrentHighWater(void* socket, const std::string& name);
    static bool SendExistingMessage(zmsg_t*& bullet, void* socket);
+   static bool SendZeroCopyFrames(std::vector<std::string>&& frames, void* socket);
+   static int GetFileDescriptor(void* socket);
+   static bool IsReadable(void* socket);
 };
 
@@ -0,0 +1,159 @@
+#include <g3log/g3log.hpp>
+#include "Crossbow.h"
+#include "HashRing.h"
+#include "Rifle.h"
+
+Crossbow::Crossbow() :
+mHwm(500) {
+}
+
+Crossbow::~Crossbow() {
+}
+
+/**
+ * Set the high water mark of every Rifle, before targets are added.
+ * @param hwm
+ */
+void Crossbow::SetHighWater(const int hwm) {
+   mHwm = hwm;
+}
+
+/**
+ * Aim a Rifle at a Vampire location and put it on the ring
+ * @param location
+ * @param ownSocket
+ *   Bind the location, false to connect to a Vampire that binds it
+ * @return 
+ *   false if the Rifle can't be aimed or the location is a target already
+ */
+bool Crossbow::AddTarget(const std::string& location, const bool ownSocket) {
+   if (mRifles.find(location) != mRifles.end()) {
+      LOG(WARNING) << "Crossbow already aims at " << location;
+      return false;
+   }
+   std::unique_ptr<Rifle> rifle(new Rifle(location));
+   rifle->SetHighWater(mHwm);
+   rifle->SetOwnSocket(ownSocket);
+   if (!rifle->Aim()) {
+      return false;
+   }
+   for (size_t replica = 0; replica < HashRing::kPointsPerTarget; ++replica) {
+      // on the rare collision the point stays with the first target
+      mRing.insert(std::make_pair(HashRing::Point(location, replica), rifle.get()));
+   }
+   mRifles[location] = std::move(rifle);
+   return true;
+}
+
+/**
+ * Take a location off the ring, its keys go to the next points
+ * @param location
+ * @return 
+ *   false if it was not a target
+ */
+bool Crossbow::RemoveTarget(const std::string& location) {
+   auto rifle = mRifles.find(location);
+   if (rifle == mRifles.end()) {
+      return false;
+   }
+   for (auto point = mRing.begin(); point != mRing.end();) {
+      if (point->second == rifle->second.get()) {
+         point = mRing.erase(point);
+      } else {
+         ++point;
+      }
+   }
+   mRifles.erase(rifle);
+   return true;
+}
+
+/**
+ * @return the number of locations aimed at
+ */
+size_t Crossbow::Targets() const {
+   return mRifles.size();
+}
+
+/**
+ * @param key
+ * @return the location the key is fired at, empty without targets
+ */
+std::string Crossbow::Target(const uint64_t key) const {
+   auto point = Aim(key);
+   return point == mRing.end() ? std::string() : point->second->GetBinding();
+}
+
+/**
+ * Shoot a bullet at the Vampire of the key
+ * @param key
+ * @param bullet
+ * @param waitToFire in milliseconds
+ * @return 
+ */
+bool Crossbow::Fire(const uint64_t key, const std::string& bullet, const int waitToFire) {
+   auto point = Aim(key);
+   if (point == mRing.end()) {
+      LOG(WARNING) << "Crossbow has no targets";
+      return false;
+   }
+   return point->second->Fire(bullet, waitToFire);
+}
+
+/**
+ * Shoot a pointer at the Vampire of the key
+ * @param key
+ * @param stake
+ * @param waitToFire in milliseconds
+ * @return 
+ */
+bool Crossbow::FireStake(const uint64_t key, const void* stake, const int waitToFire) {
+   auto point = Aim(key);
+   if (point == mRing.end()) {
+      LOG(WARNING) << "Crossbow has no targets";
+      return false;
+   }
+   return point->second->FireStake(stake, waitToFire);
+}
+
+/**
+ * Shoot every stake at the Vampire of its hash, one message per Vampire
+ * @param stakes
+ *   Pairs of a pointer and the hash of its data, the hash is the key
+ * @param unsent
+ *   Filled with the stakes of every message that could not be fired, the
+ *   caller still owns them. The other stakes belong to their Vampires.
+ * @param waitToFire in milliseconds, for each Vampire
+ * @return 
+ *   false if any of the messages could not be fired
+ */
+bool Crossbow::FireStakes(const std::vector<std::pair<void*, unsigned int> >& stakes,
+        std::vector<std::pair<void*, unsigned int> >& unsent, const int waitToFire) {
+   unsent.clear();
+   if (mRing.empty()) {
+      LOG(WARNING) << "Crossbow has no targets";
+      unsent = stakes;
+      return false;
+   }
+   std::map<Rifle*, std::vector<std::pair<void*, unsigned int> > > bundles;
+   for (const auto& stake : stakes) {
+      bundles[Aim(stake.second)->second].push_back(stake);
+   }
+   for (const auto& bundle : bundles) {
+      if (!bundle.first->FireStakes(bundle.second, waitToFire)) {
+         unsent.insert(unsent.end(), bundle.second.begin(), bundle.second.end());
+      }
+   }
+   return !bundles.empty() && unsent.empty();
+}
+
+/**
+ * @param key
+ * @return the first point on the ring at or after the key, wrapping around
+ */
+Crossbow::Ring::const_iterator Crossbow::Aim(const uint64_t key) const {
+   if (mRing.empty()) {
+      return mRing.end();
+   }
+   auto point = mRing.lower_bound(HashRing::Mix(key));
+   return point == mRing.end() ? mRing.begin() : point;
+}
@@ -0,0 +1,56 @@
+/*
+ * File:   Crossbow.h
+ *
+ * Fire at one of many Vampires, picked by consistent hashing of a key.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Rifle;
+
+/**
+ * A Rifle pushes round robin so the bullets of one flow land on any of its
+ * Vampires. A Crossbow keeps one Rifle per Vampire location and picks the
+ * Rifle by a key the caller supplies, i.e. the hash of a flow, so every
+ * bullet of a flow reaches the same Vampire and it can keep per flow state
+ * without sharing it.
+ *
+ * Locations are placed on a hash ring with HashRing::kPointsPerTarget points each.
+ * When a target is added only the keys now closest to it move, about
+ * 1/targets of them. When a target is removed only its own keys move.
+ *
+ * Like a Rifle it is used from one thread.
+ */
+class Crossbow {
+public:
+   Crossbow();
+   virtual ~Crossbow();
+
+   void SetHighWater(const int hwm);
+   bool AddTarget(const std::string& location, const bool ownSocket = true);
+   bool RemoveTarget(const std::string& location);
+   size_t Targets() const;
+   std::string Target(const uint64_t key) const;
+
+   bool Fire(const uint64_t key, const std::string& bullet, const int waitToFire = 10000);
+   bool FireStake(const uint64_t key, const void* stake, const int waitToFire = 10000);
+   bool FireStakes(const std::vector<std::pair<void*, unsigned int> >& stakes,
+           std::vector<std::pair<void*, unsigned int> >& unsent,
+           const int waitToFire = 10000);
+
+private:
+   Crossbow(const Crossbow&) = delete;
+   Crossbow& operator=(const Crossbow&) = delete;
+
+   typedef std::map<uint64_t, Rifle*> Ring;
+   Ring::const_iterator Aim(const uint64_t key) const;
+
+   int mHwm;
+   std::map<std::string, std::unique_ptr<Rifle> > mRifles;
+   Ring mRing;
+};
@@ -6,6 +6,14 @@
 #include "Crowbar.h"
 #include <boost/thread.hpp>
 #include <g3log/g3log.hpp>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace {
+   const int kDefaultReconnectIntervalMs = 100;
+   const int kDefaultReconnectIntervalMaxMs = 1000;
+}
 
 /**
  * Construct a crowbar for beating things at the binding location
@@ -14,7 +22,10 @@
  *   A std::string description of a ZMQ socket
  */
 Crowbar::Crowbar(const std::string& binding) : mContext(NULL),
-mBinding(binding), mTip(NULL), mOwnsContext(true) {
+mBinding(binding), mTip(NULL), mOwnsContext(true),
+mReconnectIntervalMs(kDefaultReconnectIntervalMs),
+mReconnectIntervalMaxMs(kDefaultReconnectIntervalMaxMs),
+mMonitorConnection(false), mMonitor(NULL), mConnected(false) {
    
 }
 
@@ -25,7 +36,10 @@ mBinding(binding), mTip(NULL), mOwnsContext(true) {
  *   A living(initialized) headcrab
  */
 Crowbar::Crowbar(const Headcrab& target) : mContext(target.GetContext()),
-mBinding(target.GetBinding()), mTip(NULL), mOwnsContext(false) {
+mBinding(target.GetBinding()), mTip(NULL), mOwnsContext(false),
+mReconnectIntervalMs(kDefaultReconnectIntervalMs),
+mReconnectIntervalMaxMs(kDefaultReconnectIntervalMaxMs),
+mMonitorConnection(false), mMonitor(NULL), mConnected(false) {
    if (mContext == NULL) {
       mOwnsContext = true;
    }
@@ -40,14 +54,24 @@ mBinding(target.GetBinding()), mTip(NULL), mOwnsContext(false) {
  *   A working context
  */
 Crowbar::Crowbar(const std::string& binding, zctx_t* context) : mContext(context),
-mBinding(binding), mTip(NULL), mOwnsContext(false) {
+mBinding(binding), mTip(NULL), mOwnsContext(false),
+mReconnectIntervalMs(kDefaultReconnectIntervalMs),
+mReconnectIntervalMaxMs(kDefaultReconnectIntervalMaxMs),
+mMonitorConnection(false), mMonitor(NULL), mConnected(false) {
 
 }
 
 /**
- * Default deconstructor
+ * Default deconstructor. The monitor is stopped and closed here, on the
+ * context of a Headcrab it would stay bound until the Headcrab goes, so a
+ * Crowbar sharing a context has to go before its Headcrab.
  */
 Crowbar::~Crowbar() {
+   if (mMonitor) {
+      zmq_socket_monitor(mTip, NULL, 0);
+      zsocket_destroy(mContext, mMonitor);
+      mMonitor = NULL;
+   }
    if (mOwnsContext && mContext != NULL) {
       zctx_destroy(&mContext);
    }
@@ -63,8 +87,38 @@ int Crowbar::GetHighWater() {
    return 1024;
 }
 
+/**
+ * Set how often ZeroMQ retries to connect to an absent peer. The interval
+ * doubles after every failed attempt up to the max. This must be called
+ * before Wield.
+ *
+ * @param intervalMs
+ *   The first reconnect interval
+ * @param maxIntervalMs
+ *   The upper limit of the reconnect backoff, 0 means no backoff
+ */
+void Crowbar::SetReconnectInterval(const int intervalMs, const int maxIntervalMs) {
+   mReconnectIntervalMs = intervalMs;
+   mReconnectIntervalMaxMs = maxIntervalMs;
+}
+
+/**
+ * Monitor the connection state of the tip so that IsConnected can tell when
+ * the Headcrab is really there. This must be called before Wield.
+ *
+ * @param monitor
+ */
+void Crowbar::MonitorConnection(const bool monitor) {
+   mMonitorConnection = monitor;
+}
+
 /**
  * Get the "tip" socket used to hit things
+ *
+ * The connect does not wait for the other side, ZeroMQ keeps reconnecting in
+ * the background (see SetReconnectInterval) until the Headcrab shows up.
+ * Only an invalid endpoint (or an inproc endpoint that is not bound yet)
+ * fails.
  * 
  * @return
  *   A pointer to a zmq socket (or NULL in a failure) 
@@ -78,23 +132,20 @@ void* Crowbar::GetTip() {
    zsocket_set_sndhwm(tip, GetHighWater());
    zsocket_set_rcvhwm(tip, GetHighWater());
    zsocket_set_linger(tip, 0);
-   int connectRetries = 100;
-
-   while (zsocket_connect(tip, mBinding.c_str()) != 0 && connectRetries-- > 0 && !zctx_interrupted) {
-      boost::this_thread::interruption_point();
-      int err = zmq_errno();
-      if (err == ETERM) {
-         zsocket_destroy(mContext, tip);
-         return NULL;
-      }
-      std::string error(zmq_strerror(err));
-      LOG(WARNING) << "Could not connect to " << mBinding << ":" << error;
-      zclock_sleep(100);
-   }
-   if (zctx_interrupted) {
-      LOG(INFO) << "Caught Interrupt Signal";
+   zsocket_set_reconnect_ivl(tip, mReconnectIntervalMs);
+   zsocket_set_reconnect_ivl_max(tip, mReconnectIntervalMaxMs);
+   if (mMonitorConnection && !GetMonitor(tip)) {
+      zsocket_destroy(mContext, tip);
+      return NULL;
    }
-   if (connectRetries <= 0) {
+
+   if (zsocket_connect(tip, mBinding.c_str()) != 0) {
+      LOG(WARNING) << "Could not connect to " << mBinding << ":" << zmq_strerror(zmq_errno());
+      if (mMonitor) {
+         zmq_socket_monitor(tip, NULL, 0);
+         zsocket_destroy(mContext, mMonitor);
+         mMonitor = NULL;
+      }
       zsocket_destroy(mContext, tip);
       return NULL;
    }
@@ -102,6 +153,88 @@ void* Crowbar::GetTip() {
    return tip;
 }
 
+/**
+ * Start monitoring the tip for connect/disconnect events. Must happen before
+ * the tip connects so that no event is missed.
+ *
+ * @param tip
+ *   The unconnected tip socket
+ * @return
+ *   The PAIR socket receiving the events (or NULL in a failure)
+ */
+void* Crowbar::GetMonitor(void* tip) {
+   std::stringstream endpoint;
+   endpoint << "inproc://crowbar_monitor_" << this;
+   if (zmq_socket_monitor(tip, endpoint.str().c_str(),
+           ZMQ_EVENT_CONNECTED | ZMQ_EVENT_DISCONNECTED) != 0) {
+      LOG(WARNING) << "Could not monitor " << mBinding << ":" << zmq_strerror(zmq_errno());
+      return NULL;
+   }
+   void* monitor = zsocket_new(mContext, ZMQ_PAIR);
+   if (!monitor) {
+      return NULL;
+   }
+   if (zsocket_connect(monitor, endpoint.str().c_str()) != 0) {
+      LOG(WARNING) << "Could not connect monitor for " << mBinding << ":" << zmq_strerror(zmq_errno());
+      zsocket_destroy(mContext, monitor);
+      return NULL;
+   }
+   mConnected = false;
+   mMonitor = monitor;
+   return mMonitor;
+}
+
+/**
+ * Read one event from the monitor socket and update the connection state.
+ * The event number is in the first 16 bits of the first frame both for the
+ * ZeroMQ 3.x (zmq_event_t) and the ZeroMQ 4.x monitor formats.
+ */
+void Crowbar::ReadMonitorEvent() {
+   zmsg_t* event = zmsg_recv(mMonitor);
+   if (!event) {
+      return;
+   }
+   zframe_t* frame = zmsg_first(event);
+   if (frame && zframe_size(frame) >= sizeof (uint16_t)) {
+      uint16_t type = 0;
+      memcpy(&type, zframe_data(frame), sizeof (type));
+      if (type == ZMQ_EVENT_CONNECTED) {
+         mConnected = true;
+      } else if (type == ZMQ_EVENT_DISCONNECTED) {
+         mConnected = false;
+      }
+   }
+   zmsg_destroy(&event);
+}
+
+/**
+ * Check if the tip is connected to a Headcrab, requires MonitorConnection
+ * to be enabled before Wield.
+ *
+ * @param timeoutMs
+ *   How long to wait for the connection to come up, 0 only checks
+ * @return
+ *   If the peer is connected
+ */
+bool Crowbar::IsConnected(const int timeoutMs) {
+   if (!mMonitor) {
+      return false;
+   }
+   using namespace std::chrono;
+   steady_clock::time_point start = steady_clock::now();
+   while (zsocket_poll(mMonitor, 0)) {
+      ReadMonitorEvent();
+   }
+   int remainingMs = timeoutMs;
+   while (!mConnected && remainingMs > 0 && !zctx_interrupted) {
+      if (zsocket_poll(mMonitor, remainingMs)) {
+         ReadMonitorEvent();
+      }
+      remainingMs = timeoutMs - duration_cast<milliseconds>(steady_clock::now() - start).count();
+   }
+   return mConnected;
+}
+
 bool Crowbar::Wield() {
    if (!mContext) {
       mContext = zctx_new();
@@ -31,8 +31,13 @@ public:
    void* GetTip();
    static int GetHighWater();
    zctx_t* GetContext();
+   void SetReconnectInterval(const int intervalMs, const int maxIntervalMs);
+   void MonitorConnection(const bool monitor);
+   bool IsConnected(const int timeoutMs = 0);
 private:
    bool PollForReady();
+   void* GetMonitor(void* tip);
+   void ReadMonitorEvent();
    Crowbar(const Crowbar& that) : mContext(NULL), mTip(NULL) {
    }
 
@@ -40,4 +45,9 @@ private:
    std::string mBinding;
    void* mTip;
    bool mOwnsContext;
+   int mReconnectIntervalMs;
+   int mReconnectIntervalMaxMs;
+   bool mMonitorConnection;
+   void* mMonitor;
+   bool mConnected;
 };
@@ -9,6 +9,7 @@
 #include <g3log/g3log.hpp>
 #include <algorithm>
 #include "Harpoon.h"
+#include "CZMQToolkit.h"
 #include <chrono>
 
 
@@ -36,6 +37,17 @@ void Harpoon::MaxWaitInMs(const int timeoutMs) {
    mTimeoutMs = timeoutMs;
 }
 
+/// The edge triggered file descriptor of the dealer, see
+/// CZMQToolkit::GetFileDescriptor. When it fires keep heaving while IsReadable.
+int Harpoon::GetFileDescriptor() const {
+   return CZMQToolkit::GetFileDescriptor(mDealer);
+}
+
+/// If a chunk from the Kraken can be heaved without waiting
+bool Harpoon::IsReadable() const {
+   return CZMQToolkit::IsReadable(mDealer);
+}
+
 /// Send out ACKSs to the Server that request new chunks. The server will only fill up the
 /// queue with a number of responses equal to the number of ACKs in the queue in order
 /// to ensure the queue doesn't get overloaded. Max around of chunks is equal to mCredit
@@ -67,7 +79,8 @@ Harpoon::Battling Harpoon::PollTimeout(int timeoutMs) {
    using namespace std::chrono;
 
    steady_clock::time_point pollStartMs = steady_clock::now();
-   while (!zsocket_poll(mDealer, 1)) {
+   // a timeout of 0 only checks what already arrived
+   while (!zsocket_poll(mDealer, timeoutMs > 0 ? 1 : 0)) {
       int pollElapsedMs = duration_cast<milliseconds>(steady_clock::now() - pollStartMs).count();
       if (pollElapsedMs >= timeoutMs) {
          return Harpoon::Battling::TIMEOUT;
@@ -32,6 +32,8 @@ public:
 
    Spear Aim(const std::string& location);
    void MaxWaitInMs(const int timeoutMs);
+   int GetFileDescriptor() const;
+   bool IsReadable() const;
    Battling Heave(std::vector<uint8_t>& data);
    Battling Cancel();
    virtual ~Harpoon();
@@ -44,6 +46,7 @@ protected:
    void FreeChunk();
    
 private:
+   friend class Poller;
    void* mDealer;
    zctx_t* mCtx;
    size_t mQueueLength;
@@ -0,0 +1,35 @@
+#include "HashRing.h"
+
+namespace HashRing {
+
+   /**
+    * FNV-1a of the location and replica, the same in every process
+    * @param location
+    * @param replica
+    * @return a point on the ring
+    */
+   uint64_t Point(const std::string& location, const size_t replica) {
+      uint64_t hash = 14695981039346656037ULL;
+      const std::string name = location + "#" + std::to_string(replica);
+      for (const char c : name) {
+         hash ^= static_cast<unsigned char> (c);
+         hash *= 1099511628211ULL;
+      }
+      return Mix(hash);
+   }
+
+   /**
+    * Spread keys over the ring, flow hashes are often only 32 bits or poorly
+    * distributed
+    * @param key
+    * @return 
+    */
+   uint64_t Mix(uint64_t key) {
+      key ^= key >> 33;
+      key *= 0xff51afd7ed558ccdULL;
+      key ^= key >> 33;
+      key *= 0xc4ceb9fe1a85ec53ULL;
+      key ^= key >> 33;
+      return key;
+   }
+}
@@ -0,0 +1,18 @@
+/*
+ * File:   HashRing.h
+ *
+ * Points of a consistent hash ring, shared by the Crossbow and the routing
+ * of ZeroMQ<void*> so both place a location and a key the same way.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace HashRing {
+   const size_t kPointsPerTarget = 160;
+
+   uint64_t Point(const std::string& location, const size_t replica);
+   uint64_t Mix(uint64_t key);
+}
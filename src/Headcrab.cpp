@@ -8,7 +8,7 @@
 #include "boost/thread.hpp"
 #include <g3log/g3log.hpp>
 #include "Death.h"
-
+#include "CZMQToolkit.h"
 
 /**
  * Construct a headcrab at the given ZMQ binding
@@ -137,46 +137,89 @@ zctx_t* Headcrab::GetContext() const {
    return mContext;
 }
 
+/**
+ * The edge triggered file descriptor of the face, see
+ * CZMQToolkit::GetFileDescriptor. When it fires keep getting hit while
+ * IsReadable, every hit must still be answered with SendSplatter.
+ * @return
+ *   The descriptor if the headcrab is alive, or -1
+ */
+int Headcrab::GetFileDescriptor() const {
+   return CZMQToolkit::GetFileDescriptor(mFace);
+}
+
+/**
+ * @return if a hit can be taken without waiting
+ */
+bool Headcrab::IsReadable() const {
+   return CZMQToolkit::IsReadable(mFace);
+}
+
+/**
+ * Block until a hit arrives, only the first frame is kept
+ *
+ * @param theHit
+ *   Its buffer is recycled for the next receive, so passing the same
+ * string on every call avoids allocations
+ */
 bool Headcrab::GetHitBlock(std::string& theHit) {
-   std::vector<std::string> hits;
-   if (GetHitBlock(hits) && ! hits.empty()) {
-      theHit = hits[0];
+   if (ReceiveHits(mHitBuffer) && ! mHitBuffer.empty()) {
+      theHit.swap(mHitBuffer[0]);
       return true;
    }
    return false;
 }
 
+/**
+ * Block until a hit arrives
+ *
+ * @param theHits
+ *   One string per frame. The strings are assigned in place, passing the
+ * same vector on every call reuses its capacity and avoids allocations
+ */
 bool Headcrab::GetHitBlock(std::vector<std::string>& theHits) {
+   return ReceiveHits(theHits);
+}
+
+/**
+ * Receive all frames of one message straight from the socket into the
+ * given strings, without intermediate zmsg/zframe copies.
+ *
+ * @param theHits
+ *   Resized to the number of frames received
+ * @return
+ *   false if uninitialized or the receive was interrupted
+ */
+bool Headcrab::ReceiveHits(std::vector<std::string>& theHits) {
    if (! mFace) {
       return false;
    }
-   zmsg_t* message = zmsg_recv(mFace);
-   if (! message) {
-      return false;
-   }
-   //std::cout << "Got message with " << zmsg_size(message) << " parts" << std::endl;
-   theHits.clear();
-   int msgSize = zmsg_size(message);
-   for (int i = 0; i < msgSize; i ++) {
-      zframe_t* frame = zmsg_pop(message);
-      std::string aFrame;
-      aFrame.insert(0, reinterpret_cast<const char*> (zframe_data(frame)), zframe_size(frame));
-      theHits.push_back(aFrame);
-      zframe_destroy(&frame);
-      //std::cout << "got string " << aFrame << " " << theHits[i] << std::endl;
+   zmq_msg_t frame;
+   zmq_msg_init(&frame);
+   size_t frames = 0;
+   bool more = true;
+   while (more) {
+      if (zmq_msg_recv(&frame, mFace, 0) < 0) {
+         zmq_msg_close(&frame);
+         return false;
+      }
+      if (frames == theHits.size()) {
+         theHits.emplace_back();
+      }
+      theHits[frames ++].assign(reinterpret_cast<const char*> (zmq_msg_data(&frame)), zmq_msg_size(&frame));
+      more = zmq_msg_more(&frame);
    }
-
-   zmsg_destroy(&message);
-   //std::cout << "got " << theHits.size() << " hits" << std::endl;
+   zmq_msg_close(&frame);
+   theHits.resize(frames);
    return true;
-
 }
 
 bool Headcrab::GetHitWait(std::string& theHit, const int timeout) {
-   std::vector<std::string> hits;
-   if (GetHitWait(hits, timeout) && ! hits.empty()) {
-      theHit = hits[0];
-      return true;
+   if (! mFace) {
+      return false;
+   }
+   if (zsocket_poll(mFace, timeout)) {
+      return GetHitBlock(theHit);
    }
    return false;
 }
@@ -192,9 +235,10 @@ bool Headcrab::GetHitWait(std::vector<std::string>& theHits, const int timeout)
 }
 
 bool Headcrab::SendSplatter(const std::string& feedback) {
-   std::vector<std::string> allReplies;
-   allReplies.push_back(feedback);
-   return SendSplatter(allReplies);
+   if (! mFace) {
+      return false;
+   }
+   return (zmq_send(mFace, feedback.data(), feedback.size(), 0) >= 0);
 }
 
 bool Headcrab::SendSplatter(std::vector<std::string>& feedback) {
@@ -215,3 +259,20 @@ bool Headcrab::SendSplatter(std::vector<std::string>& feedback) {
    }
    return success;
 }
+
+/**
+ * Send the reply without copying it, ownership of the buffers is taken over
+ * and they are released when ZeroMQ is done with the last frame.
+ *
+ * @param feedback
+ *   One string per frame, moved from
+ */
+bool Headcrab::SendSplatter(std::vector<std::string>&& feedback) {
+   if (! mFace) {
+      return false;
+   }
+   if (feedback.empty()) {
+      return SendSplatter(feedback);
+   }
+   return CZMQToolkit::SendZeroCopyFrames(std::move(feedback), mFace);
+}
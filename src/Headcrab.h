@@ -18,24 +18,30 @@ public:
    virtual ~Headcrab();
    std::string GetBinding() const;
    zctx_t* GetContext() const;
+   int GetFileDescriptor() const;
+   bool IsReadable() const;
    bool ComeToLife();
 
    void* GetFace(zctx_t* context);
    bool GetHitBlock(std::vector<std::string>& theHits);
    bool GetHitWait(std::vector<std::string>& theHit,const int timeout);
    bool SendSplatter(std::vector<std::string>& feedback);
+   bool SendSplatter(std::vector<std::string>&& feedback);
    bool GetHitBlock(std::string& theHit);
    bool GetHitWait(std::string& theHit,const int timeout);
    bool SendSplatter(const std::string& feedback);
    static int GetHighWater();
 private:
+   friend class Poller;
 
    void setIpcFilePermissions();
+   bool ReceiveHits(std::vector<std::string>& theHits);
    Headcrab(const Headcrab& that) : mContext(NULL), mFace(NULL) {
    }
 
    std::string mBinding;
    zctx_t* mContext;
    void* mFace;
+   std::vector<std::string> mHitBuffer;
 };
 
@@ -0,0 +1,340 @@
+#include <zmq.h>
+#include <czmq.h>
+#define _OPEN_SYS
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <deque>
+#include <sstream>
+#include "HeadcrabNest.h"
+#include <g3log/g3log.hpp>
+#include "Death.h"
+
+namespace {
+   const char* kWorkerReady = "READY";
+   const int kPollIntervalMs = 100;
+}
+
+/**
+ * Construct a nest at the given ZMQ binding
+ *
+ * @param binding
+ *   A ZeroMQ binding, Crowbars connect to it as they would to a Headcrab
+ * @param workerCount
+ *   The number of worker threads handling requests
+ */
+HeadcrabNest::HeadcrabNest(const std::string& binding, const size_t workerCount) :
+mBinding(binding),
+mWorkerCount(workerCount > 0 ? workerCount : 1),
+mContext(NULL),
+mFrontend(NULL),
+mBackend(NULL),
+mAlive(false),
+mWorkers(new Worker[mWorkerCount]) {
+   std::stringstream backend;
+   backend << "inproc://headcrabnest_" << getpid() << "_" << this;
+   mBackendBinding = backend.str();
+}
+
+/**
+ * Stop the broker and all the workers, then destroy the context
+ */
+HeadcrabNest::~HeadcrabNest() {
+   KillTheNest();
+}
+
+/**
+ * Get the high water mark for socket sends
+ *
+ * @return
+ *   the high water mark
+ */
+int HeadcrabNest::GetHighWater() {
+   return 1024;
+}
+
+/**
+ * Get the ZMQ socket name that the nest would/is bound to
+ * @return
+ */
+std::string HeadcrabNest::GetBinding() const {
+   return mBinding;
+}
+
+/**
+ * @return the number of workers in the pool
+ */
+size_t HeadcrabNest::GetWorkerCount() const {
+   return mWorkerCount;
+}
+
+/**
+ * Bind the frontend and backend sockets, then start the broker and the
+ * worker threads.
+ *
+ * @param feeding
+ *   The request handler run by every worker
+ * @return
+ *   If initialization has worked
+ */
+bool HeadcrabNest::ComeToLife(Feeding feeding) {
+   if (mAlive) {
+      return true;
+   }
+   if (!feeding) {
+      LOG(WARNING) << "HeadcrabNest needs a request handler";
+      return false;
+   }
+   if (!mContext) {
+      mContext = zctx_new();
+      zctx_set_linger(mContext, 0);
+      zctx_set_sndhwm(mContext, GetHighWater());
+      zctx_set_rcvhwm(mContext, GetHighWater());
+      zctx_set_iothreads(mContext, 1);
+   }
+   if (!GetFrontend() || !GetBackend()) {
+      KillTheNest();
+      return false;
+   }
+
+   mFeeding = feeding;
+   mAlive = true;
+   for (size_t i = 0; i < mWorkerCount; ++i) {
+      zctx_t* shadow = zctx_shadow(mContext);
+      mThreads.emplace_back(&HeadcrabNest::Feed, this, i, shadow);
+   }
+   mThreads.emplace_back(&HeadcrabNest::Brood, this);
+   return true;
+}
+
+/**
+ * Populate the ROUTER socket that the Crowbars connect to
+ *
+ * @return
+ *   A pointer to the socket (or NULL in the case of a failure)
+ */
+void* HeadcrabNest::GetFrontend() {
+   if (mFrontend == NULL && mContext) {
+      void* face = zsocket_new(mContext, ZMQ_ROUTER);
+      assert(face != NULL);
+      zsocket_set_sndhwm(face, GetHighWater());
+      zsocket_set_rcvhwm(face, GetHighWater());
+      zsocket_set_linger(face, 0);
+      if (zsocket_bind(face, mBinding.c_str()) < 0) {
+         LOG(WARNING) << "HeadcrabNest could not bind to " << mBinding << ":" << zmq_strerror(zmq_errno());
+         zsocket_destroy(mContext, face);
+         return NULL;
+      }
+      Death::Instance().RegisterDeathEvent(&Death::DeleteIpcFiles, mBinding);
+      setIpcFilePermissions();
+      mFrontend = face;
+   }
+   return mFrontend;
+}
+
+/**
+ * Populate the inproc ROUTER socket that the workers connect to
+ *
+ * @return
+ *   A pointer to the socket (or NULL in the case of a failure)
+ */
+void* HeadcrabNest::GetBackend() {
+   if (mBackend == NULL && mContext) {
+      void* back = zsocket_new(mContext, ZMQ_ROUTER);
+      assert(back != NULL);
+      zsocket_set_sndhwm(back, GetHighWater());
+      zsocket_set_rcvhwm(back, GetHighWater());
+      zsocket_set_linger(back, 0);
+      if (zsocket_bind(back, mBackendBinding.c_str()) < 0) {
+         LOG(WARNING) << "HeadcrabNest could not bind to " << mBackendBinding << ":" << zmq_strerror(zmq_errno());
+         zsocket_destroy(mContext, back);
+         return NULL;
+      }
+      mBackend = back;
+   }
+   return mBackend;
+}
+
+/**
+ * Set the file permisions on an IPC socket to 0777
+ */
+void HeadcrabNest::setIpcFilePermissions() {
+
+   mode_t mode = S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP
+           | S_IXGRP | S_IROTH | S_IWOTH | S_IXOTH;
+
+   size_t ipcFound = mBinding.find("ipc");
+   if (ipcFound != std::string::npos) {
+      size_t tmpFound = mBinding.find("/tmp");
+      if (tmpFound != std::string::npos) {
+         std::string ipcFile = mBinding.substr(tmpFound);
+         LOG(INFO) << "HeadcrabNest set ipc permissions: " << ipcFile;
+         chmod(ipcFile.c_str(), mode);
+      }
+   }
+}
+
+/**
+ * The broker loop. The backend is always polled, the frontend only when at
+ * least one worker is waiting for work. Workers are queued in the order they
+ * became ready so the least recently used worker gets the next request.
+ */
+void HeadcrabNest::Brood() {
+   std::deque<zframe_t*> idleWorkers;
+   while (mAlive && !zctx_interrupted) {
+      zmq_pollitem_t items [] = {
+         { mBackend, 0, ZMQ_POLLIN, 0},
+         { mFrontend, 0, ZMQ_POLLIN, 0}
+      };
+      const int itemCount = idleWorkers.empty() ? 1 : 2;
+      if (zmq_poll(items, itemCount, kPollIntervalMs) < 0) {
+         break;
+      }
+
+      if (items[0].revents & ZMQ_POLLIN) {
+         zmsg_t* reply = zmsg_recv(mBackend);
+         if (!reply) {
+            break;
+         }
+         idleWorkers.push_back(zmsg_unwrap(reply));
+         zframe_t* first = zmsg_first(reply);
+         if (zmsg_size(reply) == 1 && zframe_streq(first, kWorkerReady)) {
+            zmsg_destroy(&reply);
+         } else if (zmsg_send(&reply, mFrontend) != 0) {
+            LOG(WARNING) << "HeadcrabNest could not route reply: " << zmq_strerror(zmq_errno());
+         }
+         if (reply) {
+            zmsg_destroy(&reply);
+         }
+      }
+
+      if (itemCount > 1 && (items[1].revents & ZMQ_POLLIN)) {
+         zmsg_t* request = zmsg_recv(mFrontend);
+         if (!request) {
+            break;
+         }
+         zmsg_wrap(request, idleWorkers.front());
+         idleWorkers.pop_front();
+         if (zmsg_send(&request, mBackend) != 0) {
+            LOG(WARNING) << "HeadcrabNest could not hand out request: " << zmq_strerror(zmq_errno());
+         }
+         if (request) {
+            zmsg_destroy(&request);
+         }
+      }
+   }
+   for (auto worker : idleWorkers) {
+      zframe_destroy(&worker);
+   }
+}
+
+/**
+ * The worker loop. Tell the nest we are ready, then keep handling requests
+ * until the nest dies.
+ *
+ * @param index
+ *   The worker's index into the stats
+ * @param shadow
+ *   A shadow of the nest context, owned (and destroyed) by this worker
+ */
+void HeadcrabNest::Feed(const size_t index, zctx_t* shadow) {
+   Worker& stats = mWorkers[index];
+   void* face = zsocket_new(shadow, ZMQ_REQ);
+   if (face) {
+      zsocket_set_linger(face, 0);
+   }
+   if (!face || zsocket_connect(face, mBackendBinding.c_str()) != 0) {
+      LOG(WARNING) << "HeadcrabNest worker " << index << " could not connect to " << mBackendBinding;
+      zctx_destroy(&shadow);
+      return;
+   }
+   zstr_send(face, kWorkerReady);
+
+   std::vector<std::string> hits;
+   std::vector<std::string> splatter;
+   while (mAlive && !zctx_interrupted) {
+      if (!zsocket_poll(face, kPollIntervalMs)) {
+         continue;
+      }
+      zmsg_t* request = zmsg_recv(face);
+      if (!request) {
+         break;
+      }
+      auto start = std::chrono::steady_clock::now();
+      zframe_t* address = zmsg_unwrap(request);
+      hits.clear();
+      uint64_t bytesIn = 0;
+      for (zframe_t* frame = zmsg_first(request); frame != NULL; frame = zmsg_next(request)) {
+         hits.emplace_back(reinterpret_cast<const char*> (zframe_data(frame)), zframe_size(frame));
+         bytesIn += zframe_size(frame);
+      }
+      zmsg_destroy(&request);
+
+      splatter.clear();
+      if (!mFeeding(hits, splatter)) {
+         stats.failures++;
+      }
+      if (splatter.empty()) {
+         splatter.emplace_back();
+      }
+
+      zmsg_t* reply = zmsg_new();
+      uint64_t bytesOut = 0;
+      for (const auto& splat : splatter) {
+         zmsg_addmem(reply, splat.data(), splat.size());
+         bytesOut += splat.size();
+      }
+      zmsg_wrap(reply, address);
+      if (zmsg_send(&reply, face) != 0) {
+         LOG(WARNING) << "HeadcrabNest worker " << index << " could not reply: " << zmq_strerror(zmq_errno());
+         stats.failures++;
+      }
+      if (reply) {
+         zmsg_destroy(&reply);
+      }
+
+      stats.requests++;
+      stats.bytesIn += bytesIn;
+      stats.bytesOut += bytesOut;
+      stats.busyUs += std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start).count();
+   }
+   zctx_destroy(&shadow);
+}
+
+/**
+ * A snapshot of the per worker statistics
+ *
+ * @return
+ *   One entry per worker, in worker order
+ */
+std::vector<HeadcrabNest::WorkerStats> HeadcrabNest::GetWorkerStats() const {
+   std::vector<WorkerStats> snapshot;
+   snapshot.reserve(mWorkerCount);
+   for (size_t i = 0; i < mWorkerCount; ++i) {
+      const Worker& worker = mWorkers[i];
+      snapshot.push_back({worker.requests.load(), worker.failures.load(),
+         worker.bytesIn.load(), worker.bytesOut.load(), worker.busyUs.load()});
+   }
+   return snapshot;
+}
+
+/**
+ * Stop all threads and tear down the sockets and the context
+ */
+void HeadcrabNest::KillTheNest() {
+   mAlive = false;
+   for (auto& thread : mThreads) {
+      if (thread.joinable()) {
+         thread.join();
+      }
+   }
+   mThreads.clear();
+   if (mContext) {
+      zctx_destroy(&mContext);
+      mContext = NULL;
+   }
+   mFrontend = NULL;
+   mBackend = NULL;
+}
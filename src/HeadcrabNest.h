@@ -0,0 +1,87 @@
+/*
+ * File:   HeadcrabNest.h
+ *
+ * A Headcrab nest is a load balancing (LRU) broker in front of a pool of
+ * Headcrab workers. Crowbars connect to it exactly like they would connect
+ * to a single Headcrab.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct _zctx_t;
+typedef struct _zctx_t zctx_t;
+
+/**
+ * The nest binds a ROUTER socket (the frontend) at the given binding and an
+ * inproc ROUTER socket (the backend) that the workers connect to with REQ
+ * sockets. A worker announces itself as ready, the nest hands the next
+ * request to the worker that has been idle the longest and routes the reply
+ * back to the Crowbar that sent it.
+ *
+ * Every worker runs the same Feeding function on its own thread:
+ *   hits      : the frames sent by the Crowbar
+ *   splatter  : the frames to reply with
+ *   return    : false if the request could not be handled, the (possibly
+ *               empty) splatter is still sent back since the Crowbar is
+ *               always waiting for a reply.
+ */
+class HeadcrabNest {
+public:
+   typedef std::function<bool(const std::vector<std::string>& hits,
+                              std::vector<std::string>& splatter)> Feeding;
+
+   struct WorkerStats {
+      uint64_t requests;
+      uint64_t failures;
+      uint64_t bytesIn;
+      uint64_t bytesOut;
+      uint64_t busyUs;
+   };
+
+   HeadcrabNest(const std::string& binding, const size_t workerCount);
+   virtual ~HeadcrabNest();
+
+   std::string GetBinding() const;
+   size_t GetWorkerCount() const;
+   bool ComeToLife(Feeding feeding);
+   std::vector<WorkerStats> GetWorkerStats() const;
+   static int GetHighWater();
+
+private:
+   HeadcrabNest(const HeadcrabNest&) = delete;
+   HeadcrabNest& operator=(const HeadcrabNest&) = delete;
+
+   struct Worker {
+      Worker() : requests(0), failures(0), bytesIn(0), bytesOut(0), busyUs(0) {}
+      std::atomic<uint64_t> requests;
+      std::atomic<uint64_t> failures;
+      std::atomic<uint64_t> bytesIn;
+      std::atomic<uint64_t> bytesOut;
+      std::atomic<uint64_t> busyUs;
+   };
+
+   void* GetFrontend();
+   void* GetBackend();
+   void Brood();
+   void Feed(const size_t index, zctx_t* shadow);
+   void KillTheNest();
+   void setIpcFilePermissions();
+
+   std::string mBinding;
+   std::string mBackendBinding;
+   const size_t mWorkerCount;
+   zctx_t* mContext;
+   void* mFrontend;
+   void* mBackend;
+   Feeding mFeeding;
+   std::atomic<bool> mAlive;
+   std::unique_ptr<Worker[]> mWorkers;
+   std::vector<std::thread> mThreads;
+};
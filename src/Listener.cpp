@@ -4,6 +4,7 @@
  * Created: August 14, 2015 1:08PM
  */
 
+#include <algorithm>
 #include <memory>
 #include <g3log/g3log.hpp>
 #include <thread>
@@ -11,6 +12,7 @@
 #include "Listener.h"
 #include <Alien.h>
 #include <Rifle.h>
+#include "Notifier.h"
 
 namespace {
 
@@ -43,6 +45,7 @@ std::unique_ptr<Listener>  Listener::CreateListener(const std::string& notificat
 Listener::Listener(const std::string& notificationQueue, const std::string& handshakeQueue, const std::string& program)
    : mNotificationQueueName(notificationQueue),
      mHandshakeQueueName(handshakeQueue),
+     mConfirmations(kConfirmationSize, kConfirmationCount),
      mProgramName(program) {}
 
 /*
@@ -110,8 +113,23 @@ bool Listener::SendConfirmation() {
    std::ostringstream oss;
    auto id = ThreadID();
    oss << id << " : " << this->mProgramName;
-   std::string* pMsg = new std::string(oss.str());
-   const bool confirmation = mHandshakeQueue->FireZeroCopy(pMsg, pMsg->size(), ZeroCopyDelete, kBlockForOneMinute);
+   if (!mNotificationId.empty()) {
+      oss << Notifier::kConfirmationSeparator << mNotificationId;
+   }
+   const std::string message = oss.str();
+   bool confirmation = false;
+   char* buffer = mConfirmations.Acquire();
+   if (buffer && message.size() <= mConfirmations.BufferSize()) {
+      std::copy(message.begin(), message.end(), buffer);
+      confirmation = mHandshakeQueue->FireZeroCopy(buffer, message.size(), BufferPool::Free, &mConfirmations, kBlockForOneMinute);
+   } else {
+      // all pooled buffers in flight, or an unusually long program name
+      if (buffer) {
+         mConfirmations.Release(buffer);
+      }
+      std::string* pMsg = new std::string(message);
+      confirmation = mHandshakeQueue->FireZeroCopy(pMsg, pMsg->size(), ZeroCopyDelete, kBlockForOneMinute);
+   }
    if (confirmation) {
       LOG(INFO) << "Send update confirmation, thread #" << oss.str();
    } else {
@@ -120,6 +138,25 @@ bool Listener::SendConfirmation() {
    return confirmation;
 }
 
+/*
+* The edge triggered file descriptor of the notification queue, so
+* listeners can wait in their own event loop instead of spinning on
+* NotificationReceived. When it fires, call NotificationReceived while
+* IsReadable.
+*
+* @return the descriptor
+*/
+int Listener::GetFileDescriptor() const {
+   return mQueueReader->GetFileDescriptor();
+}
+
+/*
+* @return whether a notification is waiting
+*/
+bool Listener::IsReadable() const {
+   return mQueueReader->IsReadable();
+}
+
 /*
 *  Get the ID number of the current thread
 *
@@ -144,6 +181,7 @@ bool Listener::NotificationReceived() {
    mQueueReader->GetShot(getShotTimeout, dataFromQueue);
    bool notificationReceived = MessageHasPayload(dataFromQueue);
    if (notificationReceived) {
+      mNotificationId = dataFromQueue[0];
       ClearMessages();
       StorePayloadIfNecessary(dataFromQueue);
    }
@@ -164,10 +202,10 @@ void Listener::StorePayloadIfNecessary(std::vector<std::string>& dataFromQueue)
 }
 
 /*
-* The notifier puts a dummy message at the front of the
+* The notifier puts the notification id at the front of the
 * queue. Strip this message from the vector of strings
 *
-* @param vector of strings where the first string is "notify"
+* @param vector of strings where the first string is the notification id
 */
 void Listener::RemoveFirstDummyShot(std::vector<std::string>& data) {
    data.erase(data.begin());
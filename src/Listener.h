@@ -8,6 +8,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include "BufferPool.h"
 
 class Alien;
 class Rifle;
@@ -22,6 +23,8 @@ class Listener {
    Listener& operator=(const Listener&) = delete;
    bool NotificationReceived();
    bool SendConfirmation();
+   int GetFileDescriptor() const;
+   bool IsReadable() const;
    std::vector<std::string> GetMessages() { return mMessages; };
 
  protected:
@@ -42,9 +45,14 @@ class Listener {
    const std::string mNotificationQueueName;
    const std::string mHandshakeQueueName;
    std::vector<std::string> mMessages;
+   std::string mNotificationId;
    std::unique_ptr<Alien> mQueueReader;
+   // declared before the rifle so it outlives confirmations still in flight
+   BufferPool mConfirmations;
    std::unique_ptr<Rifle> mHandshakeQueue;
    const std::string mProgramName;
    const unsigned int getShotTimeout = 0;
    const int kBlockForOneMinute = 60;
+   static const size_t kConfirmationSize = 256;
+   static const size_t kConfirmationCount = 16;
 };
\ No newline at end of file
@@ -0,0 +1,509 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <g3log/g3log.hpp>
+#include "MappedLog.h"
+
+namespace {
+   // the rest of the segment is skipped, the record starts the next one
+   const uint32_t kSkip = UINT32_MAX;
+   const size_t kAlignment = 8;
+   const std::string kLogPrefix = "log://";
+   const std::string kSuffix = ".log";
+   const std::string kOffsetSuffix = ".offset";
+
+   uint64_t RecordSize(const size_t payload) {
+      return (sizeof (uint32_t) + payload + kAlignment - 1) / kAlignment * kAlignment;
+   }
+
+   uint32_t LoadLength(const char* position) {
+      return reinterpret_cast<const std::atomic<uint32_t>*> (position)->load(std::memory_order_acquire);
+   }
+
+   void StoreLength(char* position, const uint32_t length) {
+      reinterpret_cast<std::atomic<uint32_t>*> (position)->store(length, std::memory_order_release);
+   }
+
+   /**
+    * @return if name is a segment file, and its index
+    */
+   bool EndsWith(const std::string& name, const std::string& suffix) {
+      return name.size() > suffix.size() &&
+              name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+   }
+
+   bool SegmentIndex(const std::string& name, uint64_t& index) {
+      if (!EndsWith(name, kSuffix)) {
+         return false;
+      }
+      const std::string digits = name.substr(0, name.size() - kSuffix.size());
+      if (digits.find_first_not_of("0123456789") != std::string::npos) {
+         return false;
+      }
+      index = std::strtoull(digits.c_str(), NULL, 10);
+      return true;
+   }
+}
+
+/**
+ * Nothing is touched on disk until Open
+ * @param directory
+ * @param segmentBytes
+ *   Size of every segment file, rounded down to 8 bytes
+ * @param maxSegments
+ *   Append fails once this many segments are kept
+ */
+MappedLog::MappedLog(const std::string& directory, const size_t segmentBytes, const size_t maxSegments) :
+mDirectory(directory),
+mSegmentBytes(segmentBytes / kAlignment * kAlignment),
+mMaxSegments(std::max<size_t>(maxSegments, 1)),
+mOpen(false),
+mBegin(0),
+mEnd(0) {
+}
+
+/**
+ * Unmap the segments, the files stay
+ */
+MappedLog::~MappedLog() {
+   while (!mSegments.empty()) {
+      Unmap(mSegments.begin()->first, false);
+   }
+}
+
+/**
+ * Create the directory if needed and map the segments in it
+ * @param keep
+ *   Keep the records found, otherwise remove them and start empty
+ * @return 
+ */
+bool MappedLog::Open(const bool keep) {
+   if (mOpen) {
+      return true;
+   }
+   if (mkdir(mDirectory.c_str(), 0777) != 0 && errno != EEXIST) {
+      LOG(WARNING) << "MappedLog could not create " << mDirectory << ": " << strerror(errno);
+      return false;
+   }
+   std::set<uint64_t> found;
+   if (!Scan(found)) {
+      LOG(WARNING) << "MappedLog could not open " << mDirectory << ": " << strerror(errno);
+      return false;
+   }
+
+   if (!keep) {
+      for (const auto index : found) {
+         unlink(SegmentName(index).c_str());
+      }
+      found.clear();
+   }
+   if (!found.empty()) {
+      struct stat status;
+      if (stat(SegmentName(*found.begin()).c_str(), &status) == 0 &&
+              static_cast<size_t> (status.st_size) != mSegmentBytes) {
+         LOG(INFO) << "MappedLog " << mDirectory << " has segments of " << status.st_size << " bytes";
+         mSegmentBytes = status.st_size;
+      }
+      for (const auto index : found) {
+         if (!Map(index, false)) {
+            return false;
+         }
+      }
+      mBegin = *found.begin() * mSegmentBytes;
+      // records never span segments, the last one is enough to find the end
+      mEnd = *found.rbegin() * mSegmentBytes;
+      const char* data = NULL;
+      uint32_t length = 0;
+      while (Locate(mEnd, data, length)) {
+         mEnd += RecordSize(length);
+      }
+   }
+   mOpen = (mSegmentBytes > sizeof (uint32_t));
+   return mOpen;
+}
+
+bool MappedLog::IsOpen() const {
+   return mOpen;
+}
+
+/**
+ * Append a record, a new segment is created when it does not fit in the
+ * last one.
+ * @param data
+ * @param size
+ * @return
+ *   false if it is empty, larger than a segment or maxSegments are kept
+ */
+bool MappedLog::Append(const void* data, const size_t size) {
+   const uint64_t record = RecordSize(size);
+   if (!mOpen || size == 0 || record > mSegmentBytes || size >= kSkip) {
+      return false;
+   }
+   uint64_t offset = mEnd;
+   uint64_t position = offset % mSegmentBytes;
+   const bool skip = (position != 0 && position + record > mSegmentBytes);
+   if (skip) {
+      offset += mSegmentBytes - position;
+      position = 0;
+   }
+   const uint64_t index = offset / mSegmentBytes;
+   auto found = mSegments.find(index);
+   char* segment = (found != mSegments.end()) ? found->second : NULL;
+   if (!segment) {
+      if (mSegments.size() >= mMaxSegments) {
+         return false;
+      }
+      segment = Map(index, true);
+      if (!segment) {
+         return false;
+      }
+   }
+   if (skip) {
+      StoreLength(mSegments[index - 1] + mEnd % mSegmentBytes, kSkip);
+   }
+   memcpy(segment + position + sizeof (uint32_t), data, size);
+   StoreLength(segment + position, size);
+   mEnd = offset + record;
+   return true;
+}
+
+/**
+ * Read the record at an offset
+ * @param offset
+ *   Moved past the record
+ * @param record
+ * @return
+ *   false if there is no record there, yet
+ */
+bool MappedLog::Read(uint64_t& offset, std::string& record) {
+   const char* data = NULL;
+   uint32_t length = 0;
+   if (!Locate(offset, data, length)) {
+      return false;
+   }
+   record.assign(data, length);
+   offset += RecordSize(length);
+   return true;
+}
+
+/**
+ * Find the record at an offset, skipping to the next segment when needed
+ * @param offset
+ *   Moved to where the record starts
+ * @param data
+ * @param length
+ * @return 
+ */
+bool MappedLog::Locate(uint64_t& offset, const char*& data, uint32_t& length) {
+   while (true) {
+      const uint64_t index = offset / mSegmentBytes;
+      const uint64_t position = offset % mSegmentBytes;
+      const char* segment = Map(index, false);
+      if (!segment) {
+         return false;
+      }
+      length = LoadLength(segment + position);
+      if (length == 0) {
+         return false;
+      }
+      if (length != kSkip) {
+         data = segment + position + sizeof (uint32_t);
+         return true;
+      }
+      offset = (index + 1) * mSegmentBytes;
+   }
+}
+
+/**
+ * Remove the segments holding only records before an offset. The last
+ * segment is kept so the offsets go on from it after a restart.
+ * @param offset
+ */
+void MappedLog::Trim(const uint64_t offset) {
+   Forget(std::min(offset, mEnd), true);
+}
+
+/**
+ * Unmap the segments holding only records before an offset, for a reader
+ * that does not own the files
+ * @param offset
+ */
+void MappedLog::Release(const uint64_t offset) {
+   Forget(offset, false);
+}
+
+/**
+ * @param offset
+ * @param remove
+ *   Also remove the files
+ */
+void MappedLog::Forget(const uint64_t offset, const bool remove) {
+   while (mSegments.size() > (remove ? 1 : 0) && (mSegments.begin()->first + 1) * mSegmentBytes <= offset) {
+      Unmap(mSegments.begin()->first, remove);
+   }
+   // released segments are still on disk and mapped again when read
+   if (remove && !mSegments.empty()) {
+      mBegin = std::max(mBegin, mSegments.begin()->first * mSegmentBytes);
+   }
+}
+
+/**
+ * Remove every segment and committed offset, offsets go on from the next
+ * segment
+ */
+void MappedLog::Clear() {
+   while (!mSegments.empty()) {
+      Unmap(mSegments.begin()->first, true);
+   }
+   if (DIR* directory = opendir(mDirectory.c_str())) {
+      while (struct dirent* entry = readdir(directory)) {
+         if (EndsWith(entry->d_name, kOffsetSuffix)) {
+            unlink((mDirectory + "/" + entry->d_name).c_str());
+         }
+      }
+      closedir(directory);
+   }
+   mEnd = (mEnd + mSegmentBytes - 1) / mSegmentBytes * mSegmentBytes;
+   mBegin = mEnd;
+}
+
+/**
+ * Flush the mapped segments to disk
+ * @return 
+ */
+bool MappedLog::Sync() {
+   bool synced = true;
+   for (const auto& segment : mSegments) {
+      synced = (msync(segment.second, mSegmentBytes, MS_SYNC) == 0) && synced;
+   }
+   return synced;
+}
+
+/**
+ * Save the offset a consumer read up to, it goes on from there after a
+ * restart
+ * @param consumer
+ *   A file name
+ * @param offset
+ * @return 
+ */
+bool MappedLog::Commit(const std::string& consumer, const uint64_t offset) {
+   const int fd = open(OffsetName(consumer).c_str(), O_CREAT | O_WRONLY, 0666);
+   const bool committed = (fd >= 0) && pwrite(fd, &offset, sizeof (offset), 0) == sizeof (offset);
+   if (!committed) {
+      LOG(WARNING) << "MappedLog could not commit " << consumer << " in " << mDirectory << ": " << strerror(errno);
+   }
+   if (fd >= 0) {
+      close(fd);
+   }
+   return committed;
+}
+
+/**
+ * @param consumer
+ * @return the offset the consumer committed, Begin if it never did
+ */
+uint64_t MappedLog::Committed(const std::string& consumer) {
+   uint64_t offset = Begin();
+   const int fd = open(OffsetName(consumer).c_str(), O_RDONLY);
+   if (fd >= 0) {
+      if (pread(fd, &offset, sizeof (offset), 0) != sizeof (offset)) {
+         offset = Begin();
+      }
+      close(fd);
+   }
+   return offset;
+}
+
+/**
+ * @param offset
+ *   The lowest offset committed by any consumer
+ * @return 
+ *   false if there is no consumer
+ */
+bool MappedLog::OldestCommitted(uint64_t& offset) {
+   DIR* directory = opendir(mDirectory.c_str());
+   if (!directory) {
+      return false;
+   }
+   bool found = false;
+   while (struct dirent* entry = readdir(directory)) {
+      const std::string name = entry->d_name;
+      if (EndsWith(name, kOffsetSuffix)) {
+         const uint64_t committed = Committed(name.substr(0, name.size() - kOffsetSuffix.size()));
+         offset = found ? std::min(offset, committed) : committed;
+         found = true;
+      }
+   }
+   closedir(directory);
+   return found;
+}
+
+/**
+ * @param location
+ * @return if the location is log://directory
+ */
+bool MappedLog::IsLog(const std::string& location) {
+   return location.compare(0, kLogPrefix.size(), kLogPrefix) == 0;
+}
+
+/**
+ * @param location
+ *   log://directory
+ * @return the directory
+ */
+std::string MappedLog::LogDirectory(const std::string& location) {
+   return location.substr(kLogPrefix.size());
+}
+
+/**
+ * @return the offset of the first record kept
+ */
+uint64_t MappedLog::Begin() const {
+   return mBegin;
+}
+
+/**
+ * Look for the oldest segment on disk, another process may have trimmed
+ * the log since Open
+ * @return the offset of the first record kept
+ */
+uint64_t MappedLog::Oldest() {
+   std::set<uint64_t> found;
+   if (mOpen && Scan(found) && !found.empty()) {
+      mBegin = *found.begin() * mSegmentBytes;
+   }
+   return mBegin;
+}
+
+/**
+ * @return the offset the next record is appended at, as far as this
+ *   process knows
+ */
+uint64_t MappedLog::End() const {
+   return mEnd;
+}
+
+size_t MappedLog::Segments() const {
+   return mSegments.size();
+}
+
+size_t MappedLog::SegmentBytes() const {
+   return mSegmentBytes;
+}
+
+const std::string& MappedLog::Directory() const {
+   return mDirectory;
+}
+
+/**
+ * @param found
+ *   The index of every segment file in the directory
+ * @return
+ *   false if the directory can't be read
+ */
+bool MappedLog::Scan(std::set<uint64_t>& found) const {
+   DIR* directory = opendir(mDirectory.c_str());
+   if (!directory) {
+      return false;
+   }
+   while (struct dirent* entry = readdir(directory)) {
+      uint64_t index = 0;
+      if (SegmentIndex(entry->d_name, index)) {
+         found.insert(index);
+      }
+   }
+   closedir(directory);
+   return true;
+}
+
+/**
+ * Map a segment
+ * @param index
+ * @param create
+ *   Create the file, it only shows up once it has its full size
+ * @return the segment, NULL if it does not exist or could not be mapped
+ */
+char* MappedLog::Map(const uint64_t index, const bool create) {
+   auto found = mSegments.find(index);
+   if (found != mSegments.end()) {
+      return found->second;
+   }
+   const std::string name = SegmentName(index);
+   int fd = -1;
+   if (create) {
+      const std::string creating = name + ".tmp";
+      fd = open(creating.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+      if (fd >= 0 && (ftruncate(fd, mSegmentBytes) != 0 || rename(creating.c_str(), name.c_str()) != 0)) {
+         LOG(WARNING) << "MappedLog could not create " << name << ": " << strerror(errno);
+         close(fd);
+         unlink(creating.c_str());
+         return NULL;
+      }
+   } else {
+      fd = open(name.c_str(), O_RDWR);
+   }
+   if (fd < 0) {
+      if (create || errno != ENOENT) {
+         LOG(WARNING) << "MappedLog could not open " << name << ": " << strerror(errno);
+      }
+      return NULL;
+   }
+   struct stat status;
+   void* mapped = MAP_FAILED;
+   if (fstat(fd, &status) == 0 && static_cast<size_t> (status.st_size) == mSegmentBytes) {
+      mapped = mmap(NULL, mSegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   }
+   close(fd);
+   if (mapped == MAP_FAILED) {
+      LOG(WARNING) << "MappedLog could not map " << name;
+      return NULL;
+   }
+   // records are read and written front to back
+   madvise(mapped, mSegmentBytes, MADV_SEQUENTIAL);
+   mSegments[index] = reinterpret_cast<char*> (mapped);
+   return mSegments[index];
+}
+
+/**
+ * @param index
+ * @param remove
+ *   Also remove the file
+ */
+void MappedLog::Unmap(const uint64_t index, const bool remove) {
+   auto found = mSegments.find(index);
+   if (found != mSegments.end()) {
+      munmap(found->second, mSegmentBytes);
+      mSegments.erase(found);
+   }
+   if (remove) {
+      unlink(SegmentName(index).c_str());
+   }
+}
+
+/**
+ * @param consumer
+ * @return the path of the offset committed by a consumer
+ */
+std::string MappedLog::OffsetName(const std::string& consumer) const {
+   return mDirectory + "/" + consumer + kOffsetSuffix;
+}
+
+/**
+ * @param index
+ * @return the path of a segment, the index zero padded so they sort
+ */
+std::string MappedLog::SegmentName(const uint64_t index) const {
+   char name[32];
+   snprintf(name, sizeof (name), "%020llu", static_cast<unsigned long long> (index));
+   return mDirectory + "/" + name + kSuffix;
+}
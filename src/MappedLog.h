@@ -0,0 +1,86 @@
+/*
+ * File:   MappedLog.h
+ *
+ * Append only log of records in memory mapped segment files. It is where a
+ * Rifle spills bullets its Vampires can't take yet, and the data path of a
+ * Rifle and Vampire using a log:// location.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+
+/**
+ * The log is a directory of segment files of the same size, named after
+ * their index. A record is its length followed by its bytes, padded to 8
+ * bytes. A record that does not fit in the rest of a segment starts the
+ * next one.
+ *
+ * A position in the log is an offset, the bytes in front of it counting
+ * every segment ever created. Segments before an offset are removed with
+ * Trim, at most maxSegments are kept so the disk used is bounded.
+ *
+ * Records are appended by one writer, the length is stored after the bytes
+ * so a reader mapping the same files never sees half a record.
+ *
+ * Readers are named consumers, each commits the offset it read up to in a
+ * file next to the segments. The writer only trims what every consumer
+ * committed, see OldestCommitted.
+ */
+class MappedLog {
+public:
+   MappedLog(const std::string& directory, const size_t segmentBytes = kDefaultSegmentBytes,
+           const size_t maxSegments = kDefaultMaxSegments);
+   virtual ~MappedLog();
+
+   bool Open(const bool keep);
+   bool IsOpen() const;
+
+   bool Append(const void* data, const size_t size);
+   bool Read(uint64_t& offset, std::string& record);
+   void Trim(const uint64_t offset);
+   void Release(const uint64_t offset);
+   void Clear();
+   bool Sync();
+
+   bool Commit(const std::string& consumer, const uint64_t offset);
+   uint64_t Committed(const std::string& consumer);
+   bool OldestCommitted(uint64_t& offset);
+
+   uint64_t Begin() const;
+   uint64_t Oldest();
+   uint64_t End() const;
+   size_t Segments() const;
+   size_t SegmentBytes() const;
+   const std::string& Directory() const;
+
+   static bool IsLog(const std::string& location);
+   static std::string LogDirectory(const std::string& location);
+
+   static const size_t kDefaultSegmentBytes = 64 * 1024 * 1024;
+   static const size_t kDefaultMaxSegments = 16;
+
+private:
+   MappedLog(const MappedLog&) = delete;
+   MappedLog& operator=(const MappedLog&) = delete;
+
+   bool Scan(std::set<uint64_t>& found) const;
+   bool Locate(uint64_t& offset, const char*& data, uint32_t& length);
+   char* Map(const uint64_t index, const bool create);
+   void Unmap(const uint64_t index, const bool remove);
+   void Forget(const uint64_t offset, const bool remove);
+   std::string SegmentName(const uint64_t index) const;
+   std::string OffsetName(const std::string& consumer) const;
+
+   const std::string mDirectory;
+   // the size of the segments found on Open wins
+   size_t mSegmentBytes;
+   const size_t mMaxSegments;
+   bool mOpen;
+   uint64_t mBegin;
+   uint64_t mEnd;
+   // mapped segments by index
+   std::map<uint64_t, char*> mSegments;
+};
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include "Metrics.h"
+
+namespace {
+   std::string Escape(const std::string& text) {
+      std::string escaped;
+      for (const char c : text) {
+         if (c == '"' || c == '\\') {
+            escaped += '\\';
+         }
+         escaped += c;
+      }
+      return escaped;
+   }
+}
+
+/**
+ * Counters start at zero and are registered until destruction
+ * @param endpoint
+ *   The kind of endpoint, i.e. Rifle
+ * @param location
+ */
+Metrics::Metrics(const std::string& endpoint, const std::string& location) :
+mEndpoint(endpoint),
+mLocation(location),
+mMessages(0),
+mBytes(0),
+mTimeouts(0),
+mErrors(0),
+mDropped(0),
+mBlocked(0) {
+   for (auto& bucket : mLatency) {
+      bucket = 0;
+   }
+   MetricsRegistry::Instance().Register(this);
+}
+
+Metrics::~Metrics() {
+   MetricsRegistry::Instance().Unregister(this);
+}
+
+/**
+ * @return a monotonic time in microseconds, the start of a measurement
+ */
+uint64_t Metrics::Now() {
+   using namespace std::chrono;
+   return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * A message was sent or received
+ * @param bytes
+ * @param start
+ *   Now() when the send or receive began
+ */
+void Metrics::Count(const size_t bytes, const uint64_t start) {
+   mMessages.fetch_add(1, std::memory_order_relaxed);
+   mBytes.fetch_add(bytes, std::memory_order_relaxed);
+   const uint64_t elapsed = Now() - start;
+   size_t bucket = 0;
+   while (bucket < kLatencyBuckets - 1 && elapsed >= (uint64_t(1) << bucket)) {
+      ++bucket;
+   }
+   mLatency[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * The socket was waited on since start
+ * @param start
+ */
+void Metrics::Blocked(const uint64_t start) {
+   mBlocked.fetch_add(Now() - start, std::memory_order_relaxed);
+}
+
+/**
+ * The socket was waited on since start without getting anything done
+ * @param start
+ */
+void Metrics::Timeout(const uint64_t start) {
+   mTimeouts.fetch_add(1, std::memory_order_relaxed);
+   Blocked(start);
+}
+
+/**
+ * A message was lost or invalid
+ */
+void Metrics::Error() {
+   mErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Messages were dropped to not block, or could not be sent at all
+ * @param count
+ */
+void Metrics::Drop(const uint64_t count) {
+   mDropped.fetch_add(count, std::memory_order_relaxed);
+}
+
+const std::string& Metrics::Endpoint() const {
+   return mEndpoint;
+}
+
+const std::string& Metrics::Location() const {
+   return mLocation;
+}
+
+uint64_t Metrics::Messages() const {
+   return mMessages.load(std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Bytes() const {
+   return mBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Timeouts() const {
+   return mTimeouts.load(std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Errors() const {
+   return mErrors.load(std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Dropped() const {
+   return mDropped.load(std::memory_order_relaxed);
+}
+
+uint64_t Metrics::BlockedMicroseconds() const {
+   return mBlocked.load(std::memory_order_relaxed);
+}
+
+/**
+ * @return the count of every latency bucket
+ */
+std::vector<uint64_t> Metrics::LatencyHistogram() const {
+   std::vector<uint64_t> histogram;
+   for (const auto& bucket : mLatency) {
+      histogram.push_back(bucket.load(std::memory_order_relaxed));
+   }
+   return histogram;
+}
+
+/**
+ * @param percentile
+ *   Between 0 and 100
+ * @return the upper bound in microseconds of the bucket holding the
+ *   percentile, 0 if nothing was counted
+ */
+uint64_t Metrics::LatencyPercentile(const double percentile) const {
+   const std::vector<uint64_t> histogram = LatencyHistogram();
+   uint64_t total = 0;
+   for (const auto count : histogram) {
+      total += count;
+   }
+   if (total == 0) {
+      return 0;
+   }
+   const double wanted = std::max(1.0, total * std::min(percentile, 100.0) / 100.0);
+   uint64_t seen = 0;
+   for (size_t bucket = 0; bucket < histogram.size(); ++bucket) {
+      seen += histogram[bucket];
+      if (seen >= wanted) {
+         return uint64_t(1) << bucket;
+      }
+   }
+   return uint64_t(1) << (kLatencyBuckets - 1);
+}
+
+/**
+ * @return one line with every counter
+ */
+std::string Metrics::ToText() const {
+   std::ostringstream text;
+   text << mEndpoint << " " << mLocation
+           << " messages=" << Messages()
+           << " bytes=" << Bytes()
+           << " timeouts=" << Timeouts()
+           << " errors=" << Errors()
+           << " dropped=" << Dropped()
+           << " blocked_us=" << BlockedMicroseconds()
+           << " latency_us_p50=" << LatencyPercentile(50)
+           << " latency_us_p99=" << LatencyPercentile(99)
+           << " latency_us_p999=" << LatencyPercentile(99.9);
+   return text.str();
+}
+
+/**
+ * @return a JSON object with every counter and the latency histogram
+ */
+std::string Metrics::ToJson() const {
+   std::ostringstream json;
+   json << "{\"endpoint\":\"" << Escape(mEndpoint) << "\""
+           << ",\"location\":\"" << Escape(mLocation) << "\""
+           << ",\"messages\":" << Messages()
+           << ",\"bytes\":" << Bytes()
+           << ",\"timeouts\":" << Timeouts()
+           << ",\"errors\":" << Errors()
+           << ",\"dropped\":" << Dropped()
+           << ",\"blocked_us\":" << BlockedMicroseconds()
+           << ",\"latency_us\":{\"p50\":" << LatencyPercentile(50)
+           << ",\"p99\":" << LatencyPercentile(99)
+           << ",\"p999\":" << LatencyPercentile(99.9)
+           << ",\"buckets\":[";
+   const std::vector<uint64_t> histogram = LatencyHistogram();
+   for (size_t bucket = 0; bucket < histogram.size(); ++bucket) {
+      json << (bucket ? "," : "") << histogram[bucket];
+   }
+   json << "]}}";
+   return json.str();
+}
+
+/**
+ * @return the registry of the process
+ */
+MetricsRegistry& MetricsRegistry::Instance() {
+   static MetricsRegistry registry;
+   return registry;
+}
+
+void MetricsRegistry::Register(const Metrics* metrics) {
+   std::lock_guard<std::mutex> guard(mLock);
+   mMetrics.insert(metrics);
+}
+
+void MetricsRegistry::Unregister(const Metrics* metrics) {
+   std::lock_guard<std::mutex> guard(mLock);
+   mMetrics.erase(metrics);
+}
+
+/**
+ * @return the number of endpoints alive
+ */
+size_t MetricsRegistry::Size() {
+   std::lock_guard<std::mutex> guard(mLock);
+   return mMetrics.size();
+}
+
+/**
+ * @return a line per endpoint
+ */
+std::string MetricsRegistry::DumpText() {
+   std::lock_guard<std::mutex> guard(mLock);
+   std::string text;
+   for (const auto metrics : mMetrics) {
+      text += metrics->ToText() + "\n";
+   }
+   return text;
+}
+
+/**
+ * @return a JSON array with an object per endpoint
+ */
+std::string MetricsRegistry::DumpJson() {
+   std::lock_guard<std::mutex> guard(mLock);
+   std::string json = "[";
+   for (const auto metrics : mMetrics) {
+      json += (json.size() > 1 ? "," : "") + metrics->ToJson();
+   }
+   return json + "]";
+}
@@ -0,0 +1,94 @@
+/*
+ * File:   Metrics.h
+ *
+ * Counters of a queue endpoint and the registry of every endpoint in the
+ * process.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Lock free counters of one endpoint. Updates are relaxed atomic increments,
+ * reading them while the endpoint runs gives a consistent enough picture.
+ *
+ * dropped counts messages given up on purpose to not block, see
+ * Rifle::SetOverload, and records of a coalesced frame that could not be
+ * fired, see SendDpiMsgLRZMQ::Flush.
+ *
+ * blocked is the time spent waiting on the socket: for a Rifle waiting for
+ * room below the high water mark, for a Vampire waiting for shots. Latency
+ * is a histogram of how long every successful send or receive took,
+ * including that wait, in power of two microsecond buckets.
+ */
+class Metrics {
+public:
+   Metrics(const std::string& endpoint, const std::string& location);
+   virtual ~Metrics();
+
+   static uint64_t Now();
+   void Count(const size_t bytes, const uint64_t start);
+   void Blocked(const uint64_t start);
+   void Timeout(const uint64_t start);
+   void Error();
+   void Drop(const uint64_t count = 1);
+
+   const std::string& Endpoint() const;
+   const std::string& Location() const;
+   uint64_t Messages() const;
+   uint64_t Bytes() const;
+   uint64_t Timeouts() const;
+   uint64_t Errors() const;
+   uint64_t Dropped() const;
+   uint64_t BlockedMicroseconds() const;
+   uint64_t LatencyPercentile(const double percentile) const;
+   std::vector<uint64_t> LatencyHistogram() const;
+
+   std::string ToText() const;
+   std::string ToJson() const;
+
+   static const size_t kLatencyBuckets = 32;
+
+private:
+   Metrics(const Metrics&) = delete;
+   Metrics& operator=(const Metrics&) = delete;
+
+   const std::string mEndpoint;
+   const std::string mLocation;
+   std::atomic<uint64_t> mMessages;
+   std::atomic<uint64_t> mBytes;
+   std::atomic<uint64_t> mTimeouts;
+   std::atomic<uint64_t> mErrors;
+   std::atomic<uint64_t> mDropped;
+   std::atomic<uint64_t> mBlocked;
+   // bucket n counts latencies below 2^n microseconds, the last one the rest
+   std::atomic<uint64_t> mLatency[kLatencyBuckets];
+};
+
+/**
+ * Every Metrics registers itself for its lifetime, Dump shows all endpoints
+ * of the process on demand.
+ */
+class MetricsRegistry {
+public:
+   static MetricsRegistry& Instance();
+
+   void Register(const Metrics* metrics);
+   void Unregister(const Metrics* metrics);
+   size_t Size();
+   std::string DumpText();
+   std::string DumpJson();
+
+private:
+   MetricsRegistry() = default;
+   MetricsRegistry(const MetricsRegistry&) = delete;
+   MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+   std::mutex mLock;
+   std::set<const Metrics*> mMetrics;
+};
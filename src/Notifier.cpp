@@ -10,7 +10,6 @@
 #include <memory>
 #include <Shotgun.h>
 #include <Vampire.h>
-#include <StopWatch.h>
 
 std::unique_ptr<Notifier>  Notifier::CreateNotifier(const std::string& notifierQueue, const std::string& handshakeQueue, const size_t handshakeCount) {
 
@@ -57,7 +56,12 @@ bool Notifier::Initialize(const size_t handshakeCount) {
          Reset();
       }
    }
-   return (gQueue.get() != nullptr) && (gHandshakeQueue.get() != nullptr);
+   const bool initialized = (gQueue.get() != nullptr) && (gHandshakeQueue.get() != nullptr);
+   if (initialized && !mCollecting) {
+      mCollecting = true;
+      mCollector = std::thread(&Notifier::CollectConfirmations, this);
+   }
+   return initialized;
 }
 
 /*
@@ -116,53 +120,147 @@ size_t Notifier::Notify() {
  * @return number of confirmed updates
  */
 size_t Notifier::Notify(const std::vector<std::string>& messages) {
+   auto notification = NotifyAsync(messages);
+   size_t confirmed = notification->Wait();
+   LOG(INFO) << "Notifier received " << confirmed << " handshakes";
+   return {confirmed};
+}
+
+/*
+ * Fire a message from the Shotgun to be read by the queue subscriber
+ *    without waiting for the listeners. Their confirmations are
+ *    collected in the background until the deadline.
+ *
+ * @param vector of strings to be sent to the listeners
+ * @return handle to wait for or poll the confirmations
+ */
+std::shared_ptr<Notifier::Notification> Notifier::NotifyAsync(const std::vector<std::string>& messages) {
    std::lock_guard<std::mutex> guard(gLock);
-   std::vector<std::string> bullets;
-   bullets.push_back("dummy");
+   auto notification = std::make_shared<Notification>(mNextId++, gHandshakeCount,
+           std::chrono::steady_clock::now() + mDeadline);
+   if (QueuesAreUnitialized()) {
+      LOG(WARNING) << "Uninitialized notifier queues";
+      notification->Finish();
+      return notification;
+   }
 
+   // the first bullet identifies the notification, listeners echo it back
+   std::vector<std::string> bullets;
+   bullets.push_back(NotificationId(notification->Id()));
    for (auto& msg : messages) {
       bullets.push_back(msg);
    }
 
-   if (QueuesAreUnitialized()) {
-      LOG(WARNING) << "Uninitialized notifier queues";
-      return {0};
+   if (gHandshakeCount > 0) {
+      std::lock_guard<std::mutex> pendingGuard(mPendingLock);
+      mPending.push_back(notification);
+   } else {
+      notification->Finish();
    }
    LOG(INFO) << "Notifier: Sending " << bullets.size() << " messages";
    gQueue->Fire(bullets);
-   size_t confirmed = ReceiveConfirmation();
-   LOG(INFO) << "Notifier received " << confirmed << " handshakes";
-   return {confirmed};
+   return notification;
 }
 
 /*
-*  Receive confirmation from listener threads that
-*     they have been notified successfully
+ * How long the listeners have to confirm a notification, applies to
+ *    notifications fired after the call
+ *
+ * @param deadline
+ */
+void Notifier::SetDeadline(const std::chrono::milliseconds& deadline) {
+   std::lock_guard<std::mutex> guard(gLock);
+   mDeadline = deadline;
+}
+
+/*
+*  Background loop receiving the confirmations from listener
+*     threads that they have been notified successfully
+*/
+void Notifier::CollectConfirmations() {
+   const int kCollectIntervalMs = 100;
+   while (mCollecting) {
+      std::string confirmation;
+      if (gHandshakeQueue->GetShot(confirmation, kCollectIntervalMs)) {
+         ReceiveConfirmation(confirmation);
+      }
+      ExpireNotifications();
+   }
+}
+
+/*
+*  Hand a confirmation to the notification it confirms
 *
-*  @return size_t, number of confirmations received
+*  @param confirmation, the listener identity followed by the
+*     id of the notification it received
 */
-size_t Notifier::ReceiveConfirmation() {
-   StopWatch waitCheck;
-   size_t responses = 0;
-   while (responses < gHandshakeCount && waitCheck.ElapsedSec() < gMaxTimeoutInSec) {
-      std::string msg;
-      if (gHandshakeQueue->GetShot(msg, gMaxTimeoutInSec)) {
+void Notifier::ReceiveConfirmation(const std::string& confirmation) {
+   std::string listener = confirmation;
+   std::string id;
+   const size_t separator = confirmation.rfind(kConfirmationSeparator);
+   if (separator != std::string::npos) {
+      listener = confirmation.substr(0, separator);
+      id = confirmation.substr(separator + 1);
+   }
+
+   std::lock_guard<std::mutex> guard(mPendingLock);
+   for (auto& pending : mPending) {
+      // a confirmation without an id goes to the oldest notification
+      // that listener has not confirmed yet
+      const bool match = id.empty() ? !pending->HasConfirmed(listener)
+                                    : NotificationId(pending->Id()) == id;
+      if (match && pending->Confirm(listener)) {
          LOG(INFO) << "Received update confirmation from thread #"
-                   << msg << ", response count #" << ++responses;
+                   << listener << ", response count #" << pending->Confirmed();
+         return;
       }
    }
+   LOG(INFO) << "Ignoring unexpected confirmation from thread #" << listener;
+}
 
-   const bool goodEnough = waitCheck.ElapsedSec() < gMaxTimeoutInSec || responses == gHandshakeCount;
+/*
+*  Drop the notifications that are confirmed or past their deadline
+*/
+void Notifier::ExpireNotifications() {
+   const auto now = std::chrono::steady_clock::now();
+   std::lock_guard<std::mutex> guard(mPendingLock);
+   while (!mPending.empty()) {
+      auto& oldest = mPending.front();
+      if (oldest->IsDone()) {
+         mPending.pop_front();
+      } else if (now >= oldest->mDeadline) {
+         LOG(WARNING) << "Listener confirmation timed out for " << NotificationId(oldest->Id())
+                      << "... " << oldest->Confirmed() << "/" << oldest->mExpected << " replied";
+         oldest->Finish();
+         mPending.pop_front();
+      } else {
+         break;
+      }
+   }
+}
 
-   LOG_IF(WARNING, !goodEnough) << "Listener confirmation timed out after" << gMaxTimeoutInSec
-                                << "seconds... " << responses << "/" << gHandshakeCount << " replied";
-   return responses;
+/*
+*  @return the notification id sent as the first bullet
+*/
+std::string Notifier::NotificationId(const uint64_t id) const {
+   return kNotificationIdPrefix + std::to_string(id);
 }
 
 /*
- * Reset the Shotgun-Alien queue to nullptr
+ * Stop collecting confirmations and reset the Shotgun-Alien queue to nullptr
  */
 void Notifier::Reset() {
+   mCollecting = false;
+   if (mCollector.joinable()) {
+      mCollector.join();
+   }
+   {
+      std::lock_guard<std::mutex> pendingGuard(mPendingLock);
+      for (auto& pending : mPending) {
+         pending->Finish();
+      }
+      mPending.clear();
+   }
    std::lock_guard<std::mutex> guard(gLock);
    gQueue.reset(nullptr);
    gHandshakeQueue.reset(nullptr);
@@ -188,3 +286,93 @@ std::string Notifier::GetHandshakeQueueName() {
 bool Notifier::QueuesAreUnitialized() {
    return (gQueue.get() == nullptr || gHandshakeQueue.get() == nullptr); 
 }
+
+/**
+ * @param id of the notification
+ * @param expected number of listener confirmations
+ * @param deadline to stop waiting for confirmations
+ */
+Notifier::Notification::Notification(const uint64_t id, const size_t expected,
+        const std::chrono::steady_clock::time_point& deadline)
+   : mId(id),
+     mExpected(expected),
+     mDeadline(deadline),
+     mFinished(false) {}
+
+/**
+ * Block until every expected listener confirmed or the deadline passed
+ *
+ * @return number of confirmed updates
+ */
+size_t Notifier::Notification::Wait() {
+   std::unique_lock<std::mutex> lock(mLock);
+   mDone.wait_until(lock, mDeadline, [this] { return mFinished; });
+   return mListeners.size();
+}
+
+/**
+ * @return whether no more confirmations are expected
+ */
+bool Notifier::Notification::IsDone() const {
+   std::lock_guard<std::mutex> guard(mLock);
+   return mFinished || std::chrono::steady_clock::now() >= mDeadline;
+}
+
+/**
+ * @return number of confirmed updates so far
+ */
+size_t Notifier::Notification::Confirmed() const {
+   std::lock_guard<std::mutex> guard(mLock);
+   return mListeners.size();
+}
+
+/**
+ * @return the identities of the listeners that confirmed so far
+ */
+std::vector<std::string> Notifier::Notification::ConfirmedListeners() const {
+   std::lock_guard<std::mutex> guard(mLock);
+   return std::vector<std::string>(mListeners.begin(), mListeners.end());
+}
+
+/**
+ * @return the id sent with the notification
+ */
+uint64_t Notifier::Notification::Id() const {
+   return mId;
+}
+
+/**
+ * Count a listener's confirmation, a listener is only counted once
+ *
+ * @param listener identity
+ * @return whether the confirmation was counted
+ */
+bool Notifier::Notification::Confirm(const std::string& listener) {
+   std::lock_guard<std::mutex> guard(mLock);
+   if (mFinished || !mListeners.insert(listener).second) {
+      return false;
+   }
+   if (mListeners.size() >= mExpected) {
+      mFinished = true;
+      mDone.notify_all();
+   }
+   return true;
+}
+
+/**
+ * @param listener identity
+ * @return whether the listener already confirmed
+ */
+bool Notifier::Notification::HasConfirmed(const std::string& listener) const {
+   std::lock_guard<std::mutex> guard(mLock);
+   return mListeners.find(listener) != mListeners.end();
+}
+
+/**
+ * Stop waiting for confirmations
+ */
+void Notifier::Notification::Finish() {
+   std::lock_guard<std::mutex> guard(mLock);
+   mFinished = true;
+   mDone.notify_all();
+}
@@ -5,8 +5,16 @@
  */
 
 #pragma once
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <memory>
+#include <set>
+#include <string>
+#include <thread>
 #include <vector>
 
 class Shotgun;
@@ -14,14 +22,49 @@ class Vampire;
 
 class Notifier {
  public:
+   /**
+    * Handle to a notification that was fired. The confirmations of the
+    * listeners are collected in the background until every expected
+    * listener has confirmed or the deadline has passed.
+    */
+   class Notification {
+    public:
+      Notification(const uint64_t id, const size_t expected, const std::chrono::steady_clock::time_point& deadline);
+      size_t Wait();
+      bool IsDone() const;
+      size_t Confirmed() const;
+      std::vector<std::string> ConfirmedListeners() const;
+      uint64_t Id() const;
+
+    private:
+      friend class Notifier;
+      Notification(const Notification&) = delete;
+      Notification& operator=(const Notification&) = delete;
+      bool Confirm(const std::string& listener);
+      bool HasConfirmed(const std::string& listener) const;
+      void Finish();
+
+      const uint64_t mId;
+      const size_t mExpected;
+      const std::chrono::steady_clock::time_point mDeadline;
+      mutable std::mutex mLock;
+      std::condition_variable mDone;
+      std::set<std::string> mListeners;
+      bool mFinished;
+   };
+
    static std::unique_ptr<Notifier>  CreateNotifier(const std::string& notifierQueue, const std::string& handshakeQueue, const size_t handshakeCount);
+   std::shared_ptr<Notification> NotifyAsync(const std::vector<std::string>& messages);
    size_t Notify(const std::vector<std::string>& messages);
    size_t Notify(const std::string& message);
    size_t Notify();
+   void SetDeadline(const std::chrono::milliseconds& deadline);
    virtual ~Notifier();
 
+   // separates the listener identity from the notification id in a confirmation
+   static const char kConfirmationSeparator = '|';
+
  protected:
-   size_t ReceiveConfirmation();
    std::unique_ptr<Vampire> CreateHandshakeQueue();
    void Reset();
 
@@ -30,6 +73,10 @@ class Notifier {
    Notifier(const std::string& notifierQueue, const std::string& handshakeQueue);
 
    bool Initialize(const size_t handshakeCount);
+   void CollectConfirmations();
+   void ReceiveConfirmation(const std::string& confirmation);
+   void ExpireNotifications();
+   std::string NotificationId(const uint64_t id) const;
 
    std::string GetNotifierQueueName();
    std::string GetHandshakeQueueName();
@@ -40,6 +87,13 @@ class Notifier {
    std::unique_ptr<Shotgun> gQueue;
    std::unique_ptr<Vampire> gHandshakeQueue;
    size_t gHandshakeCount = 0;
-   const size_t gMaxTimeoutInSec = 60;
+   std::chrono::milliseconds mDeadline = std::chrono::seconds(60);
    const std::string kNotifyMessage = "notify";
+   const std::string kNotificationIdPrefix = "notification:";
+
+   uint64_t mNextId = 0;
+   std::mutex mPendingLock;
+   std::deque<std::shared_ptr<Notification>> mPending;
+   std::atomic<bool> mCollecting{false};
+   std::thread mCollector;
 };
@@ -0,0 +1,18 @@
+/*
+ * File:   PackedStake.h
+ *
+ * A stake and the hash of its data as it goes on the wire with
+ * Rifle::FireBatch and Vampire::GetBatch.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Same content as the std::pair<void*, unsigned int> of FireStakes without
+ * its trailing padding: 12 bytes per stake instead of 16 on 64 bit.
+ */
+struct PackedStake {
+   void* stake;
+   uint32_t hash;
+} __attribute__((packed));
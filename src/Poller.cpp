@@ -0,0 +1,222 @@
+#include <czmq.h>
+#include <g3log/g3log.hpp>
+
+#include "Poller.h"
+#include "Vampire.h"
+#include "Alien.h"
+#include "Headcrab.h"
+#include "Harpoon.h"
+#include "BoomStick.h"
+
+Poller::Poller() {
+}
+
+Poller::~Poller() {
+}
+
+/**
+ * Call ready when the vampire can be shot
+ * @param vampire
+ *   Must be prepared to be shot, not on a shm:// location: its body is only
+ *   signalled while it waits in GetShot, nor on a log:// location that has
+ *   no body
+ * @param ready
+ * @return if the vampire was added
+ */
+bool Poller::Add(Vampire& vampire, Ready ready) {
+   if (vampire.mRing || vampire.mLog) {
+      LOG(WARNING) << "Poller can't wait on " << vampire.GetBinding();
+      return false;
+   }
+   return Add(vampire.mBody, -1, ready, nullptr);
+}
+
+/**
+ * Call ready when the alien can be shot, including shots a conflating alien
+ * already holds
+ * @param alien
+ *   Must be prepared to be shot
+ * @param ready
+ * @return if the alien was added
+ */
+bool Poller::Add(Alien& alien, Ready ready) {
+   Alien* held = &alien;
+   return Add(alien.mBody, -1, ready, [held] {
+      return !held->mConflatedOrder.empty();
+   });
+}
+
+/**
+ * Call ready when the headcrab is hit, the callback must send the splatter
+ * @param headcrab
+ *   Must have come to life
+ * @param ready
+ * @return if the headcrab was added
+ */
+bool Poller::Add(Headcrab& headcrab, Ready ready) {
+   return Add(headcrab.mFace, -1, ready, nullptr);
+}
+
+/**
+ * Call ready when the harpoon has data to heave
+ * @param harpoon
+ *   Must be aimed
+ * @param ready
+ * @return if the harpoon was added
+ */
+bool Poller::Add(Harpoon& harpoon, Ready ready) {
+   return Add(harpoon.mDealer, -1, ready, nullptr);
+}
+
+/**
+ * Call ready when an async reply arrives on the boomstick
+ * @param boomstick
+ *   Must be initialized
+ * @param ready
+ * @return if the boomstick was added
+ */
+bool Poller::Add(BoomStick& boomstick, Ready ready) {
+   return Add(boomstick.mChamber, -1, ready, nullptr);
+}
+
+/**
+ * Call ready when the ZeroMQ socket can be read from
+ * @param socket
+ * @param ready
+ * @return if the socket was added
+ */
+bool Poller::Add(void* socket, Ready ready) {
+   return Add(socket, -1, ready, nullptr);
+}
+
+/**
+ * Call ready when a plain file descriptor (pipe, eventfd, tcp socket) is
+ * readable
+ * @param fd
+ * @param ready
+ * @return if the descriptor was added
+ */
+bool Poller::AddFileDescriptor(const int fd, Ready ready) {
+   if (fd < 0) {
+      LOG(WARNING) << "Poller cannot add an invalid file descriptor";
+      return false;
+   }
+   return Add(nullptr, fd, ready, nullptr);
+}
+
+/**
+ * Register a socket or, when the socket is NULL, a file descriptor
+ * @param socket
+ * @param fd
+ * @param ready
+ * @param held
+ *   Optional check for messages held outside the socket
+ * @return if it was added
+ */
+bool Poller::Add(void* socket, const int fd, Ready ready, std::function<bool()> held) {
+   if (!ready) {
+      LOG(WARNING) << "Poller needs a callback for every endpoint";
+      return false;
+   }
+   if (socket == nullptr && fd < 0) {
+      LOG(WARNING) << "Poller cannot add an endpoint that is not initialized";
+      return false;
+   }
+   for (const auto& item : mItems) {
+      if (item.socket == socket && item.fd == fd) {
+         LOG(WARNING) << "Poller already has the endpoint";
+         return false;
+      }
+   }
+   zmq_pollitem_t item = {socket, fd, ZMQ_POLLIN, 0};
+   mItems.push_back(item);
+   mCallbacks.push_back(ready);
+   mHeld.push_back(held);
+   return true;
+}
+
+bool Poller::Remove(Vampire& vampire) {
+   return Remove(vampire.mBody, -1);
+}
+
+bool Poller::Remove(Alien& alien) {
+   return Remove(alien.mBody, -1);
+}
+
+bool Poller::Remove(Headcrab& headcrab) {
+   return Remove(headcrab.mFace, -1);
+}
+
+bool Poller::Remove(Harpoon& harpoon) {
+   return Remove(harpoon.mDealer, -1);
+}
+
+bool Poller::Remove(BoomStick& boomstick) {
+   return Remove(boomstick.mChamber, -1);
+}
+
+bool Poller::Remove(void* socket) {
+   return Remove(socket, -1);
+}
+
+bool Poller::RemoveFileDescriptor(const int fd) {
+   return Remove(nullptr, fd);
+}
+
+/**
+ * Stop polling an endpoint
+ * @param socket
+ * @param fd
+ * @return if the endpoint was registered
+ */
+bool Poller::Remove(void* socket, const int fd) {
+   for (size_t i = 0; i < mItems.size(); i++) {
+      if (mItems[i].socket == socket && mItems[i].fd == fd) {
+         mItems.erase(mItems.begin() + i);
+         mCallbacks.erase(mCallbacks.begin() + i);
+         mHeld.erase(mHeld.begin() + i);
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * Wait until any endpoint is ready and call the callbacks of the ready ones
+ * @param timeoutMs
+ *   How long to wait, -1 waits forever
+ * @return
+ *   The number of callbacks called, -1 if interrupted or on failure
+ */
+int Poller::Poll(const int timeoutMs) {
+   int wait = timeoutMs;
+   for (const auto& held : mHeld) {
+      if (held && held()) {
+         wait = 0;
+         break;
+      }
+   }
+
+   if (zmq_poll(mItems.data(), mItems.size(), wait) < 0) {
+      if (zmq_errno() != EINTR) {
+         LOG(WARNING) << "Poller failed: " << zmq_strerror(zmq_errno());
+      }
+      return -1;
+   }
+
+   int dispatched = 0;
+   for (size_t i = 0; i < mItems.size(); i++) {
+      if ((mItems[i].revents & ZMQ_POLLIN) || (mHeld[i] && mHeld[i]())) {
+         mCallbacks[i]();
+         dispatched++;
+      }
+   }
+   return dispatched;
+}
+
+/**
+ * @return the number of endpoints polled
+ */
+size_t Poller::Size() const {
+   return mItems.size();
+}
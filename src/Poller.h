@@ -0,0 +1,67 @@
+/*
+ * File:   Poller.h
+ *
+ * Wait on any mix of QueueNado endpoints with a single zmq_poll.
+ */
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <zmq.h>
+
+class Vampire;
+class Alien;
+class Headcrab;
+class Harpoon;
+class BoomStick;
+
+/**
+ * A thread consuming from several endpoints registers each of them together
+ * with a callback. Poll waits until at least one of them can be read from and
+ * calls the callbacks of the ready endpoints, in the order they were added.
+ *
+ * The callbacks should read from their endpoint without waiting (a timeout of
+ * 0). The poll is level triggered so an endpoint that is not fully drained is
+ * ready again on the next Poll.
+ *
+ * Endpoints must be initialized (bound or connected) before they are added,
+ * must outlive the Poller and must not be added or removed from a callback.
+ */
+class Poller {
+public:
+   typedef std::function<void()> Ready;
+
+   Poller();
+   virtual ~Poller();
+
+   bool Add(Vampire& vampire, Ready ready);
+   bool Add(Alien& alien, Ready ready);
+   bool Add(Headcrab& headcrab, Ready ready);
+   bool Add(Harpoon& harpoon, Ready ready);
+   bool Add(BoomStick& boomstick, Ready ready);
+   bool Add(void* socket, Ready ready);
+   bool AddFileDescriptor(const int fd, Ready ready);
+
+   bool Remove(Vampire& vampire);
+   bool Remove(Alien& alien);
+   bool Remove(Headcrab& headcrab);
+   bool Remove(Harpoon& harpoon);
+   bool Remove(BoomStick& boomstick);
+   bool Remove(void* socket);
+   bool RemoveFileDescriptor(const int fd);
+
+   int Poll(const int timeoutMs);
+   size_t Size() const;
+
+private:
+   Poller(const Poller&) = delete;
+   Poller& operator=(const Poller&) = delete;
+
+   bool Add(void* socket, const int fd, Ready ready, std::function<bool()> held);
+   bool Remove(void* socket, const int fd);
+
+   std::vector<zmq_pollitem_t> mItems;
+   std::vector<Ready> mCallbacks;
+   // messages already read off a socket (a conflating Alien) do not wake zmq_poll
+   std::vector<std::function<bool()> > mHeld;
+};
@@ -0,0 +1,305 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <czmq.h>
+#include <g3log/g3log.hpp>
+
+#include "Reactor.h"
+#include "Rifle.h"
+#include "Vampire.h"
+#include "Harpoon.h"
+
+namespace {
+   const int kIdleWaitMs = 100;
+   const int kBacklogRetryMs = 1;
+   // keeps one busy Vampire or Harpoon from starving the others
+   const int kMaxShotsPerWake = 256;
+}
+
+Reactor::Reactor() :
+mBacklogSize(0),
+mWakeup{-1, -1},
+mRunning(false) {
+}
+
+/**
+ * Stop the reactor thread, Rifles and Vampires are not destroyed
+ */
+Reactor::~Reactor() {
+   Stop();
+}
+
+/**
+ * Start the reactor thread
+ * @return
+ *   If the reactor is running
+ */
+bool Reactor::Start() {
+   if (!mRunning && mThread.joinable()) {
+      // the thread stopped on an interrupt
+      Stop();
+   }
+   std::lock_guard<std::mutex> guard(mLock);
+   if (mRunning) {
+      return true;
+   }
+   if (pipe2(mWakeup, O_NONBLOCK | O_CLOEXEC) != 0) {
+      LOG(WARNING) << "Reactor could not create its wakeup pipe";
+      return false;
+   }
+   const int wakeup = mWakeup[0];
+   mPoller.AddFileDescriptor(wakeup, [wakeup] {
+      char drain[64];
+      while (read(wakeup, drain, sizeof (drain)) > 0) {
+      }
+   });
+   mRunning = true;
+   mThread = std::thread(&Reactor::Run, this);
+   return true;
+}
+
+/**
+ * Stop the reactor thread. Queued tasks are still run, bullets that were not
+ * fired yet are dropped and their futures set to false. Called from a
+ * reactor callback the thread stops after the callback, it is joined by the
+ * next Start, Stop or the destructor.
+ */
+void Reactor::Stop() {
+   {
+      std::lock_guard<std::mutex> guard(mLock);
+      mRunning = false;
+   }
+   if (!mThread.joinable() || std::this_thread::get_id() == mThread.get_id()) {
+      return;
+   }
+   Wake();
+   mThread.join();
+   mPoller.RemoveFileDescriptor(mWakeup[0]);
+   close(mWakeup[0]);
+   close(mWakeup[1]);
+   mWakeup[0] = mWakeup[1] = -1;
+}
+
+/**
+ * @return if the reactor thread is running
+ */
+bool Reactor::IsRunning() const {
+   return mRunning;
+}
+
+/**
+ * Deliver every shot the vampire gets to the callback, on the reactor thread
+ * @param vampire
+ *   Must be prepared to be shot
+ * @param onShot
+ * @return
+ *   Set when the vampire is added, false if it could not be
+ */
+std::future<bool> Reactor::GetShots(Vampire& vampire, Shot onShot) {
+   auto added = std::make_shared<std::promise<bool> >();
+   auto result = added->get_future();
+   Vampire* target = &vampire;
+   const bool posted = onShot && Post([this, target, onShot, added] {
+      added->set_value(mPoller.Add(*target, [target, onShot] {
+         std::string shot;
+         for (int i = 0; i < kMaxShotsPerWake && target->GetShot(shot, 0); i++) {
+            onShot(shot);
+         }
+      }));
+   });
+   if (!posted) {
+      added->set_value(false);
+   }
+   return result;
+}
+
+/**
+ * Stop delivering shots from the vampire, it can be used from other threads
+ * again once the future is set
+ * @param vampire
+ * @return
+ *   Set when the vampire is removed, false if it was not added
+ */
+std::future<bool> Reactor::StopGettingShot(Vampire& vampire) {
+   auto removed = std::make_shared<std::promise<bool> >();
+   auto result = removed->get_future();
+   Vampire* target = &vampire;
+   if (!Post([this, target, removed] {
+         removed->set_value(mPoller.Remove(*target));
+      })) {
+      removed->set_value(false);
+   }
+   return result;
+}
+
+/**
+ * Fire without waiting, bullets to the same rifle are sent in order
+ * @param rifle
+ *   Must be aimed
+ * @param bullet
+ * @return
+ *   Set to true once the bullet is sent, false if it could not be
+ */
+std::future<bool> Reactor::Fire(Rifle& rifle, std::string bullet) {
+   auto fired = std::make_shared<std::promise<bool> >();
+   auto result = fired->get_future();
+   if (bullet.empty() || (!rifle.mChamber && !rifle.mLog)) {
+      LOG(WARNING) << "Reactor can only fire non empty bullets from an aimed rifle";
+      fired->set_value(false);
+      return result;
+   }
+   Rifle* target = &rifle;
+   if (!Post([this, target, fired, bullet = std::move(bullet)]() mutable {
+         mBacklog[target].push_back({std::move(bullet), fired});
+         mBacklogSize++;
+      })) {
+      fired->set_value(false);
+   }
+   return result;
+}
+
+/**
+ * Deliver every chunk the harpoon heaves to the callback, on the reactor
+ * thread. The first chunks are requested from the Kraken right away.
+ * @param harpoon
+ *   Must be aimed
+ * @param onChunk
+ *   Called with an empty chunk once the stream is over, cancelled or
+ *   interrupted
+ * @return
+ *   Set when the harpoon is added, false if it could not be
+ */
+std::future<bool> Reactor::Heave(Harpoon& harpoon, Chunk onChunk) {
+   auto added = std::make_shared<std::promise<bool> >();
+   auto result = added->get_future();
+   Harpoon* target = &harpoon;
+   const bool posted = onChunk && Post([this, target, onChunk, added] {
+      target->MaxWaitInMs(0);
+      const bool polled = mPoller.Add(*target, [this, target, onChunk] {
+         HeaveChunks(*target, onChunk);
+      });
+      added->set_value(polled);
+      if (polled) {
+         HeaveChunks(*target, onChunk);
+      }
+   });
+   if (!posted) {
+      added->set_value(false);
+   }
+   return result;
+}
+
+/**
+ * Run a task on the reactor thread
+ * @param task
+ * @return
+ *   If the task was queued, it is not when the reactor is not running
+ */
+bool Reactor::Post(Task task) {
+   // waking up under the lock keeps Stop from closing the pipe meanwhile
+   std::lock_guard<std::mutex> guard(mLock);
+   if (!mRunning) {
+      return false;
+   }
+   mTasks.push_back(std::move(task));
+   Wake();
+   return true;
+}
+
+/**
+ * The reactor loop
+ */
+void Reactor::Run() {
+   while (mRunning && !zctx_interrupted) {
+      RunTasks();
+      FireBacklog();
+      mPoller.Poll(mBacklogSize > 0 ? kBacklogRetryMs : kIdleWaitMs);
+   }
+   {
+      std::lock_guard<std::mutex> guard(mLock);
+      mRunning = false;
+   }
+   RunTasks();
+   DropBacklog();
+}
+
+/**
+ * Interrupt the poll of the reactor thread
+ */
+void Reactor::Wake() {
+   const char wakeup = 1;
+   if (write(mWakeup[1], &wakeup, 1) < 0 && errno != EAGAIN) {
+      LOG(WARNING) << "Reactor could not wake up: " << strerror(errno);
+   }
+}
+
+/**
+ * Run the queued tasks, the lock is not held while they run
+ */
+void Reactor::RunTasks() {
+   std::deque<Task> tasks;
+   {
+      std::lock_guard<std::mutex> guard(mLock);
+      tasks.swap(mTasks);
+   }
+   for (auto& task : tasks) {
+      task();
+   }
+}
+
+/**
+ * Fire queued bullets until every rifle is empty or at its high water mark
+ */
+void Reactor::FireBacklog() {
+   for (auto rifle = mBacklog.begin(); rifle != mBacklog.end();) {
+      auto& bullets = rifle->second;
+      while (!bullets.empty() && rifle->first->Fire(bullets.front().bullet, 0)) {
+         bullets.front().fired->set_value(true);
+         bullets.pop_front();
+         mBacklogSize--;
+      }
+      if (bullets.empty()) {
+         rifle = mBacklog.erase(rifle);
+      } else {
+         ++rifle;
+      }
+   }
+}
+
+/**
+ * Heave the chunks that arrived. Every Heave asks the Kraken for more
+ * first, so once nothing is left a request is out and the poller wakes the
+ * reactor when its chunk arrives.
+ * @param harpoon
+ * @param onChunk
+ */
+void Reactor::HeaveChunks(Harpoon& harpoon, const Chunk& onChunk) {
+   std::vector<uint8_t> chunk;
+   for (int i = 0; i < kMaxShotsPerWake; i++) {
+      const Harpoon::Battling battling = harpoon.Heave(chunk);
+      if (battling == Harpoon::Battling::TIMEOUT) {
+         return;
+      }
+      if (battling != Harpoon::Battling::CONTINUE) {
+         mPoller.Remove(harpoon);
+         chunk.clear();
+         onChunk(chunk);
+         return;
+      }
+      onChunk(chunk);
+   }
+}
+
+/**
+ * Give up on every queued bullet
+ */
+void Reactor::DropBacklog() {
+   for (auto& rifle : mBacklog) {
+      for (auto& bullet : rifle.second) {
+         bullet.fired->set_value(false);
+      }
+   }
+   mBacklog.clear();
+   mBacklogSize = 0;
+}
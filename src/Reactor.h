@@ -0,0 +1,85 @@
+/*
+ * File:   Reactor.h
+ *
+ * One thread driving many Rifles, Vampires and Harpoons.
+ */
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Poller.h"
+
+class Rifle;
+class Vampire;
+class Harpoon;
+
+/**
+ * Instead of dedicating a thread to every queue, Rifles and Vampires are
+ * handed to a reactor whose single thread waits on all of them with a Poller.
+ *
+ * Shots are delivered to the callback given to GetShots, on the reactor
+ * thread. Fire queues the bullet and returns right away, the future is set
+ * once the bullet is sent (true) or the reactor stops before it could be
+ * (false). Bullets for a Rifle at its high water mark stay queued, in order,
+ * and are retried every millisecond.
+ *
+ * Chunks a Harpoon heaves are delivered to the callback given to Heave, an
+ * empty chunk ends the stream and the Harpoon is removed. The reactor never
+ * waits for a chunk, it sets MaxWaitInMs to 0.
+ *
+ * ZeroMQ sockets are not thread safe: once an endpoint is handed to
+ * the reactor it must only be used from reactor callbacks (see Post) until
+ * the reactor is stopped, and it must outlive the reactor.
+ */
+class Reactor {
+public:
+   typedef std::function<void(std::string& shot)> Shot;
+   typedef std::function<void(std::vector<uint8_t>& chunk)> Chunk;
+   typedef std::function<void()> Task;
+
+   Reactor();
+   virtual ~Reactor();
+
+   bool Start();
+   void Stop();
+   bool IsRunning() const;
+
+   std::future<bool> GetShots(Vampire& vampire, Shot onShot);
+   std::future<bool> StopGettingShot(Vampire& vampire);
+   std::future<bool> Fire(Rifle& rifle, std::string bullet);
+   std::future<bool> Heave(Harpoon& harpoon, Chunk onChunk);
+   bool Post(Task task);
+
+private:
+   Reactor(const Reactor&) = delete;
+   Reactor& operator=(const Reactor&) = delete;
+
+   struct Bullet {
+      std::string bullet;
+      std::shared_ptr<std::promise<bool> > fired;
+   };
+
+   void Run();
+   void Wake();
+   void RunTasks();
+   void FireBacklog();
+   void HeaveChunks(Harpoon& harpoon, const Chunk& onChunk);
+   void DropBacklog();
+
+   std::mutex mLock;
+   std::deque<Task> mTasks;
+   // only touched on the reactor thread
+   Poller mPoller;
+   std::map<Rifle*, std::deque<Bullet> > mBacklog;
+   size_t mBacklogSize;
+   int mWakeup[2];
+   std::atomic<bool> mRunning;
+   std::thread mThread;
+};
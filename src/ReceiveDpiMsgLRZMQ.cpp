@@ -1,3 +1,6 @@
+#include <stdint.h>
+#include <cstring>
+#include <g3log/g3log.hpp>
 #include "ReceiveDpiMsgLRZMQ.h"
 using namespace std;
 
@@ -5,14 +8,57 @@ using namespace std;
  * Default constructor
  */
 ReceiveDpiMsgLRZMQ::ReceiveDpiMsgLRZMQ(const std::string& binding) :
-      Vampire(binding) {
+      Vampire(binding),
+      mCoalescing(false) {
 
 }
 bool ReceiveDpiMsgLRZMQ::Initialize() {
    return Vampire::PrepareToBeShot();
 }
+
+/**
+ * Receive one record, when coalescing the records of a frame are returned
+ * one at a time.
+ * @param data
+ * @param timeout
+ * @return 
+ */
 bool ReceiveDpiMsgLRZMQ::ReceiveDataBlock(std::string& data,const int timeout) {
-   return Vampire::GetShot(data,timeout);
+   if (!mCoalescing) {
+      return Vampire::GetShot(data,timeout);
+   }
+   if (mRecords.empty() && !(Vampire::GetShot(mFrame, timeout) && Unpack(mFrame))) {
+      return false;
+   }
+   data.swap(mRecords.front());
+   mRecords.pop_front();
+   return true;
+}
+
+/**
+ * Receive every record of the next frame, or those ReceiveDataBlock did not
+ * return yet.
+ * @param batch
+ * @param timeout
+ * @return 
+ */
+bool ReceiveDpiMsgLRZMQ::ReceiveDataBatch(std::vector<std::string>& batch, const int timeout) {
+   batch.clear();
+   if (!mCoalescing) {
+      batch.emplace_back();
+      if (!Vampire::GetShot(batch.back(), timeout)) {
+         batch.clear();
+      }
+      return !batch.empty();
+   }
+   if (mRecords.empty() && !(Vampire::GetShot(mFrame, timeout) && Unpack(mFrame))) {
+      return false;
+   }
+   for (auto& record : mRecords) {
+      batch.push_back(std::move(record));
+   }
+   mRecords.clear();
+   return true;
 }
 
 /**
@@ -22,3 +68,37 @@ bool ReceiveDpiMsgLRZMQ::ReceiveDataBlock(std::string& data,const int timeout) {
 void ReceiveDpiMsgLRZMQ::SetQueueSize(const int size) {
    return Vampire::SetHighWater(size);
 }
+
+/**
+ * Expect frames packed by SendDpiMsgLRZMQ::SetCoalescing.
+ * @param coalescing
+ */
+void ReceiveDpiMsgLRZMQ::SetCoalescing(const bool coalescing) {
+   mCoalescing = coalescing;
+}
+
+/**
+ * Split a coalesced frame into its records
+ * @param frame
+ * @return 
+ *   false if the frame is not a whole number of records, none are kept
+ */
+bool ReceiveDpiMsgLRZMQ::Unpack(const std::string& frame) {
+   size_t offset = 0;
+   while (offset + sizeof (uint32_t) <= frame.size()) {
+      uint32_t length;
+      memcpy(&length, frame.data() + offset, sizeof (length));
+      offset += sizeof (length);
+      if (length == 0 || length > frame.size() - offset) {
+         break;
+      }
+      mRecords.emplace_back(frame, offset, length);
+      offset += length;
+   }
+   if (offset != frame.size() || mRecords.empty()) {
+      LOG(WARNING) << "Dropped a coalesced frame of " << frame.size() << " bytes that is not whole records";
+      mRecords.clear();
+      return false;
+   }
+   return true;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include "Vampire.h"
 
 class ReceiveDpiMsgLRZMQ: public Vampire {
@@ -7,6 +8,13 @@ public:
    explicit ReceiveDpiMsgLRZMQ(const std::string& binding);
    bool Initialize();
    bool ReceiveDataBlock(std::string& wound,const int timeout);
+   bool ReceiveDataBatch(std::vector<std::string>& batch, const int timeout);
    void SetQueueSize(const int size);
+   void SetCoalescing(const bool coalescing);
 protected:
+   bool Unpack(const std::string& frame);
+private:
+   bool mCoalescing;
+   std::string mFrame;
+   std::deque<std::string> mRecords;
 };
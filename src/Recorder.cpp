@@ -0,0 +1,205 @@
+#include <cstring>
+#include <g3log/g3log.hpp>
+#include "Recorder.h"
+#include "Metrics.h"
+#include "Vampire.h"
+#include "Alien.h"
+#include "Headcrab.h"
+
+/**
+ * Nothing is recorded until Start
+ * @param directory
+ * @param segmentBytes
+ * @param maxSegments
+ *   The recording stops once this many segments are full
+ */
+Recorder::Recorder(const std::string& directory, const size_t segmentBytes, const size_t maxSegments) :
+mLog(directory, segmentBytes, maxSegments),
+mStarted(false),
+mStart(0),
+mRecorded(0),
+mMissed(0) {
+}
+
+Recorder::~Recorder() {
+}
+
+/**
+ * Start a recording, an earlier one in the directory is removed, also one
+ * made by this Recorder
+ * @return
+ */
+bool Recorder::Start() {
+   if (mLog.IsOpen()) {
+      mLog.Clear();
+   } else if (!mLog.Open(false)) {
+      LOG(WARNING) << "Recorder can't record to " << mLog.Directory();
+      return false;
+   }
+   mStarted = false;
+   mRecorded = 0;
+   mMissed = 0;
+   return true;
+}
+
+/**
+ * Record a message received now
+ * @param frames
+ * @return
+ *   false if it could not be recorded
+ */
+bool Recorder::Record(const Frames& frames) {
+   const uint64_t now = Metrics::Now();
+   if (!mStarted) {
+      mStart = now;
+      mStarted = true;
+   }
+   Pack(now - mStart, frames, mRecord);
+   if (!mLog.Append(mRecord.data(), mRecord.size())) {
+      if (mMissed++ == 0) {
+         LOG(WARNING) << "Recorder is full or not started: " << mLog.Directory();
+      }
+      return false;
+   }
+   mRecorded++;
+   return true;
+}
+
+bool Recorder::Record(const std::string& message) {
+   mFrames.resize(1);
+   mFrames[0] = message;
+   return Record(mFrames);
+}
+
+/**
+ * Get shot by a vampire and record the shot
+ * @param vampire
+ * @param wound
+ * @param timeout
+ * @return
+ *   If a shot was received, recorded or not
+ */
+bool Recorder::GetShot(Vampire& vampire, std::string& wound, const int timeout) {
+   if (!vampire.GetShot(wound, timeout)) {
+      return false;
+   }
+   Record(wound);
+   return true;
+}
+
+/**
+ * Get shot by an alien and record the bullets
+ * @param alien
+ * @param timeout
+ * @param bullets
+ *   Empty if nothing was received
+ */
+void Recorder::GetShot(Alien& alien, const unsigned int timeout, std::vector<std::string>& bullets) {
+   alien.GetShot(timeout, bullets);
+   if (!bullets.empty()) {
+      Record(bullets);
+   }
+}
+
+/**
+ * Get hit by a crowbar and record the hits, the headcrab still has to send
+ * its splatter
+ * @param headcrab
+ * @param hits
+ * @param timeout
+ * @return
+ *   If hits were received, recorded or not
+ */
+bool Recorder::GetHitWait(Headcrab& headcrab, std::vector<std::string>& hits, const int timeout) {
+   if (!headcrab.GetHitWait(hits, timeout)) {
+      return false;
+   }
+   Record(hits);
+   return true;
+}
+
+/**
+ * @return the messages recorded since Start
+ */
+size_t Recorder::Recorded() const {
+   return mRecorded;
+}
+
+/**
+ * @return the messages that did not fit in the recording
+ */
+size_t Recorder::Missed() const {
+   return mMissed;
+}
+
+/**
+ * Flush the recording to disk
+ * @return
+ */
+bool Recorder::Sync() {
+   return mLog.Sync();
+}
+
+/**
+ * A record is the timestamp, the number of frames and every frame with its
+ * size, in native byte order.
+ * @param timestamp
+ * @param frames
+ * @param record
+ *   Reused, it keeps its capacity
+ */
+void Recorder::Pack(const uint64_t timestamp, const Frames& frames, std::string& record) {
+   size_t size = sizeof (timestamp) + sizeof (uint32_t);
+   for (const auto& frame : frames) {
+      size += sizeof (uint32_t) + frame.size();
+   }
+   record.resize(size);
+   char* position = &record[0];
+   memcpy(position, &timestamp, sizeof (timestamp));
+   position += sizeof (timestamp);
+   const uint32_t count = frames.size();
+   memcpy(position, &count, sizeof (count));
+   position += sizeof (count);
+   for (const auto& frame : frames) {
+      const uint32_t length = frame.size();
+      memcpy(position, &length, sizeof (length));
+      position += sizeof (length);
+      memcpy(position, frame.data(), length);
+      position += length;
+   }
+}
+
+/**
+ * @param record
+ * @param timestamp
+ * @param frames
+ * @return
+ *   false if the record is not one Pack made
+ */
+bool Recorder::Unpack(const std::string& record, uint64_t& timestamp, Frames& frames) {
+   frames.clear();
+   const char* position = record.data();
+   const char* end = position + record.size();
+   uint32_t count = 0;
+   if (record.size() < sizeof (timestamp) + sizeof (count)) {
+      return false;
+   }
+   memcpy(&timestamp, position, sizeof (timestamp));
+   position += sizeof (timestamp);
+   memcpy(&count, position, sizeof (count));
+   position += sizeof (count);
+   for (uint32_t frame = 0; frame < count; ++frame) {
+      uint32_t length = 0;
+      if (end - position < static_cast<ptrdiff_t> (sizeof (length))) {
+         return false;
+      }
+      memcpy(&length, position, sizeof (length));
+      position += sizeof (length);
+      if (end - position < static_cast<ptrdiff_t> (length)) {
+         return false;
+      }
+      frames.emplace_back(position, length);
+      position += length;
+   }
+   return position == end;
+}
@@ -0,0 +1,62 @@
+/*
+ * File:   Recorder.h
+ *
+ * Record the traffic of an endpoint with its timing, to replay it later
+ * with a Replayer.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "MappedLog.h"
+
+class Vampire;
+class Alien;
+class Headcrab;
+
+/**
+ * A recording is a MappedLog directory, one record per message: when it
+ * was received in microseconds since the first one, and its frames. The
+ * taps receive from an endpoint as usual and record what they received,
+ * so a consumer records its traffic by getting shot through the Recorder.
+ *
+ * When the recording is full messages are still received but no longer
+ * recorded, see Missed.
+ */
+class Recorder {
+public:
+   typedef std::vector<std::string> Frames;
+
+   explicit Recorder(const std::string& directory,
+           const size_t segmentBytes = MappedLog::kDefaultSegmentBytes,
+           const size_t maxSegments = MappedLog::kDefaultMaxSegments);
+   virtual ~Recorder();
+
+   bool Start();
+   bool Record(const Frames& frames);
+   bool Record(const std::string& message);
+
+   bool GetShot(Vampire& vampire, std::string& wound, const int timeout);
+   void GetShot(Alien& alien, const unsigned int timeout, std::vector<std::string>& bullets);
+   bool GetHitWait(Headcrab& headcrab, std::vector<std::string>& hits, const int timeout);
+
+   size_t Recorded() const;
+   size_t Missed() const;
+   bool Sync();
+
+   static void Pack(const uint64_t timestamp, const Frames& frames, std::string& record);
+   static bool Unpack(const std::string& record, uint64_t& timestamp, Frames& frames);
+
+private:
+   Recorder(const Recorder&) = delete;
+   Recorder& operator=(const Recorder&) = delete;
+
+   MappedLog mLog;
+   bool mStarted;
+   uint64_t mStart;
+   size_t mRecorded;
+   size_t mMissed;
+   std::string mRecord;
+   Frames mFrames;
+};
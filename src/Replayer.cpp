@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <czmq.h>
+#include <g3log/g3log.hpp>
+#include "Replayer.h"
+#include "Recorder.h"
+#include "Rifle.h"
+#include "Shotgun.h"
+#include "Crowbar.h"
+
+/**
+ * Replays at the original pace until SetSpeed
+ * @param directory
+ *   Of a Recorder
+ */
+Replayer::Replayer(const std::string& directory) :
+mLog(directory),
+mSpeed(1),
+mOffset(0),
+mSkipped(0) {
+}
+
+Replayer::~Replayer() {
+}
+
+/**
+ * Open the recording, the first Replay starts at its beginning
+ * @return
+ */
+bool Replayer::Open() {
+   if (!mLog.Open(true)) {
+      LOG(WARNING) << "Replayer can't open " << mLog.Directory();
+      return false;
+   }
+   Rewind();
+   return true;
+}
+
+/**
+ * @param speed
+ *   1 for the original pace, 2 for twice as fast, 0 for as fast as the
+ *   endpoint allows
+ */
+void Replayer::SetSpeed(const double speed) {
+   mSpeed = std::max(speed, 0.0);
+}
+
+double Replayer::GetSpeed() const {
+   return mSpeed;
+}
+
+/**
+ * Replay from the first recorded message again
+ */
+void Replayer::Rewind() {
+   mOffset = mLog.Begin();
+   mSkipped = 0;
+}
+
+/**
+ * Fire every recorded message not replayed yet, the first one right away
+ * @param fire
+ * @return
+ *   The messages fired
+ */
+size_t Replayer::Replay(const Fire& fire) {
+   using namespace std::chrono;
+   steady_clock::time_point start;
+   std::string record;
+   Frames frames;
+   uint64_t timestamp = 0;
+   // timestamps count from the start of the recording, the pace from the
+   // first message of this Replay
+   uint64_t first = 0;
+   bool paced = false;
+   size_t fired = 0;
+   while (!zctx_interrupted && mLog.Read(mOffset, record)) {
+      if (!Recorder::Unpack(record, timestamp, frames)) {
+         LOG(WARNING) << "Replayer skips an invalid record in " << mLog.Directory();
+         mSkipped++;
+         continue;
+      }
+      if (!paced) {
+         start = steady_clock::now();
+         first = timestamp;
+         paced = true;
+      }
+      if (mSpeed > 0 && timestamp > first) {
+         std::this_thread::sleep_until(start + microseconds(static_cast<uint64_t> ((timestamp - first) / mSpeed)));
+      }
+      if (fire(frames)) {
+         fired++;
+      } else {
+         mSkipped++;
+      }
+   }
+   return fired;
+}
+
+/**
+ * Fire every frame of the recorded messages as a bullet
+ * @param rifle
+ *   Aimed
+ * @param waitToFire
+ * @return
+ *   The messages fired
+ */
+size_t Replayer::Replay(Rifle& rifle, const int waitToFire) {
+   return Replay([&rifle, waitToFire](const Frames & frames) {
+      bool fired = !frames.empty();
+      for (const auto& frame : frames) {
+         fired = rifle.Fire(frame, waitToFire) && fired;
+      }
+      return fired;
+   });
+}
+
+/**
+ * Fire the recorded messages as multi frame shots
+ * @param shotgun
+ *   Aimed
+ * @return
+ *   The messages fired
+ */
+size_t Replayer::Replay(Shotgun& shotgun) {
+   return Replay([&shotgun](const Frames & frames) {
+      shotgun.Fire(frames);
+      return true;
+   });
+}
+
+/**
+ * Swing the recorded messages and wait for every kill, as a Crowbar has to
+ * @param crowbar
+ *   Wielded
+ * @param waitForKill
+ * @return
+ *   The messages that got a kill
+ */
+size_t Replayer::Replay(Crowbar& crowbar, const int waitForKill) {
+   Frames guts;
+   return Replay([&crowbar, &guts, waitForKill](const Frames & frames) {
+      Frames hits = frames;
+      return crowbar.Flurry(hits) && crowbar.WaitForKill(guts, waitForKill);
+   });
+}
+
+/**
+ * @return the messages that could not be replayed since Rewind
+ */
+size_t Replayer::Skipped() const {
+   return mSkipped;
+}
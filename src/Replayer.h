@@ -0,0 +1,56 @@
+/*
+ * File:   Replayer.h
+ *
+ * Fire a recording made by a Recorder again, at its original pace, faster,
+ * slower or as fast as possible.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "MappedLog.h"
+
+class Rifle;
+class Shotgun;
+class Crowbar;
+
+/**
+ * Every recorded message is fired when its time comes: its timestamp in
+ * the recording divided by the speed, counted from the first message the
+ * Replay fires.
+ * A message that is late, because firing the ones before took too long,
+ * is fired right away, so a replay is never slower than the endpoint
+ * allows.
+ */
+class Replayer {
+public:
+   typedef std::vector<std::string> Frames;
+   // fire one recorded message, false if it could not be
+   typedef std::function<bool(const Frames&)> Fire;
+
+   explicit Replayer(const std::string& directory);
+   virtual ~Replayer();
+
+   bool Open();
+   void SetSpeed(const double speed);
+   double GetSpeed() const;
+   void Rewind();
+
+   size_t Replay(const Fire& fire);
+   size_t Replay(Rifle& rifle, const int waitToFire = 10000);
+   size_t Replay(Shotgun& shotgun);
+   size_t Replay(Crowbar& crowbar, const int waitForKill = 10000);
+
+   size_t Skipped() const;
+
+private:
+   Replayer(const Replayer&) = delete;
+   Replayer& operator=(const Replayer&) = delete;
+
+   MappedLog mLog;
+   double mSpeed;
+   uint64_t mOffset;
+   size_t mSkipped;
+};
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+#include <set>
 #define _OPEN_SYS
 #include <sys/stat.h>
 
@@ -5,6 +8,13 @@
 #include "czmq.h"
 #include "g3log/g3log.hpp"
 #include "Death.h"
+#include "ShmRing.h"
+
+namespace {
+   // how often to look again at a Vampire whose pipe is at the high water mark
+   const int kFullPipeMs = 1;
+}
+
 /**
  * Construct our Rifle which is a push in our ZMQ push pull.
  */
@@ -15,7 +25,17 @@ mChamber(NULL),
 mContext(NULL),
 mLinger(10),
 mIOThredCount(1),
-mOwnSocket(true) {
+mOwnSocket(true),
+mCreditFlow(false),
+mMisfired(false),
+mOverload(Overload::BLOCK),
+mOverloadLimit(1),
+mOverloaded(false),
+mSkipped(0),
+mSpillSegmentBytes(MappedLog::kDefaultSegmentBytes),
+mSpillMaxSegments(MappedLog::kDefaultMaxSegments),
+mSpillHead(0),
+mMetrics("Rifle", location) {
 }
 
 /**
@@ -26,6 +46,21 @@ std::string Rifle::GetBinding() const {
    return mLocation;
 }
 
+/**
+ * @return the counters of this rifle, also in the MetricsRegistry
+ */
+const Metrics& Rifle::GetMetrics() const {
+   return mMetrics;
+}
+
+/**
+ * Count messages a subclass gave up on, i.e. the records of a frame
+ * @param count
+ */
+void Rifle::Dropped(const size_t count) {
+   mMetrics.Drop(count);
+}
+
 /**
  * Get our high water mark.
  * @return 
@@ -75,12 +110,43 @@ bool Rifle::GetOwnSocket() {
 }
 
 /**
- * Set the location we want to shoot at.
+ * Send only to Vampires that granted credit, the one with the most credit
+ * left first, instead of round robin. Every Vampire must SetCredit. This
+ * must be called before Aim.
+ * @param credit
+ */
+void Rifle::SetCreditFlow(const bool credit) {
+   mCreditFlow = credit;
+}
+
+/**
+ * Get value for credit flow.
+ * @return bool
+ */
+bool Rifle::GetCreditFlow() {
+   return mCreditFlow;
+}
+
+/**
+ * Set the location we want to shoot at. For a shm://name location the
+ * bullets go through a shared memory ring, the socket is only used to wake
+ * up the Vampire, see ShmRing. For a log://directory location the bullets
+ * are appended to a MappedLog in the directory and no socket is used, they
+ * are kept until every Vampire reading the log committed them.
  * @param location
  * @return 
  */
 bool Rifle::Aim() {
-   if (mChamber) {
+   if (mChamber || mLog) {
+      return true;
+   }
+   if (MappedLog::IsLog(mLocation)) {
+      mLog.reset(new MappedLog(MappedLog::LogDirectory(mLocation)));
+      if (!mLog->Open(true)) {
+         LOG(WARNING) << "Rifle can't open : " << mLocation;
+         mLog.reset();
+         return false;
+      }
       return true;
    }
    if (!mContext) {
@@ -91,10 +157,21 @@ bool Rifle::Aim() {
       zctx_set_iothreads(mContext, mIOThredCount);
    }
    if (!mChamber) {
-      mChamber = zsocket_new(mContext, ZMQ_PUSH);
+      const bool shm = ShmRing::IsShm(mLocation);
+      const std::string location = shm ? ShmRing::WakeLocation(mLocation) : mLocation;
+      if (shm && mCreditFlow) {
+         LOG(WARNING) << "Rifle has no credit flow over " << mLocation;
+         return false;
+      }
+      mChamber = zsocket_new(mContext, mCreditFlow ? ZMQ_ROUTER : ZMQ_PUSH);
       CZMQToolkit::setHWMAndBuffer(mChamber, GetHighWater());
+      if (mCreditFlow) {
+         // sending to a vampire that went away fails instead of dropping
+         const int mandatory = 1;
+         zmq_setsockopt(mChamber, ZMQ_ROUTER_MANDATORY, &mandatory, sizeof (mandatory));
+      }
       if (GetOwnSocket()) {
-         int result = zsocket_bind(mChamber, mLocation.c_str());
+         int result = zsocket_bind(mChamber, location.c_str());
 
          if (result < 0) {
             LOG(WARNING) << "Rifle can't bind : " << result;
@@ -102,10 +179,10 @@ bool Rifle::Aim() {
             mChamber = NULL;
             return false;
          }
-         setIpcFilePermissions();
-         Death::Instance().RegisterDeathEvent(&Death::DeleteIpcFiles, mLocation);
+         setIpcFilePermissions(location);
+         Death::Instance().RegisterDeathEvent(&Death::DeleteIpcFiles, location);
       } else {
-         int result = zsocket_connect(mChamber, mLocation.c_str());
+         int result = zsocket_connect(mChamber, location.c_str());
          if (result < 0) {
             LOG(WARNING) << "Rifle can't connect : " << result;
             zsocket_destroy(mContext, mChamber);
@@ -113,6 +190,29 @@ bool Rifle::Aim() {
             return false;
          }
       }
+      if (shm) {
+         mRing.reset(new ShmRing(mLocation, GetOwnSocket()));
+         // a ring the vampire did not create yet is mapped once it is there
+         if (GetOwnSocket() && !mRing->IsOpen()) {
+            LOG(WARNING) << "Rifle can't map : " << mLocation;
+            mRing.reset();
+            zsocket_destroy(mContext, mChamber);
+            mChamber = NULL;
+            return false;
+         }
+      }
+      if (!mSpillDirectory.empty()) {
+         mSpill.reset(new MappedLog(mSpillDirectory, mSpillSegmentBytes, mSpillMaxSegments));
+         if (!mSpill->Open(false)) {
+            LOG(WARNING) << "Rifle can't spill to : " << mSpillDirectory;
+            mSpill.reset();
+            mRing.reset();
+            zsocket_destroy(mContext, mChamber);
+            mChamber = NULL;
+            return false;
+         }
+         mSpillHead = mSpill->Begin();
+      }
       //CZMQToolkit::PrintCurrentHighWater(mChamber, "Rifle: chamber");
    }
    return ((mContext != NULL) && (mChamber != NULL));
@@ -122,16 +222,16 @@ bool Rifle::Aim() {
 /**
  * Set the file permisions on an IPC socket to 0777
  */
-void Rifle::setIpcFilePermissions() {
+void Rifle::setIpcFilePermissions(const std::string& location) {
 
    mode_t mode = S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP
       | S_IXGRP | S_IROTH | S_IWOTH | S_IXOTH;
 
-   size_t ipcFound = mLocation.find("ipc");
+   size_t ipcFound = location.find("ipc");
    if (ipcFound != std::string::npos) {
-      size_t tmpFound = mLocation.find("/tmp");
+      size_t tmpFound = location.find("/tmp");
       if (tmpFound != std::string::npos) {
-         std::string ipcFile = mLocation.substr(tmpFound);
+         std::string ipcFile = location.substr(tmpFound);
          LOG(INFO) << "Rifle set ipc permissions: " << ipcFile;
          chmod(ipcFile.c_str(), mode);
       }
@@ -149,31 +249,422 @@ void Rifle::setIpcFilePermissions() {
  */
 bool Rifle::Fire(const std::string& bullet, const int waitToFire) {
    //LOG(DEBUG) << "RifleFire";
-   if (!mChamber) {
+   return FireBytes(bullet.data(), bullet.size(), waitToFire);
+}
+
+/**
+ * Shoot raw bytes as one message, for Fire and FireBatch.
+ * @param data
+ * @param size
+ * @param waitToFire in milliseconds
+ * @return 
+ */
+bool Rifle::FireBytes(const void* data, const size_t size, const int waitToFire) {
+   if (!mChamber && !mLog) {
       LOG(WARNING) << "Socket uninitialized!";
       return false;
    }
-   if (bullet.empty()) {
+   if (size == 0) {
       LOG(WARNING) << "Tried to send empty packet";
       return false;
    }
-   zmq_pollitem_t items [] = {
-      { mChamber, 0, ZMQ_POLLOUT, 0}
+   if (mSpill) {
+      return FireOrSpill(data, size, waitToFire);
+   }
+   if (mOverload == Overload::DROP_OLDEST) {
+      return FireOrHold(data, size);
+   }
+   return Shoot(data, size, waitToFire, true);
+}
+
+/**
+ * Send a bullet that was checked already
+ * @param data
+ * @param size
+ * @param waitToFire in milliseconds
+ * @param policy
+ *   If the overload policy applies, see Send
+ * @return 
+ */
+bool Rifle::Shoot(const void* data, const size_t size, const int waitToFire, const bool policy) {
+   if (mRing) {
+      return FireIntoRing(data, size, waitToFire, policy);
+   }
+   if (mLog) {
+      return FireIntoLog(data, size, waitToFire, policy);
+   }
+   zmq_msg_t message;
+   zmq_msg_init_size(&message, size);
+   memcpy(zmq_msg_data(&message), data, size);
+   if (Send(message, waitToFire, policy)) {
+      return true;
+   }
+   zmq_msg_close(&message);
+   return false;
+}
+
+/**
+ * Wait until a bullet can be sent and send it. With credit flow the bullet
+ * goes to the Vampire with the most credit left, see TakeCredit.
+ * @param bullet
+ *   Still owned by the caller if it was not sent
+ * @param waitToFire in milliseconds, see Patience
+ * @param policy
+ *   If the overload policy applies, held bullets wait as long as asked and
+ *   are never dropped here
+ * @return
+ *   true if sent, false on timeout or error
+ */
+bool Rifle::Send(zmq_msg_t& bullet, const int waitToFire, const bool policy) {
+   if (policy && Skip()) {
+      mMetrics.Drop();
+      return false;
+   }
+   const uint64_t start = Metrics::Now();
+   const size_t size = zmq_msg_size(&bullet);
+   const int wait = policy ? Patience(waitToFire) : waitToFire;
+   int result = 0;
+   if (mCreditFlow) {
+      result = Polled(TakeCredit(bullet, wait), start);
+   } else {
+      zmq_pollitem_t items [] = {
+         { mChamber, 0, ZMQ_POLLOUT, 0}
+      };
+      result = Polled(zmq_poll(items, 1, wait), start);
+      if (result > 0 && !(items[0].revents & ZMQ_POLLOUT)) {
+         LOG(WARNING) << "Error in zmq_pollout in " << GetBinding() << ": " << zmq_strerror(zmq_errno());
+         mMetrics.Error();
+         return false;
+      }
+      if (result > 0 && zmq_msg_send(&bullet, mChamber, ZMQ_DONTWAIT) < 0) {
+         LOG(WARNING) << "Failed on send in " << GetBinding() << ": " << zmq_strerror(zmq_errno());
+         mMetrics.Error();
+         return false;
+      }
+   }
+   Overloaded(result == 0, policy);
+   return (result > 0) && Fired(true, size, start);
+}
+
+/**
+ * How to behave when the Vampires can't keep up, by default Fire blocks up
+ * to waitToFire. This must be called before Aim.
+ *
+ * DROP_NEWEST gives up on a bullet right away when there is no room for it.
+ * DROP_OLDEST holds bullets without room for them in order, up to limit of
+ * them, and drops the oldest held one to make room. Held bullets go out
+ * first on the next Fire, FireHeld or FireBatch. Stakes and zero copy
+ * buffers are never held, they are dropped as with DROP_NEWEST.
+ * SAMPLE only tries one bullet in limit while there is no room and drops
+ * the rest right away, the ones that get through are a uniform sample.
+ *
+ * Every bullet given up on is counted by Metrics::Dropped and Fire returns
+ * false for it, the caller keeps what it owns as for a timeout. A held
+ * bullet is fired as far as the caller is concerned.
+ * @param overload
+ * @param limit
+ *   Bullets held with DROP_OLDEST, one in limit tried with SAMPLE
+ */
+void Rifle::SetOverload(const Overload overload, const size_t limit) {
+   mOverload = overload;
+   mOverloadLimit = std::max<size_t>(limit, 1);
+}
+
+Rifle::Overload Rifle::GetOverload() const {
+   return mOverload;
+}
+
+/**
+ * @return the bullets held with Overload::DROP_OLDEST
+ */
+size_t Rifle::Held() const {
+   return mHeld.size();
+}
+
+/**
+ * Fire the held and spilled bullets in order
+ * @param waitToFire in milliseconds, for every bullet
+ * @return 
+ *   If none is left
+ */
+bool Rifle::FireHeld(const int waitToFire) {
+   while (Spilled() > 0 && FireSpilled(waitToFire)) {
+   }
+   while (!mHeld.empty() && Shoot(mHeld.front().data(), mHeld.front().size(), waitToFire, false)) {
+      mHeld.pop_front();
+   }
+   return mHeld.empty() && Spilled() == 0;
+}
+
+/**
+ * Spill bullets without room for them to segment files in a directory
+ * instead of blocking or dropping them, they are fired in order once the
+ * Vampires catch up, see MappedLog. The directory is emptied when the
+ * Rifle is aimed and destroyed, spilled bullets do not survive a restart.
+ *
+ * At most maxSegments * segmentBytes are spilled. When they are used up
+ * the overload policy decides: BLOCK waits up to waitToFire for spilled
+ * bullets to go out and make room, the others drop the bullet. Spilling
+ * takes the place of holding bullets with DROP_OLDEST. Only bullets are
+ * spilled, not stakes or zero copy buffers. This must be called before
+ * Aim.
+ * @param directory
+ *   Empty to not spill
+ * @param segmentBytes
+ * @param maxSegments
+ */
+void Rifle::SetSpill(const std::string& directory, const size_t segmentBytes, const size_t maxSegments) {
+   mSpillDirectory = directory;
+   mSpillSegmentBytes = segmentBytes;
+   mSpillMaxSegments = maxSegments;
+}
+
+/**
+ * @return the bytes spilled to disk and not fired yet
+ */
+uint64_t Rifle::Spilled() const {
+   return mSpill ? mSpill->End() - mSpillHead : 0;
+}
+
+/**
+ * Fire the oldest spilled bullet, its segment is removed once every bullet
+ * in it is fired.
+ * @param waitToFire in milliseconds
+ * @return 
+ *   If one was fired
+ */
+bool Rifle::FireSpilled(const int waitToFire) {
+   uint64_t next = mSpillHead;
+   if (!mSpill->Read(next, mReloaded) || !Shoot(mReloaded.data(), mReloaded.size(), waitToFire, false)) {
+      return false;
+   }
+   mSpillHead = next;
+   mSpill->Trim(mSpillHead);
+   return true;
+}
+
+/**
+ * Fire a bullet after the spilled ones, spilling it if there is no room.
+ * @param data
+ * @param size
+ * @param waitToFire in milliseconds, only waited for when the spill is full
+ * @return 
+ */
+bool Rifle::FireOrSpill(const void* data, const size_t size, const int waitToFire) {
+   while (Spilled() > 0 && FireSpilled(0)) {
+   }
+   if (Spilled() == 0 && Shoot(data, size, 0, false)) {
+      return true;
+   }
+   const int64_t deadline = zclock_time() + Patience(waitToFire);
+   while (!mSpill->Append(data, size)) {
+      if (Spilled() == 0) {
+         // nothing to make room with, the bullet is larger than a segment
+         return Shoot(data, size, waitToFire, true);
+      }
+      if (!FireSpilled(std::max<int64_t>(deadline - zclock_time(), 0))) {
+         mMetrics.Drop();
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * Fire a bullet with Overload::DROP_OLDEST, after the held ones. A bullet
+ * without room is held, dropping the oldest held one when there are too
+ * many.
+ * @param data
+ * @param size
+ * @return 
+ */
+bool Rifle::FireOrHold(const void* data, const size_t size) {
+   if (FireHeld(0) && Shoot(data, size, 0, false)) {
+      return true;
+   }
+   if (mHeld.size() >= mOverloadLimit) {
+      mHeld.pop_front();
+      mMetrics.Drop();
+   }
+   mHeld.emplace_back(reinterpret_cast<const char*> (data), size);
+   return true;
+}
+
+/**
+ * @return if a sampled out bullet should be dropped without trying it
+ */
+bool Rifle::Skip() {
+   return mOverload == Overload::SAMPLE && mOverloaded && (++mSkipped % mOverloadLimit) != 0;
+}
+
+/**
+ * @param waitToFire
+ * @return how long to wait for room with the overload policy
+ */
+int Rifle::Patience(const int waitToFire) const {
+   return (mOverload == Overload::BLOCK) ? waitToFire : 0;
+}
+
+/**
+ * Remember if the last try found room and count the drop if it did not
+ * @param overloaded
+ * @param policy
+ */
+void Rifle::Overloaded(const bool overloaded, const bool policy) {
+   mOverloaded = overloaded;
+   if (overloaded && policy && mOverload != Overload::BLOCK) {
+      mMetrics.Drop();
+   }
+}
+
+/**
+ * Wait for a Vampire with credit and send it the bullet, the least loaded
+ * Vampire is the one with the most credit. The identity of the Vampire and
+ * the bullet are sent together, a Vampire whose pipe is full counts as one
+ * without credit until the next wait.
+ * @param bullet
+ * @param waitToFire in milliseconds
+ * @return
+ *   1 when sent, 0 on timeout, -1 on error
+ */
+int Rifle::TakeCredit(zmq_msg_t& bullet, const int waitToFire) {
+   if (!Unjam()) {
+      return -1;
+   }
+   const int64_t deadline = zclock_time() + waitToFire;
+   std::set<std::string> full;
+   auto credit = [&full](const std::pair<const std::string, size_t>& vampire) {
+      return full.count(vampire.first) ? 0 : vampire.second;
    };
+   while (!zctx_interrupted) {
+      CollectCredit();
+      auto target = std::max_element(mCredits.begin(), mCredits.end(),
+              [&credit](const std::pair<const std::string, size_t>& lhs,
+              const std::pair<const std::string, size_t>& rhs) {
+                 return credit(lhs) < credit(rhs);
+              });
+      if (target != mCredits.end() && credit(*target) > 0) {
+         if (zmq_send(mChamber, target->first.data(), target->first.size(), ZMQ_SNDMORE | ZMQ_DONTWAIT) < 0) {
+            if (zmq_errno() == EHOSTUNREACH) {
+               // the vampire is gone with its credit
+               mCredits.erase(target);
+               continue;
+            }
+            if (zmq_errno() == EAGAIN) {
+               full.insert(target->first);
+               continue;
+            }
+            LOG(WARNING) << "Rifle could not address a vampire on " << GetBinding() << ": " << zmq_strerror(zmq_errno());
+            return -1;
+         }
+         if (zmq_msg_send(&bullet, mChamber, ZMQ_DONTWAIT) >= 0) {
+            target->second--;
+            return 1;
+         }
+         LOG(WARNING) << "Rifle could not send to a vampire on " << GetBinding() << ": " << zmq_strerror(zmq_errno());
+         mMisfired = true;
+         Unjam();
+         return -1;
+      }
+      const int remaining = (waitToFire < 0) ? -1 : std::max<int64_t>(deadline - zclock_time(), 0);
+      if (remaining == 0) {
+         return 0;
+      }
+      // a full pipe that drains does not wake up the poll
+      const int wait = full.empty() ? remaining :
+              ((remaining < 0) ? kFullPipeMs : std::min(remaining, kFullPipeMs));
+      full.clear();
+      zmq_pollitem_t items [] = {
+         { mChamber, 0, ZMQ_POLLIN, 0}
+      };
+      if (zmq_poll(items, 1, wait) < 0) {
+         return -1;
+      }
+   }
+   return 0;
+}
+
+/**
+ * The identity of a Vampire went out without its bullet. The message is
+ * ended with an empty frame so the next bullet is not appended to it, the
+ * Vampire skips it without spending credit. Nothing else is sent until the
+ * empty frame went out.
+ * @return
+ *   false while the message can't be ended
+ */
+bool Rifle::Unjam() {
+   if (!mMisfired) {
+      return true;
+   }
+   if (zmq_send(mChamber, NULL, 0, ZMQ_DONTWAIT) < 0) {
+      LOG(WARNING) << "Rifle could not end a misfired message on " << GetBinding() << ": " << zmq_strerror(zmq_errno());
+      return false;
+   }
+   mMisfired = false;
+   return true;
+}
 
-   if (zmq_poll(items, 1, waitToFire) > 0) {
-      if (items[0].revents & ZMQ_POLLOUT) {
-         zmsg_t* message = zmsg_new();
-         zmsg_addmem(message, &(bullet[0]), bullet.size());
-         return CZMQToolkit::SendExistingMessage(message, mChamber);
+/**
+ * Add up the credit the Vampires granted since the last time, without
+ * waiting. A grant is the identity of the Vampire and the number of bullets
+ * it asks for.
+ */
+void Rifle::CollectCredit() {
+   zframe_t* identity = NULL;
+   while ((identity = zframe_recv_nowait(mChamber)) != NULL) {
+      zframe_t* grant = zframe_more(identity) ? zframe_recv_nowait(mChamber) : NULL;
+      if (grant && zframe_size(grant) == sizeof (uint32_t) && !zframe_more(grant)) {
+         uint32_t credit = 0;
+         memcpy(&credit, zframe_data(grant), sizeof (credit));
+         mCredits[std::string(reinterpret_cast<char*> (zframe_data(identity)), zframe_size(identity))] += credit;
       } else {
-         LOG(WARNING) << "Error on Zmq socket send: " << zmq_strerror(zmq_errno());
-         return false;
+         LOG(WARNING) << "Rifle received an invalid grant on " << GetBinding();
+         mMetrics.Error();
+         // drop the rest of a longer message
+         while (grant && zframe_more(grant)) {
+            zframe_destroy(&grant);
+            grant = zframe_recv_nowait(mChamber);
+         }
       }
+      if (grant) {
+         zframe_destroy(&grant);
+      }
+      zframe_destroy(&identity);
+   }
+}
+
+/**
+ * Count the wait for room below the high water mark
+ * @param result
+ *   Of zmq_poll
+ * @param start
+ * @return result
+ */
+int Rifle::Polled(const int result, const uint64_t start) {
+   if (result > 0) {
+      mMetrics.Blocked(start);
+   } else if (result == 0) {
+      mMetrics.Timeout(start);
    } else {
-      //      LOG(WARNING) << "timeout in zmq_pollout " << GetBinding();
-      return false;
+      mMetrics.Error();
+   }
+   return result;
+}
+
+/**
+ * Count the result of a send
+ * @param success
+ * @param size
+ * @param start
+ * @return success
+ */
+bool Rifle::Fired(const bool success, const size_t size, const uint64_t start) {
+   if (success) {
+      mMetrics.Count(size, start);
+   } else {
+      mMetrics.Error();
    }
+   return success;
 }
 
 /**
@@ -181,50 +672,173 @@ bool Rifle::Fire(const std::string& bullet, const int waitToFire) {
  * @param zero
  * @param size
  * @param FreeFunction
+ *   Called with the string data and zero once zeromq is done with it, also
+ *   if zeromq could not send it. A string never given to zeromq is deleted.
  * @param waitToFire
  * @return 
  */
 bool Rifle::FireZeroCopy(std::string* zero, const size_t size, void (*FreeFunction)(void*, void*), const int waitToFire) {
    bool success = false;
-   if (!mChamber) {
+   if (!mChamber && !mLog) {
       LOG(WARNING) << "Socket uninitialized!";
    } else if (size == 0) {
       LOG(WARNING) << "Tried to send empty packet";
+   } else if (mRing || mLog) {
+      // the ring or log holds a copy, the string is freed below either way
+      success = Shoot(zero->data(), size, waitToFire, true);
    } else {
-      zmq_pollitem_t items [] = {
-         { mChamber, 0, ZMQ_POLLOUT, 0}
-      };
-
-      if (zmq_poll(items, 1, waitToFire) > 0) {
-         if (items[0].revents & ZMQ_POLLOUT) {
-
-            zmq_msg_t message;
-            zmq_msg_init_data(&message, &((*zero)[0]), size, FreeFunction, zero);
-            if ((int) size == zmq_msg_send(&message, mChamber, ZMQ_DONTWAIT)) {
-               success = true;
-               zero = NULL;
-            }
-         } else {
-            LOG(WARNING) << "Error on Zmq socket send: " << zmq_strerror(zmq_errno());
-         }
-      } else {
-         //      LOG(WARNING) << "timeout in zmq_pollout " << GetBinding();
+      zmq_msg_t message;
+      zmq_msg_init_data(&message, &((*zero)[0]), size, FreeFunction, zero);
+      success = Send(message, waitToFire);
+      if (!success) {
+         // the message owns the string, closing it calls FreeFunction
+         zmq_msg_close(&message);
       }
+      zero = NULL;
    }
-   if (!success && zero) {
+   if ((!success || mRing || mLog) && zero) {
       delete zero;
       zero = NULL;
    }
    return success;
 }
 
+/**
+ * Fire a buffer without copying it to zeromq, for buffers that are not
+ * strings such as the ones of a BufferPool.
+ * @param data
+ * @param size
+ * @param FreeFunction
+ *   Called with data and hint once zeromq is done with the buffer, or right
+ *   away if it could not be fired
+ * @param hint
+ * @param waitToFire
+ * @return 
+ */
+bool Rifle::FireZeroCopy(void* data, const size_t size, void (*FreeFunction)(void*, void*), void* hint, const int waitToFire) {
+   if (!mChamber && !mLog) {
+      LOG(WARNING) << "Socket uninitialized!";
+   } else if (size == 0) {
+      LOG(WARNING) << "Tried to send empty packet";
+   } else if (mRing || mLog) {
+      const bool fired = Shoot(data, size, waitToFire, true);
+      FreeFunction(data, hint);
+      return fired;
+   } else {
+      zmq_msg_t message;
+      zmq_msg_init_data(&message, data, size, FreeFunction, hint);
+      if (Send(message, waitToFire)) {
+         return true;
+      }
+      // the message still owns the buffer, closing it calls FreeFunction
+      zmq_msg_close(&message);
+      return false;
+   }
+   FreeFunction(data, hint);
+   return false;
+}
+
+/**
+ * Copy a bullet into the shared memory ring, waking up the Vampire if it
+ * waits for one.
+ * @param data
+ * @param size
+ * @param waitToFire in milliseconds, how long to wait for room in the ring
+ * @param policy
+ *   If the overload policy applies, see Send
+ * @return 
+ */
+bool Rifle::FireIntoRing(const void* data, const size_t size, const int waitToFire, const bool policy) {
+   if (mRing->IsOpen() && size + sizeof (uint32_t) > mRing->Capacity()) {
+      LOG(WARNING) << "Bullet of " << size << " bytes never fits in " << GetBinding();
+      mMetrics.Error();
+      return false;
+   }
+   if (policy && Skip()) {
+      mMetrics.Drop();
+      return false;
+   }
+   const uint64_t start = Metrics::Now();
+   const int64_t deadline = zclock_time() + (policy ? Patience(waitToFire) : waitToFire);
+   bool waited = false;
+   while (!mRing->Write(data, size)) {
+      if (zctx_interrupted || zclock_time() >= deadline) {
+         mMetrics.Timeout(start);
+         Overloaded(true, policy);
+         return false;
+      }
+      // the vampire is behind, it is not waiting so there is no one to wake
+      zclock_sleep(1);
+      waited = true;
+   }
+   if (waited) {
+      mMetrics.Blocked(start);
+   }
+   Overloaded(false, policy);
+   mMetrics.Count(size, start);
+   if (mRing->WakeNeeded() && zmq_send(mChamber, "", 0, ZMQ_DONTWAIT) < 0) {
+      // it finds the bullet once its wait times out
+      LOG(WARNING) << "Rifle could not wake up the vampire on " << GetBinding();
+   }
+   return true;
+}
+
+/**
+ * Append a bullet to the log. When the log is full the segments every
+ * Vampire committed are removed to make room.
+ * @param data
+ * @param size
+ * @param waitToFire in milliseconds, how long to wait for the Vampires to
+ *   commit enough to make room
+ * @param policy
+ *   If the overload policy applies, see Send
+ * @return 
+ */
+bool Rifle::FireIntoLog(const void* data, const size_t size, const int waitToFire, const bool policy) {
+   if (size + sizeof (uint32_t) > mLog->SegmentBytes()) {
+      LOG(WARNING) << "Bullet of " << size << " bytes never fits in " << GetBinding();
+      mMetrics.Error();
+      return false;
+   }
+   if (policy && Skip()) {
+      mMetrics.Drop();
+      return false;
+   }
+   const uint64_t start = Metrics::Now();
+   const int64_t deadline = zclock_time() + (policy ? Patience(waitToFire) : waitToFire);
+   bool waited = false;
+   while (!mLog->Append(data, size)) {
+      uint64_t committed = 0;
+      const size_t segments = mLog->Segments();
+      if (mLog->OldestCommitted(committed)) {
+         mLog->Trim(committed);
+      }
+      if (mLog->Segments() < segments) {
+         continue;
+      }
+      if (zctx_interrupted || zclock_time() >= deadline) {
+         mMetrics.Timeout(start);
+         Overloaded(true, policy);
+         return false;
+      }
+      zclock_sleep(1);
+      waited = true;
+   }
+   if (waited) {
+      mMetrics.Blocked(start);
+   }
+   Overloaded(false, policy);
+   mMetrics.Count(size, start);
+   return true;
+}
+
 /**
  * Shoot a pointer / message to the Vampires / pull.
  * @param stake
  * @return 
  */
 bool Rifle::FireStake(const void* stake, const int waitToFire) {
-   if (!mChamber) {
+   if (!mChamber && !mLog) {
       LOG(WARNING) << "Socket uninitialized!";
       return false;
    }
@@ -232,24 +846,18 @@ bool Rifle::FireStake(const void* stake, const int waitToFire) {
       LOG(WARNING) << "Tried to send empty packet";
       return false;
    }
-   zmq_pollitem_t items [] = {
-      { mChamber, 0, ZMQ_POLLOUT, 0}
-   };
-
-   if (zmq_poll(items, 1, waitToFire) > 0) {
-      if (items[0].revents & ZMQ_POLLOUT) {
-         zmsg_t* message = zmsg_new();
-         zmsg_addmem(message, &(stake), sizeof (void*));
-         return CZMQToolkit::SendExistingMessage(message, mChamber);
-      } else {
-
-         LOG(WARNING) << "Error in zmq_pollout in " << GetBinding() << ": " << zmq_strerror(zmq_errno());
-         return false;
-      }
-   } else {
-      //      LOG(WARNING) << "timeout in zmq_pollout " << GetBinding();
+   if (mRing || mLog) {
+      LOG(WARNING) << "Stakes can't be fired over " << GetBinding();
       return false;
    }
+   zmq_msg_t message;
+   zmq_msg_init_size(&message, sizeof (void*));
+   memcpy(zmq_msg_data(&message), &(stake), sizeof (void*));
+   if (Send(message, waitToFire)) {
+      return true;
+   }
+   zmq_msg_close(&message);
+   return false;
 }
 
 /**
@@ -263,26 +871,20 @@ bool Rifle::FireStake(const void* stake, const int waitToFire) {
 bool Rifle::FireStakes(const std::vector<std::pair<void*, unsigned int> >
    & stakes, const int waitToFire) {
    bool success = false;
-   if (!mChamber) {
+   if (!mChamber && !mLog) {
       LOG(WARNING) << "Socket uninitialized!";
    } else if (stakes.empty()) {
       LOG(WARNING) << "Tried to send nothing";
+   } else if (mRing || mLog) {
+      LOG(WARNING) << "Stakes can't be fired over " << GetBinding();
    } else {
-      zmq_pollitem_t items [] = {
-         { mChamber, 0, ZMQ_POLLOUT, 0}
-      };
-
-      if (zmq_poll(items, 1, waitToFire) > 0) {
-         if (items[0].revents & ZMQ_POLLOUT) {
-            zmsg_t* message = zmsg_new();
-            zmsg_addmem(message, &(stakes[0]),
-               stakes.size() * (sizeof (std::pair<void*, unsigned int>)));
-            success = CZMQToolkit::SendExistingMessage(message, mChamber);
-         } else {
-            LOG(WARNING) << "Error in zmq_pollout in " << GetBinding() << ": " << zmq_strerror(zmq_errno());
-         }
-      } else {
-         //      LOG(WARNING) << "timeout in zmq_pollout " << GetBinding();
+      const size_t size = stakes.size() * (sizeof (std::pair<void*, unsigned int>));
+      zmq_msg_t message;
+      zmq_msg_init_size(&message, size);
+      memcpy(zmq_msg_data(&message), &(stakes[0]), size);
+      success = Send(message, waitToFire);
+      if (!success) {
+         zmq_msg_close(&message);
       }
    }
    return success;
@@ -300,6 +902,21 @@ void Rifle::Destroy() {
       mChamber = NULL;
       mContext = NULL;
    }
+   mRing.reset();
+   mLog.reset();
+   mCredits.clear();
+   mMisfired = false;
+   for (size_t held = 0; held < mHeld.size(); ++held) {
+      mMetrics.Drop();
+   }
+   mHeld.clear();
+   if (mSpill) {
+      if (Spilled() > 0) {
+         LOG(WARNING) << "Rifle lost " << Spilled() << " spilled bytes in " << mSpillDirectory;
+      }
+      mSpill->Clear();
+      mSpill.reset();
+   }
 }
 
 Rifle::~Rifle() {
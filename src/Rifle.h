@@ -1,13 +1,23 @@
 #pragma once
+#include <deque>
+#include <map>
 #include <vector>
 #include <string>
+#include <memory>
+#include <type_traits>
+#include <zmq.h>
 #include "CZMQToolkit.h"
+#include "Metrics.h"
+#include "MappedLog.h"
 
 #define SIZE_OF_STAKE_BUNDLE 500
 struct _zctx_t;
 typedef struct _zctx_t zctx_t;
+class ShmRing;
 class Rifle {
 public:
+   enum class Overload : std::int8_t { BLOCK = 0, DROP_NEWEST = 1, DROP_OLDEST = 2, SAMPLE = 3 };
+
    explicit Rifle(const std::string& location);
    bool Aim();
    std::string GetBinding() const;
@@ -16,18 +26,51 @@ public:
    bool FireStakes(const std::vector<std::pair<void*, unsigned int> >& stakes,
            const int waitToFire = 10000);
 
+   template<typename T> bool FireBatch(const T* batch, const size_t count, const int waitToFire = 10000);
+   template<typename T> bool FireBatch(const std::vector<T>& batch, const int waitToFire = 10000);
+
    bool FireZeroCopy( std::string* zero, const size_t size, void (*FreeFunction)(void*,void*), const int waitToFire = 10000);
+   bool FireZeroCopy(void* data, const size_t size, void (*FreeFunction)(void*,void*), void* hint, const int waitToFire = 10000);
    int GetHighWater();
    void SetHighWater(const int hwm);
    int GetIOThreads();
    void SetIOThreads(const int count);
    void SetOwnSocket(const bool own);
    bool GetOwnSocket();
+   void SetCreditFlow(const bool credit);
+   bool GetCreditFlow();
+   void SetOverload(const Overload overload, const size_t limit = 1);
+   Overload GetOverload() const;
+   size_t Held() const;
+   bool FireHeld(const int waitToFire = 10000);
+   void SetSpill(const std::string& directory,
+           const size_t segmentBytes = MappedLog::kDefaultSegmentBytes,
+           const size_t maxSegments = MappedLog::kDefaultMaxSegments);
+   uint64_t Spilled() const;
+   const Metrics& GetMetrics() const;
    virtual ~Rifle();
 protected:
    void Destroy();
+   void Dropped(const size_t count);
 private:
-   void setIpcFilePermissions();
+   friend class Reactor;
+   void setIpcFilePermissions(const std::string& location);
+   bool FireBytes(const void* data, const size_t size, const int waitToFire);
+   bool Shoot(const void* data, const size_t size, const int waitToFire, const bool policy);
+   bool FireOrHold(const void* data, const size_t size);
+   bool FireOrSpill(const void* data, const size_t size, const int waitToFire);
+   bool FireSpilled(const int waitToFire);
+   bool FireIntoRing(const void* data, const size_t size, const int waitToFire, const bool policy);
+   bool FireIntoLog(const void* data, const size_t size, const int waitToFire, const bool policy);
+   bool Send(zmq_msg_t& bullet, const int waitToFire, const bool policy = true);
+   bool Skip();
+   int Patience(const int waitToFire) const;
+   void Overloaded(const bool overloaded, const bool policy);
+   int TakeCredit(zmq_msg_t& bullet, const int waitToFire);
+   bool Unjam();
+   void CollectCredit();
+   int Polled(const int result, const uint64_t start);
+   bool Fired(const bool success, const size_t size, const uint64_t start);
    std::string mLocation;
    int mHwm;
    void* mChamber;
@@ -35,4 +78,42 @@ private:
    int mLinger;
    int mIOThredCount;
    bool mOwnSocket;
+   std::unique_ptr<ShmRing> mRing;
+   std::unique_ptr<MappedLog> mLog;
+   bool mCreditFlow;
+   // credit left per vampire identity
+   std::map<std::string, size_t> mCredits;
+   // an identity went out without its bullet, see Unjam
+   bool mMisfired;
+   Overload mOverload;
+   size_t mOverloadLimit;
+   bool mOverloaded;
+   size_t mSkipped;
+   std::deque<std::string> mHeld;
+   std::string mSpillDirectory;
+   size_t mSpillSegmentBytes;
+   size_t mSpillMaxSegments;
+   std::unique_ptr<MappedLog> mSpill;
+   // offset of the oldest spilled bullet not fired yet
+   uint64_t mSpillHead;
+   std::string mReloaded;
+   Metrics mMetrics;
 };
+
+/**
+ * Shoot an array of trivially copyable elements as one message, exactly the
+ * bytes of the array. Use packed element types such as PackedStake so no
+ * padding goes on the wire.
+ * @param batch
+ * @param count
+ * @param waitToFire in milliseconds
+ * @return 
+ */
+template<typename T> bool Rifle::FireBatch(const T* batch, const size_t count, const int waitToFire) {
+   static_assert(std::is_trivially_copyable<T>::value, "a batch is sent as raw bytes");
+   return FireBytes(batch, count * sizeof (T), waitToFire);
+}
+
+template<typename T> bool Rifle::FireBatch(const std::vector<T>& batch, const int waitToFire) {
+   return FireBatch(batch.data(), batch.size(), waitToFire);
+}
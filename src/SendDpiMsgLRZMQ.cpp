@@ -1,10 +1,46 @@
+#include <czmq.h>
+#include <g3log/g3log.hpp>
 #include "SendDpiMsgLRZMQ.h"
 SendDpiMsgLRZMQ::SendDpiMsgLRZMQ(const std::string& binding) :
-      Rifle(binding) {
+      Rifle(binding),
+      mFlushBytes(0),
+      mMaxLatencyMs(0),
+      mPendingRecords(0),
+      mPendingSince(0) {
 }
 
+/**
+ * Coalesced records that are still pending are fired without waiting, if
+ * that fails they are counted as dropped.
+ */
+SendDpiMsgLRZMQ::~SendDpiMsgLRZMQ() {
+   Flush(0);
+}
+
+/**
+ * Send a record, or add it to the pending frame when coalescing.
+ * @param data
+ * @return 
+ *   false if the record, or the frame it completed, could not be sent
+ */
 bool SendDpiMsgLRZMQ::SendData(const std::string& data) {
-   return Rifle::Fire(data);
+   if (mFlushBytes == 0) {
+      return Rifle::Fire(data);
+   }
+   if (data.empty()) {
+      return false;
+   }
+   if (mPending.empty()) {
+      mPendingSince = zclock_time();
+   }
+   const uint32_t length = data.size();
+   mPending.append(reinterpret_cast<const char*> (&length), sizeof (length));
+   mPending.append(data);
+   ++mPendingRecords;
+   if (mPending.size() >= mFlushBytes) {
+      return Flush();
+   }
+   return FlushIfDue();
 }
 
 bool SendDpiMsgLRZMQ::Initialize() {
@@ -17,3 +53,57 @@ bool SendDpiMsgLRZMQ::Initialize() {
 void SendDpiMsgLRZMQ::SetQueueSize(const int size) {
    return Rifle::SetHighWater(size);
 }
+
+/**
+ * Pack many small records into one frame, each prefixed by its length as a
+ * native uint32_t. The receiver must coalesce as well. A frame is fired once
+ * it holds flushBytes or its first record is maxLatencyMs old, which is
+ * checked on every SendData and FlushIfDue: call FlushIfDue while idle.
+ * @param flushBytes
+ *   0 sends every record on its own
+ * @param maxLatencyMs
+ */
+void SendDpiMsgLRZMQ::SetCoalescing(const size_t flushBytes, const int maxLatencyMs) {
+   Flush();
+   mFlushBytes = flushBytes;
+   mMaxLatencyMs = maxLatencyMs;
+}
+
+/**
+ * Fire the pending records now. If that fails they are dropped, each record
+ * counts as one in the Dropped metric.
+ * @param waitToFire in milliseconds
+ * @return 
+ */
+bool SendDpiMsgLRZMQ::Flush(const int waitToFire) {
+   if (mPending.empty()) {
+      return true;
+   }
+   const bool success = Rifle::Fire(mPending, waitToFire);
+   if (!success) {
+      LOG(WARNING) << "Dropped " << mPendingRecords << " coalesced records for " << GetBinding();
+      Dropped(mPendingRecords);
+   }
+   mPending.clear();
+   mPendingRecords = 0;
+   return success;
+}
+
+/**
+ * Fire the pending records if the oldest waited maxLatencyMs.
+ * @return 
+ *   false if they were due and could not be sent
+ */
+bool SendDpiMsgLRZMQ::FlushIfDue() {
+   if (mPending.empty() || zclock_time() - mPendingSince < mMaxLatencyMs) {
+      return true;
+   }
+   return Flush();
+}
+
+/**
+ * @return the bytes waiting to be fired, length prefixes included
+ */
+size_t SendDpiMsgLRZMQ::Pending() const {
+   return mPending.size();
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include "Rifle.h"
 
 class SendDpiMsgLRZMQ : public Rifle
@@ -7,7 +8,19 @@ class SendDpiMsgLRZMQ : public Rifle
 public:
    explicit SendDpiMsgLRZMQ(const std::string& binding);
    SendDpiMsgLRZMQ(zctx_t* context, const std::string& binding);
+   virtual ~SendDpiMsgLRZMQ();
    bool Initialize();
    bool SendData(const std::string& data);
    void SetQueueSize(const int size);
+   void SetCoalescing(const size_t flushBytes, const int maxLatencyMs);
+   bool Flush(const int waitToFire = 10000);
+   bool FlushIfDue();
+   size_t Pending() const;
+
+private:
+   size_t mFlushBytes;
+   int mMaxLatencyMs;
+   std::string mPending;
+   size_t mPendingRecords;
+   int64_t mPendingSince;
 };
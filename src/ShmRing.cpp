@@ -0,0 +1,352 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <g3log/g3log.hpp>
+#include "ShmRing.h"
+
+namespace {
+   const std::string kShmPrefix = "shm://";
+   // where Linux keeps the POSIX shared memory objects
+   const std::string kShmDirectory = "/dev/shm";
+   const uint64_t kMagic = 0x5155454e41444f31; // "QUENADO1"
+   // the rest of the ring is skipped, the record starts at the beginning
+   const uint32_t kWrap = UINT32_MAX;
+   const size_t kAlignment = 8;
+
+   uint64_t RecordSize(const size_t payload) {
+      return (sizeof (uint32_t) + payload + kAlignment - 1) / kAlignment * kAlignment;
+   }
+}
+
+/**
+ * The producer and consumer positions are the total bytes written and read,
+ * each on its own cache line. An owner that takes the place of the ring
+ * flags it as replaced, the side still mapping it then opens the new one.
+ */
+struct ShmRing::Header {
+   uint64_t magic;
+   uint64_t capacity;
+   alignas(64) std::atomic<uint64_t> head;
+   alignas(64) std::atomic<uint64_t> tail;
+   alignas(64) std::atomic<uint32_t> consumerWaiting;
+   std::atomic<uint32_t> replaced;
+};
+
+/**
+ * Open the ring. The owner creates it, taking the place of a ring an owner
+ * that crashed left behind. The other side maps the ring the owner created,
+ * if there is none yet it looks for it again on every Write or Peek.
+ * @param location
+ *   shm://name
+ * @param owner
+ *   The owner creates the ring and removes it when it is destroyed
+ * @param capacity
+ *   Bytes for the records if the ring is created, otherwise the size the
+ *   owner gave it is used
+ */
+ShmRing::ShmRing(const std::string& location, const bool owner, const size_t capacity) :
+mName(Name(location)),
+mOwner(owner),
+mHeader(NULL),
+mData(NULL),
+mMappedSize(0),
+mCapacity(0),
+mPeeked(0) {
+   if (mOwner) {
+      Create(capacity);
+   } else {
+      Attach();
+   }
+}
+
+/**
+ * Unmap the ring, the owner also removes it unless another owner took its
+ * place
+ */
+ShmRing::~ShmRing() {
+   const bool replaced = mHeader && mHeader->replaced.load(std::memory_order_acquire);
+   Detach();
+   if (mOwner && !replaced) {
+      shm_unlink(mName.c_str());
+   }
+}
+
+/**
+ * Build and size the ring under a name of its own and only then move it to
+ * its place, the other side never maps a ring that is not ready. The ring it
+ * replaces is flagged so the other side lets go of it.
+ * @param capacity
+ */
+void ShmRing::Create(const size_t capacity) {
+   const std::string building = mName + "." + std::to_string(getpid());
+   shm_unlink(building.c_str());
+   const int fd = shm_open(building.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+   if (fd < 0) {
+      LOG(WARNING) << "ShmRing could not create " << building << ": " << strerror(errno);
+      return;
+   }
+   const uint64_t records = (capacity + kAlignment - 1) / kAlignment * kAlignment;
+   if (ftruncate(fd, sizeof (Header) + records) != 0 || !Map(fd, sizeof (Header) + records)) {
+      LOG(WARNING) << "ShmRing could not size " << building << ": " << strerror(errno);
+      close(fd);
+      shm_unlink(building.c_str());
+      return;
+   }
+   close(fd);
+   new (mHeader) Header();
+   mHeader->capacity = mCapacity = records;
+   mHeader->head = 0;
+   mHeader->tail = 0;
+   mHeader->consumerWaiting = 0;
+   mHeader->replaced = 0;
+   mHeader->magic = kMagic;
+
+   ShmRing earlier(mName, false);
+   if (rename((kShmDirectory + building).c_str(), (kShmDirectory + mName).c_str()) != 0) {
+      LOG(WARNING) << "ShmRing could not publish " << mName << ": " << strerror(errno);
+      shm_unlink(building.c_str());
+      Detach();
+      return;
+   }
+   if (earlier.IsOpen()) {
+      // a consumer sleeping on the earlier ring is woken up by the next Write
+      mHeader->consumerWaiting = earlier.mHeader->consumerWaiting.load();
+      earlier.mHeader->replaced.store(1, std::memory_order_release);
+   }
+}
+
+/**
+ * Map the ring the owner created, the one mapped before is let go of
+ * @return
+ *   false if there is no ring yet
+ */
+bool ShmRing::Attach() {
+   Detach();
+   const int fd = shm_open(mName.c_str(), O_RDWR, 0666);
+   if (fd < 0) {
+      return false;
+   }
+   struct stat status;
+   const bool mapped = (fstat(fd, &status) == 0) &&
+           (status.st_size > static_cast<off_t> (sizeof (Header))) && Map(fd, status.st_size);
+   close(fd);
+   if (!mapped || mHeader->magic != kMagic ||
+           mHeader->capacity != mMappedSize - sizeof (Header)) {
+      Detach();
+      return false;
+   }
+   mCapacity = mHeader->capacity;
+   return true;
+}
+
+/**
+ * The side that did not create the ring maps it once there is one, and
+ * again when an owner took the place of the one it maps
+ * @return
+ *   If a ring is mapped
+ */
+bool ShmRing::Attached() {
+   if (mOwner) {
+      return mHeader != NULL;
+   }
+   if (mHeader && !mHeader->replaced.load(std::memory_order_acquire)) {
+      return true;
+   }
+   return Attach();
+}
+
+/**
+ * @param fd
+ * @param size
+ * @return
+ *   If the ring is mapped
+ */
+bool ShmRing::Map(const int fd, const size_t size) {
+   void* mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (mapped == MAP_FAILED) {
+      return false;
+   }
+   mMappedSize = size;
+   mHeader = reinterpret_cast<Header*> (mapped);
+   mData = reinterpret_cast<char*> (mapped) + sizeof (Header);
+   return true;
+}
+
+void ShmRing::Detach() {
+   if (mHeader) {
+      munmap(mHeader, mMappedSize);
+   }
+   mHeader = NULL;
+   mData = NULL;
+   mMappedSize = 0;
+   mCapacity = 0;
+   mPeeked = 0;
+}
+
+/**
+ * @return if the ring is mapped, the side that did not create it may map
+ *   it later
+ */
+bool ShmRing::IsOpen() const {
+   return mHeader != NULL;
+}
+
+/**
+ * @return the bytes available for records
+ */
+size_t ShmRing::Capacity() const {
+   return mCapacity;
+}
+
+/**
+ * Copy a record into the ring
+ * @param data
+ * @param size
+ * @return
+ *   false if the ring is too full, or the record can never fit
+ */
+bool ShmRing::Write(const void* data, const size_t size) {
+   const uint64_t record = RecordSize(size);
+   if (!Attached() || record > mCapacity || size >= kWrap) {
+      return false;
+   }
+   uint64_t head = mHeader->head.load(std::memory_order_relaxed);
+   const uint64_t tail = mHeader->tail.load(std::memory_order_acquire);
+   uint64_t offset = head % mCapacity;
+   const uint64_t skip = (offset + record > mCapacity) ? mCapacity - offset : 0;
+   if (head + skip + record - tail > mCapacity) {
+      return false;
+   }
+   if (skip) {
+      memcpy(mData + offset, &kWrap, sizeof (kWrap));
+      head += skip;
+      offset = 0;
+   }
+   const uint32_t length = size;
+   memcpy(mData + offset, &length, sizeof (length));
+   memcpy(mData + offset + sizeof (length), data, size);
+   // sequentially consistent so either the consumer sees the record or we
+   // see that it is waiting, see WakeNeeded
+   mHeader->head.store(head + record, std::memory_order_seq_cst);
+   return true;
+}
+
+/**
+ * Called after a Write, the consumer must be woken up if this is true. It is
+ * only true once for every time the consumer starts waiting.
+ * @return if the consumer is waiting
+ */
+bool ShmRing::WakeNeeded() {
+   return mHeader && mHeader->consumerWaiting.exchange(0, std::memory_order_seq_cst) != 0;
+}
+
+/**
+ * Copy the oldest record out of the ring
+ * @param data
+ * @return
+ *   false if the ring is empty
+ */
+bool ShmRing::Read(std::string& data) {
+   const char* record = NULL;
+   size_t size = 0;
+   if (!Peek(record, size)) {
+      return false;
+   }
+   data.assign(record, size);
+   Consume();
+   return true;
+}
+
+/**
+ * Look at the oldest record where it is in the ring, it stays there and
+ * the producer does not overwrite it until Consume
+ * @param data
+ * @param size
+ * @return
+ *   false if the ring is empty
+ */
+bool ShmRing::Peek(const char*& data, size_t& size) {
+   if (!mHeader && !Attached()) {
+      return false;
+   }
+   uint64_t tail = mHeader->tail.load(std::memory_order_relaxed);
+   uint64_t head = mHeader->head.load(std::memory_order_acquire);
+   if (tail == head) {
+      // the owner is gone when its ring stays empty, it may have a new one
+      if (mOwner || !mHeader->replaced.load(std::memory_order_acquire) || !Attach()) {
+         return false;
+      }
+      tail = mHeader->tail.load(std::memory_order_relaxed);
+      head = mHeader->head.load(std::memory_order_acquire);
+      if (tail == head) {
+         return false;
+      }
+   }
+   uint64_t offset = tail % mCapacity;
+   uint32_t length;
+   memcpy(&length, mData + offset, sizeof (length));
+   if (length == kWrap) {
+      tail += mCapacity - offset;
+      offset = 0;
+      memcpy(&length, mData, sizeof (length));
+   }
+   data = mData + offset + sizeof (length);
+   size = length;
+   mPeeked = tail + RecordSize(length);
+   return true;
+}
+
+/**
+ * Hand the record seen by the last Peek back to the producer
+ */
+void ShmRing::Consume() {
+   if (mHeader && mPeeked) {
+      mHeader->tail.store(mPeeked, std::memory_order_release);
+      mPeeked = 0;
+   }
+}
+
+/**
+ * The consumer flags that it is about to wait on the wake socket. It must
+ * try to Read once more after setting the flag, a record written just before
+ * does not wake it up.
+ * @param waiting
+ */
+void ShmRing::SetWaiting(const bool waiting) {
+   if (mHeader) {
+      mHeader->consumerWaiting.store(waiting ? 1 : 0, std::memory_order_seq_cst);
+   }
+}
+
+/**
+ * @param location
+ * @return if the location uses the shared memory transport
+ */
+bool ShmRing::IsShm(const std::string& location) {
+   return location.compare(0, kShmPrefix.size(), kShmPrefix) == 0;
+}
+
+/**
+ * @param location
+ *   shm://name
+ * @return the ipc location of the ZeroMQ socket used for wake ups
+ */
+std::string ShmRing::WakeLocation(const std::string& location) {
+   return "ipc:///tmp" + Name(location) + ".shm.ipc";
+}
+
+/**
+ * @param location
+ *   shm://name
+ * @return the shared memory object name, /name
+ */
+std::string ShmRing::Name(const std::string& location) {
+   std::string name = IsShm(location) ? location.substr(kShmPrefix.size()) : location;
+   const size_t start = name.find_first_not_of('/');
+   return "/" + (start == std::string::npos ? std::string() : name.substr(start));
+}
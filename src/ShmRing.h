@@ -0,0 +1,73 @@
+/*
+ * File:   ShmRing.h
+ *
+ * Single producer, single consumer ring buffer in POSIX shared memory. It is
+ * the data path of a Rifle and Vampire using a shm:// location.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * A shm://name location maps /dev/shm/name in both processes. Bullets are
+ * copied into the ring by the Rifle and out of it by the Vampire, straight
+ * into the caller's string or batch storage with Peek and Consume. No socket
+ * or kernel buffer is involved.
+ *
+ * The owner, the side that binds, creates the ring and the other side maps
+ * it, in either order: the other side looks for the ring on every Write or
+ * Peek until there is one. An owner takes the place of a ring an owner that
+ * crashed left behind, the other side then moves on to the new ring. Linux
+ * keeps the rings in /dev/shm.
+ *
+ * ZeroMQ is only used to wake up a Vampire that found the ring empty and is
+ * waiting: the Vampire flags that it is going to sleep and the Rifle sends
+ * one empty frame on the wake socket (WakeLocation) when it sees the flag.
+ *
+ * Only one Rifle and one Vampire may use a ring.
+ */
+class ShmRing {
+public:
+   ShmRing(const std::string& location, const bool owner, const size_t capacity = kDefaultCapacity);
+   virtual ~ShmRing();
+
+   bool IsOpen() const;
+   size_t Capacity() const;
+
+   // producer side
+   bool Write(const void* data, const size_t size);
+   bool WakeNeeded();
+
+   // consumer side
+   bool Read(std::string& data);
+   bool Peek(const char*& data, size_t& size);
+   void Consume();
+   void SetWaiting(const bool waiting);
+
+   static bool IsShm(const std::string& location);
+   static std::string WakeLocation(const std::string& location);
+
+   static const size_t kDefaultCapacity = 8 * 1024 * 1024;
+
+private:
+   ShmRing(const ShmRing&) = delete;
+   ShmRing& operator=(const ShmRing&) = delete;
+
+   struct Header;
+   void Create(const size_t capacity);
+   bool Attach();
+   bool Attached();
+   bool Map(const int fd, const size_t size);
+   void Detach();
+   static std::string Name(const std::string& location);
+
+   const std::string mName;
+   const bool mOwner;
+   Header* mHeader;
+   char* mData;
+   size_t mMappedSize;
+   uint64_t mCapacity;
+   // where the tail goes on Consume, 0 when nothing was peeked
+   uint64_t mPeeked;
+};
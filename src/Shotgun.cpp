@@ -5,15 +5,47 @@
 #include "g3log/g3log.hpp"
 #include "czmq.h"
 #include "Death.h"
+#include "CZMQToolkit.h"
+
+namespace {
+   // historically the first frame was an empty "key", Aliens subscribed to
+   // everything still receive it
+   const std::string kDefaultTopic;
+}
 /**
  * Shotgun class is a ZeroMQ Publisher.
  */
-Shotgun::Shotgun() {
+Shotgun::Shotgun() : mLastValueCache(false) {
    mCtx = zctx_new();
    assert(mCtx);
    mGun = zsocket_new(mCtx, ZMQ_PUB);
 }
 
+/**
+ * Keep the last bullets fired on every topic and replay them to Aliens that
+ * subscribe later, so a late joiner gets the current state without waiting
+ * for the next update. Must be called before Aim.
+ *
+ * The gun becomes an XPUB socket that sees every subscription. A replay goes
+ * to all Aliens subscribed to the topic, those already up to date get the
+ * last value a second time.
+ * @param enable
+ */
+void Shotgun::SetLastValueCache(const bool enable) {
+   if (enable == mLastValueCache) {
+      return;
+   }
+   zsocket_destroy(mCtx, mGun);
+   mGun = zsocket_new(mCtx, enable ? ZMQ_XPUB : ZMQ_PUB);
+   assert(mGun);
+   if (enable) {
+      zsocket_set_xpub_verbose(mGun, 1);
+   } else {
+      mLastValues.clear();
+   }
+   mLastValueCache = enable;
+}
+
 /**
  * Where to fire our messages.
  * @param location
@@ -52,6 +84,45 @@ void Shotgun::setIpcFilePermissions(const std::string& location) {
    }
 }
 
+/**
+ * Replay the cached last values to Aliens that subscribed since the last
+ * reload. Every Fire reloads without waiting, a Shotgun that fires rarely
+ * should reload periodically so late joiners are not kept waiting.
+ * @param timeout
+ *   How long to wait for the first subscription in milliseconds
+ */
+void Shotgun::Reload(const unsigned int timeout) {
+   if (!mLastValueCache) {
+      return;
+   }
+   int wait = timeout;
+   while (zsocket_poll(mGun, wait)) {
+      wait = 0;
+      zframe_t* subscription = zframe_recv(mGun);
+      if (!subscription) {
+         break;
+      }
+      // first byte is 1 for a subscribe and 0 for an unsubscribe, then the prefix
+      const char* data = reinterpret_cast<const char*> (zframe_data(subscription));
+      const size_t size = zframe_size(subscription);
+      if (size > 0 && data[0] == 1) {
+         Replay(std::string(data + 1, size - 1));
+      }
+      zframe_destroy(&subscription);
+   }
+}
+
+/**
+ * Fire the last value of every cached topic starting with the prefix
+ * @param prefix
+ */
+void Shotgun::Replay(const std::string& prefix) {
+   for (auto it = mLastValues.lower_bound(prefix);
+           it != mLastValues.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+      Send(it->first, it->second);
+   }
+}
+
 /**
  * Fire our shotgun, hopefully we hit something.
  * @param msg
@@ -68,7 +139,30 @@ void Shotgun::Fire(const std::string& bullet) {
  * @param msg
  */
 void Shotgun::Fire(const std::vector<std::string>& bullets) {
-   zframe_t* key = zframe_new("key", 0);
+   Fire(kDefaultTopic, bullets);
+}
+
+/**
+ * Fire at the Aliens subscribed to a prefix of the topic. ZeroMQ filters on
+ * the publishing side so Aliens that did not subscribe never receive it.
+ * @param topic
+ * @param bullets
+ */
+void Shotgun::Fire(const std::string& topic, const std::vector<std::string>& bullets) {
+   if (mLastValueCache) {
+      Reload(0);
+      mLastValues[topic] = bullets;
+   }
+   Send(topic, bullets);
+}
+
+/**
+ * Send one message, the topic frame followed by the bullets
+ * @param topic
+ * @param bullets
+ */
+void Shotgun::Send(const std::string& topic, const std::vector<std::string>& bullets) {
+   zframe_t* key = zframe_new(topic.data(), topic.size());
 
    zmsg_t* msg = zmsg_new();
    zmsg_add(msg, key);
@@ -85,6 +179,29 @@ void Shotgun::Fire(const std::vector<std::string>& bullets) {
    }
 }
 
+/**
+ * Fire without copying the bullets, ownership of the buffers is taken over
+ * and they are released once ZeroMQ has delivered them to every Alien. With
+ * the last value cache on a copy is kept to replay to late joiners.
+ * @param topic
+ * @param bullets
+ *   moved from
+ */
+void Shotgun::Fire(const std::string& topic, std::vector<std::string>&& bullets) {
+   if (mLastValueCache) {
+      Reload(0);
+      mLastValues[topic] = bullets;
+   }
+   if (bullets.empty()) {
+      Send(topic, bullets);
+      return;
+   }
+   if (zmq_send(mGun, topic.data(), topic.size(), ZMQ_SNDMORE) < 0 ||
+           !CZMQToolkit::SendZeroCopyFrames(std::move(bullets), mGun)) {
+      LOG(WARNING) << "could not send message";
+   }
+}
+
 /**
  * Cleanup our socket and context.
  */
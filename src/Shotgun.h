@@ -2,6 +2,7 @@
 
 
 #include <stdlib.h>
+#include <map>
 #include <vector>
 #include <string>
 struct _zctx_t;
@@ -9,12 +10,20 @@ typedef struct _zctx_t zctx_t;
 class Shotgun {
 public:
    Shotgun();
+   void SetLastValueCache(const bool enable);
    void Aim(const std::string& location);
+   void Reload(const unsigned int timeout);
    void Fire(const std::string& msg);
    void Fire(const std::vector<std::string>& bullets);
+   void Fire(const std::string& topic, const std::vector<std::string>& bullets);
+   void Fire(const std::string& topic, std::vector<std::string>&& bullets);
    virtual ~Shotgun();
 private:
    void setIpcFilePermissions(const std::string& location);
+   void Send(const std::string& topic, const std::vector<std::string>& bullets);
+   void Replay(const std::string& prefix);
    void *mGun;
    zctx_t *mCtx;
+   bool mLastValueCache;
+   std::map<std::string, std::vector<std::string> > mLastValues;
 };
@@ -0,0 +1,113 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <g3log/g3log.hpp>
+#include "StakeArena.h"
+
+namespace {
+   const size_t kHugePageSize = 2 * 1024 * 1024;
+
+   size_t RoundUp(const size_t length, const size_t multiple) {
+      return (length + multiple - 1) / multiple * multiple;
+   }
+}
+
+/**
+ * Map the memory for the stakes, nothing is touched yet
+ * @param stakeSize
+ *   The size of every stake
+ * @param stakeCount
+ *   The number of stakes
+ */
+StakeArena::StakeArena(const size_t stakeSize, const size_t stakeCount) :
+StakeArena(stakeSize, stakeCount, MapStakes(SlabSize(stakeSize, stakeCount))) {
+}
+
+StakeArena::StakeArena(const size_t stakeSize, const size_t stakeCount, const Mapping& mapping) :
+BufferPool(stakeSize, stakeCount, mapping.data, [mapping](char* data) {
+   munmap(data, mapping.length);
+}),
+mData(mapping.data),
+mLength(mapping.length),
+mHugePages(mapping.hugePages),
+mNode(-1) {
+}
+
+StakeArena::~StakeArena() {
+}
+
+/**
+ * Touch every page from the calling thread so it is placed on the NUMA node
+ * of that thread. Vampire::PrepareToBeShot calls it for its arena, see
+ * Vampire::SetStakeArena.
+ */
+void StakeArena::Prefault() {
+   if (!mData) {
+      return;
+   }
+   const size_t pageSize = mHugePages ? kHugePageSize : sysconf(_SC_PAGESIZE);
+   for (size_t offset = 0; offset < mLength; offset += pageSize) {
+      // a write is needed, reading maps the shared zero page
+      reinterpret_cast<volatile char*> (mData)[offset] = 0;
+   }
+   mNode = CurrentNode();
+   LOG(INFO) << "StakeArena placed " << mLength << " bytes on NUMA node " << mNode
+           << (mHugePages ? " in huge pages" : "");
+}
+
+/**
+ * @return the NUMA node the pages were placed on by Prefault, -1 before
+ *   Prefault or if it is unknown
+ */
+int StakeArena::Node() const {
+   return mNode;
+}
+
+/**
+ * @return if the arena got reserved huge pages, otherwise it relies on
+ *   transparent huge pages
+ */
+bool StakeArena::IsHugePageBacked() const {
+   return mHugePages;
+}
+
+/**
+ * @return the NUMA node the calling thread runs on, -1 if unknown
+ */
+int StakeArena::CurrentNode() {
+   unsigned cpu = 0;
+   unsigned node = 0;
+   if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+      return -1;
+   }
+   return node;
+}
+
+/**
+ * Map anonymous memory, huge pages if any are reserved
+ * @param length
+ * @return the mapping, data is NULL if nothing could be mapped
+ */
+StakeArena::Mapping StakeArena::MapStakes(const size_t length) {
+   Mapping mapping = {NULL, 0, false};
+   if (length == 0) {
+      return mapping;
+   }
+   const size_t hugeLength = RoundUp(length, kHugePageSize);
+   void* data = mmap(NULL, hugeLength, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+   if (data != MAP_FAILED) {
+      mapping = {reinterpret_cast<char*> (data), hugeLength, true};
+      return mapping;
+   }
+
+   const size_t pageLength = RoundUp(length, sysconf(_SC_PAGESIZE));
+   data = mmap(NULL, pageLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (data == MAP_FAILED) {
+      LOG(WARNING) << "StakeArena could not map " << pageLength << " bytes";
+      return mapping;
+   }
+   madvise(data, pageLength, MADV_HUGEPAGE);
+   mapping = {reinterpret_cast<char*> (data), pageLength, false};
+   return mapping;
+}
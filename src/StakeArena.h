@@ -0,0 +1,51 @@
+/*
+ * File:   StakeArena.h
+ *
+ * Huge page backed, NUMA local memory for stakes passed between a Rifle and
+ * a Vampire in the same process.
+ */
+#pragma once
+
+#include "BufferPool.h"
+
+/**
+ * FireStake and FireStakes only pass pointers, the payload stays where the
+ * producer allocated it. Allocating the payloads from an arena shared by the
+ * Rifle and the Vampire keeps them in a few huge pages (fewer TLB misses) and
+ * on the memory node of the consumer.
+ *
+ * Memory is mapped with MAP_HUGETLB when huge pages are reserved, otherwise
+ * it is regular memory advised for transparent huge pages. Pages are placed
+ * on first touch: the arena is handed to the consuming Vampire with
+ * SetStakeArena, and its PrepareToBeShot, called on the consuming thread,
+ * prefaults it before the first stake is fired. With the default NUMA policy
+ * every page lands on the node of that thread.
+ *
+ * The producer Acquires a stake, fills it and fires it with FireStake, the
+ * consumer Releases it once it is done with it.
+ */
+class StakeArena : public BufferPool {
+public:
+   StakeArena(const size_t stakeSize, const size_t stakeCount);
+   virtual ~StakeArena();
+
+   void Prefault();
+   int Node() const;
+   bool IsHugePageBacked() const;
+   static int CurrentNode();
+
+private:
+   struct Mapping {
+      char* data;
+      size_t length;
+      bool hugePages;
+   };
+   StakeArena(const size_t stakeSize, const size_t stakeCount, const Mapping& mapping);
+   static Mapping MapStakes(const size_t length);
+
+   char* mData;
+   const size_t mLength;
+   const bool mHugePages;
+   // where Prefault placed the pages, -1 before
+   int mNode;
+};
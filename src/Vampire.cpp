@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <boost/thread.hpp>
 #define _OPEN_SYS
 #include <sys/stat.h>
@@ -6,7 +8,14 @@
 #include "czmq.h"
 #include "g3log/g3log.hpp"
 #include "Death.h"
+#include "ShmRing.h"
+#include "MappedLog.h"
+#include "StakeArena.h"
 
+namespace {
+   // how often to look for a shared memory ring the rifle did not create yet
+   const int kRingRetryMs = 10;
+}
 
 /**
  * Construct our Vampire which is a pull in our ZMQ push pull.
@@ -18,7 +27,13 @@ mBody(NULL),
 mContext(NULL),
 mLinger(10),
 mIOThredCount(1),
-mOwnSocket(false) {
+mOwnSocket(false),
+mCreditWindow(0),
+mCredit(0),
+mConsumer("vampire"),
+mOffset(0),
+mArena(NULL),
+mMetrics("Vampire", location) {
 }
 
 /**
@@ -29,6 +44,30 @@ std::string Vampire::GetBinding() const {
    return mLocation;
 }
 
+/**
+ * The edge triggered file descriptor of the body, see
+ * CZMQToolkit::GetFileDescriptor. When it fires keep getting shot while
+ * IsReadable.
+ * @return the descriptor, -1 before PrepareToBeShot
+ */
+int Vampire::GetFileDescriptor() const {
+   return CZMQToolkit::GetFileDescriptor(mBody);
+}
+
+/**
+ * @return if a shot or stake can be taken without waiting
+ */
+bool Vampire::IsReadable() const {
+   return CZMQToolkit::IsReadable(mBody);
+}
+
+/**
+ * @return the counters of this vampire, also in the MetricsRegistry
+ */
+const Metrics& Vampire::GetMetrics() const {
+   return mMetrics;
+}
+
 /**
  * Get our high water mark.
  * @return 
@@ -69,6 +108,80 @@ bool Vampire::GetOwnSocket() {
    return mOwnSocket;
 }
 
+/**
+ * Ask a Rifle with credit flow for at most credit shots at a time, the
+ * Rifle sends to the Vampire with the most credit left. Keep it below the
+ * high water mark. This must be called before PrepareToBeShot.
+ * @param credit
+ *   0 to get shot round robin by a plain Rifle
+ */
+void Vampire::SetCredit(const size_t credit) {
+   mCreditWindow = credit;
+   mCredit = credit;
+}
+
+/**
+ * Get the credit, 0 without credit flow.
+ * @return 
+ */
+size_t Vampire::GetCredit() {
+   return mCreditWindow;
+}
+
+/**
+ * Name the Vampire reading a log:// location. Every consumer gets every
+ * shot and goes on from the offset it committed last. This must be called
+ * before PrepareToBeShot.
+ * @param consumer
+ *   A file name
+ */
+void Vampire::SetConsumer(const std::string& consumer) {
+   mConsumer = consumer;
+}
+
+/**
+ * Hand over the arena the stakes shot at this Vampire come from.
+ * PrepareToBeShot prefaults it, call that from the consuming thread so the
+ * pages land on its NUMA node. This must be called before PrepareToBeShot.
+ * @param arena
+ *   Not owned, it must outlive the stakes in flight
+ */
+void Vampire::SetStakeArena(StakeArena* arena) {
+   mArena = arena;
+}
+
+/**
+ * @return the offset of the next shot in the log
+ */
+uint64_t Vampire::GetOffset() const {
+   return mOffset;
+}
+
+/**
+ * Go back or forward in the log, to replay shots from an offset
+ * @param offset
+ *   A GetOffset from before, moved up to the oldest shot the Rifle did not
+ *   remove yet
+ * @return 
+ *   false if the location is not a log
+ */
+bool Vampire::Seek(const uint64_t offset) {
+   if (!mLog) {
+      return false;
+   }
+   mOffset = std::max(offset, mLog->Oldest());
+   return true;
+}
+
+/**
+ * Commit the shots taken from the log so far, they are not taken again
+ * after a restart and the Rifle may remove them
+ * @return 
+ */
+bool Vampire::Commit() {
+   return mLog && mLog->Commit(mConsumer, mOffset);
+}
+
 /**
  * Get IO thread count;
  * @param count
@@ -78,14 +191,28 @@ int Vampire::GetIOThreads() {
 }
 
 /**
- * Set the location we are going to be shot at.
+ * Set the location we are going to be shot at. For a shm://name location the
+ * shots come out of a shared memory ring, the socket only wakes us up, see
+ * ShmRing. For a log://directory location the shots are read from a
+ * MappedLog at the offset the consumer committed, see SetConsumer.
  * @param location
  * @return 
  */
 bool Vampire::PrepareToBeShot() {
-   if (mBody) {
+   if (mBody || mLog) {
       return true;
    }
+   if (MappedLog::IsLog(mLocation)) {
+      mLog.reset(new MappedLog(MappedLog::LogDirectory(mLocation)));
+      if (!mLog->Open(true)) {
+         mLog.reset();
+         LOG(WARNING) << "Vampire Can't open : " << mLocation;
+         return false;
+      }
+      mOffset = std::max(mLog->Committed(mConsumer), mLog->Begin());
+      // committing right away keeps the Rifle from removing what we did not take
+      return Commit();
+   }
    if (!mContext) {
       mContext = zctx_new();
       zctx_set_sndhwm(mContext, GetHighWater());
@@ -94,10 +221,16 @@ bool Vampire::PrepareToBeShot() {
       zctx_set_iothreads(mContext, GetIOThreads());
    }
    if (!mBody) {
-      mBody = zsocket_new(mContext, ZMQ_PULL);
+      const bool shm = ShmRing::IsShm(mLocation);
+      const std::string location = shm ? ShmRing::WakeLocation(mLocation) : mLocation;
+      if (shm && mCreditWindow) {
+         LOG(WARNING) << "Vampire has no credit flow over " << mLocation;
+         return false;
+      }
+      mBody = zsocket_new(mContext, mCreditWindow ? ZMQ_DEALER : ZMQ_PULL);
       CZMQToolkit::setHWMAndBuffer(mBody, GetHighWater());
       if (GetOwnSocket()) {
-         int result = zsocket_bind(mBody, mLocation.c_str());
+         int result = zsocket_bind(mBody, location.c_str());
 
          if (result < 0) {
             zsocket_destroy(mContext, mBody);
@@ -105,10 +238,10 @@ bool Vampire::PrepareToBeShot() {
             LOG(WARNING) << "Vampire Can't bind : " << result;
             return false;
          }
-         setIpcFilePermissions();
-         Death::Instance().RegisterDeathEvent(&Death::DeleteIpcFiles, mLocation);
+         setIpcFilePermissions(location);
+         Death::Instance().RegisterDeathEvent(&Death::DeleteIpcFiles, location);
       } else {
-         int result = zsocket_connect(mBody, mLocation.c_str());
+         int result = zsocket_connect(mBody, location.c_str());
          if (result < 0) {
             zsocket_destroy(mContext, mBody);
             mBody = NULL;
@@ -116,7 +249,22 @@ bool Vampire::PrepareToBeShot() {
             return false;
          }
       }
+      if (shm) {
+         mRing.reset(new ShmRing(mLocation, GetOwnSocket()));
+         // a ring the rifle did not create yet is mapped once it is there
+         if (GetOwnSocket() && !mRing->IsOpen()) {
+            mRing.reset();
+            zsocket_destroy(mContext, mBody);
+            mBody = NULL;
+            LOG(WARNING) << "Vampire Can't map : " << mLocation;
+            return false;
+         }
+      }
       CZMQToolkit::PrintCurrentHighWater(mBody, "Vampire: body");
+      RequestShots();
+      if (mArena) {
+         mArena->Prefault();
+      }
    }
    return ((mContext != NULL) && (mBody != NULL));
 
@@ -125,16 +273,16 @@ bool Vampire::PrepareToBeShot() {
 /**
  * Set the file permisions on an IPC socket to 0777
  */
-void Vampire::setIpcFilePermissions() {
+void Vampire::setIpcFilePermissions(const std::string& location) {
 
    mode_t mode = S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP
       | S_IXGRP | S_IROTH | S_IWOTH | S_IXOTH;
 
-   size_t ipcFound = mLocation.find("ipc");
+   size_t ipcFound = location.find("ipc");
    if (ipcFound != std::string::npos) {
-      size_t tmpFound = mLocation.find("/tmp");
+      size_t tmpFound = location.find("/tmp");
       if (tmpFound != std::string::npos) {
-         std::string ipcFile = mLocation.substr(tmpFound);
+         std::string ipcFile = location.substr(tmpFound);
          LOG(INFO) << "Vampire set ipc permissions: " << ipcFile;
          chmod(ipcFile.c_str(), mode);
       }
@@ -147,44 +295,254 @@ void Vampire::setIpcFilePermissions() {
  * @return 
  */
 bool Vampire::GetShot(std::string& wound, const int timeout) {
-   if (!mBody) {
+   if (!mBody && !mLog) {
       LOG(WARNING) << "Socket uninitialized!";
       boost::this_thread::sleep(boost::posix_time::seconds(1));
       return false;
    }
+   const uint64_t start = Metrics::Now();
+   if (mRing || mLog) {
+      if (Polled(mRing ? GetShotFromRing(wound, timeout) : GetShotFromLog(wound, timeout), start)) {
+         mMetrics.Count(wound.size(), start);
+         return true;
+      }
+      return false;
+   }
+   RequestShots();
    bool success = false;
-   zmsg_t* message = NULL;
-   zmq_pollitem_t items [] = {
-      { mBody, 0, ZMQ_POLLIN, 0}
-   };
-   int pollResult = zmq_poll(items, 1, timeout);
-   if (pollResult > 0) {
-      if (items[0].revents & ZMQ_POLLIN) {
-         message = zmsg_recv(mBody);
-         if (message && zmsg_size(message) == 1) {
-            zframe_t* frame = zmsg_last(message);
-            wound.clear();
-            wound.append(reinterpret_cast<char*> (zframe_data(frame)), zframe_size(frame));
-            success = true;
-         } else {
-            if (!message) {
-               LOG(INFO) << "received null message, time for shutdown.";
-            } else {
-               LOG(WARNING) << "Received invalid sized message of size: " << zmsg_size(message);
-            }
+   zmq_msg_t message;
+   zmq_msg_init(&message);
+   const int received = Receive(message, timeout, start);
+   if (received > 0) {
+      wound.assign(reinterpret_cast<const char*> (zmq_msg_data(&message)), zmq_msg_size(&message));
+      mMetrics.Count(wound.size(), start);
+      success = true;
+   } else if (received < 0) {
+      LOG(WARNING) << "Received invalid sized message";
+      mMetrics.Error();
+   }
+   zmq_msg_close(&message);
+   return success;
+}
+
+/**
+ * Wait for the next shot on the body. With credit flow a lone empty frame
+ * ends a message the Rifle could not finish sending, the Rifle did not
+ * spend credit on it. It is skipped and the wait goes on until the timeout.
+ * @param message
+ *   Initialized, gets the shot
+ * @param timeout in milliseconds, -1 waits forever
+ * @param start
+ * @return
+ *   1 for a shot, -1 for a message of more than one frame, 0 on timeout
+ */
+int Vampire::Receive(zmq_msg_t& message, const int timeout, const uint64_t start) {
+   const int64_t deadline = zclock_time() + timeout;
+   int remaining = timeout;
+   while (zsocket_poll(mBody, remaining)) {
+      if (zmq_msg_recv(&message, mBody, 0) < 0) {
+         LOG(INFO) << "received null message, time for shutdown.";
+         break;
+      }
+      if (zmq_msg_more(&message)) {
+         Bitten();
+         zmq_msg_t rest;
+         zmq_msg_init(&rest);
+         while (zmq_msg_recv(&rest, mBody, 0) >= 0 && zmq_msg_more(&rest)) {
          }
-      } else {
-         LOG(WARNING) << "Error in zmq_pollin " << GetBinding();
+         zmq_msg_close(&rest);
+         Polled(true, start);
+         return -1;
+      }
+      if (!mCreditWindow || zmq_msg_size(&message) > 0) {
+         Bitten();
+         Polled(true, start);
+         return 1;
       }
+      remaining = (timeout < 0) ? -1 : std::max<int64_t>(deadline - zclock_time(), 0);
+   }
+   Polled(false, start);
+   return 0;
+}
 
-   } else if (pollResult < 0) {
-      LOG(WARNING) << "Error on zmq socket receiving " << GetBinding() << ": " << zmq_strerror(zmq_errno());
+/**
+ * Get shot out of the shared memory ring
+ * @param wound
+ * @param timeout in milliseconds, -1 waits forever
+ * @return 
+ */
+bool Vampire::GetShotFromRing(std::string& wound, const int timeout) {
+   const char* data = NULL;
+   size_t size = 0;
+   if (!PeekRing(data, size, timeout)) {
+      return false;
+   }
+   wound.assign(data, size);
+   mRing->Consume();
+   return true;
+}
+
+/**
+ * Find the next shot in the shared memory ring, it stays there until
+ * mRing->Consume. When it is empty flag that we wait and sleep on the body
+ * until the rifle wakes us up or the timeout passes.
+ * @param data
+ * @param size
+ * @param timeout in milliseconds, -1 waits forever
+ * @return 
+ */
+bool Vampire::PeekRing(const char*& data, size_t& size, const int timeout) {
+   const int64_t deadline = zclock_time() + timeout;
+   while (!mRing->Peek(data, size)) {
+      mRing->SetWaiting(true);
+      // a shot fired before the flag was set does not wake us up
+      if (mRing->Peek(data, size)) {
+         mRing->SetWaiting(false);
+         return true;
+      }
+      const int remaining = (timeout < 0) ? -1 : std::max<int64_t>(deadline - zclock_time(), 0);
+      // nothing wakes us up before the rifle created the ring, look again soon
+      const int wait = mRing->IsOpen() ? remaining :
+              ((remaining < 0) ? kRingRetryMs : std::min(remaining, kRingRetryMs));
+      const bool woken = (wait != 0) && zsocket_poll(mBody, wait);
+      mRing->SetWaiting(false);
+      DrainWakeUps();
+      if (!woken && wait == remaining) {
+         return mRing->Peek(data, size);
+      }
+   }
+   return true;
+}
+
+/**
+ * Get shot out of the log at our offset. There is nothing to wake us up,
+ * when the log has nothing new check it again every millisecond until the
+ * timeout passes.
+ * @param wound
+ * @param timeout in milliseconds, -1 waits forever
+ * @return 
+ */
+bool Vampire::GetShotFromLog(std::string& wound, const int timeout) {
+   const int64_t deadline = zclock_time() + timeout;
+   while (!mLog->Read(mOffset, wound)) {
+      if (zctx_interrupted || (timeout >= 0 && zclock_time() >= deadline)) {
+         return false;
+      }
+      zclock_sleep(1);
+   }
+   mLog->Release(mOffset);
+   return true;
+}
+
+/**
+ * Wake ups carry nothing, drop the ones that arrived.
+ */
+void Vampire::DrainWakeUps() {
+   zframe_t* frame = NULL;
+   while ((frame = zframe_recv_nowait(mBody)) != NULL) {
+      zframe_destroy(&frame);
+   }
+}
+
+/**
+ * Grant the Rifle the credit used up since the last grant. Like the
+ * Harpoon it is done before every wait so the Rifle never waits on a
+ * Vampire that is idle.
+ */
+void Vampire::RequestShots() {
+   if (mCredit == 0 || !mBody) {
+      return;
+   }
+   const uint32_t credit = mCredit;
+   if (zmq_send(mBody, &credit, sizeof (credit), ZMQ_DONTWAIT) == sizeof (credit)) {
+      mCredit = 0;
+   }
+   // else no rifle is connected yet, the credit goes with the next grant
+}
+
+/**
+ * A shot was taken, it is paid for with the next grant.
+ */
+void Vampire::Bitten() {
+   if (mCreditWindow) {
+      mCredit++;
+   }
+}
+
+/**
+ * Count the wait for something to arrive
+ * @param ready
+ * @param start
+ * @return ready
+ */
+bool Vampire::Polled(const bool ready, const uint64_t start) {
+   if (ready) {
+      mMetrics.Blocked(start);
    } else {
-      //socket timed out
+      mMetrics.Timeout(start);
+   }
+   return ready;
+}
+
+/**
+ * Receive one batch and copy it where storage says, for GetBatch.
+ * @param elementSize
+ *   The batch must be a whole number of elements
+ * @param storage
+ * @param timeout
+ * @return 
+ *   If a batch was copied
+ */
+bool Vampire::GetBatchBytes(const size_t elementSize, const BatchStorage& storage, const int timeout) {
+   if (!mBody && !mLog) {
+      LOG(WARNING) << "Socket uninitialized!";
+      boost::this_thread::sleep(boost::posix_time::seconds(1));
+      return false;
    }
-   if (message) {
-      zmsg_destroy(&message);
+   std::string wound;
+   zmq_msg_t message;
+   zmq_msg_init(&message);
+   const char* data = NULL;
+   size_t size = 0;
+   RequestShots();
+   const uint64_t start = Metrics::Now();
+   if (mRing) {
+      // copied straight out of the ring into the storage
+      Polled(PeekRing(data, size, timeout), start);
+   } else if (mLog) {
+      if (Polled(GetShotFromLog(wound, timeout), start)) {
+         data = wound.data();
+         size = wound.size();
+      }
+   } else {
+      const int received = Receive(message, timeout, start);
+      if (received < 0) {
+         LOG(WARNING) << "Received invalid message.";
+         mMetrics.Error();
+      } else if (received > 0) {
+         data = reinterpret_cast<const char*> (zmq_msg_data(&message));
+         size = zmq_msg_size(&message);
+      }
    }
+   bool success = false;
+   if (data && (size == 0 || size % elementSize != 0)) {
+      LOG(WARNING) << "Received a batch of " << size << " bytes, not a multiple of " << elementSize;
+      mMetrics.Error();
+   } else if (data) {
+      void* destination = storage(size);
+      if (destination) {
+         memcpy(destination, data, size);
+         mMetrics.Count(size, start);
+         success = true;
+      } else {
+         LOG(WARNING) << "Received a batch of " << size << " bytes, too large for the storage given";
+         mMetrics.Error();
+      }
+   }
+   if (mRing && data) {
+      mRing->Consume();
+   }
+   zmq_msg_close(&message);
    return success;
 }
 
@@ -196,34 +554,33 @@ bool Vampire::GetShot(std::string& wound, const int timeout) {
  *   If something was found
  */
 bool Vampire::GetStake(void*& stake, const int timeout) {
-   if (!mBody) {
+   if (!mBody && !mLog) {
       LOG(WARNING) << "Socket uninitialized!";
       boost::this_thread::sleep(boost::posix_time::seconds(1));
       return false;
    }
-   bool success = false;
-   zmsg_t* message = NULL;
-   if (zsocket_poll(mBody, timeout)) {
-      message = zmsg_recv(mBody);
-      if (message && (zmsg_size(message) == 1)) {
-         zframe_t* frame = zmsg_pop(message);
-         if (frame && zframe_size(frame) != sizeof (void*)) {
-            LOG(WARNING) << "Received non-pointer message.";
-         } else if(frame) {
-            stake = *reinterpret_cast<void**> (zframe_data(frame));
-            success = true;
-         }
-         //always delete frame if it exists
-         if (frame) {
-            zframe_destroy(&frame);
-         }
-      } else if (message) {
-         LOG(WARNING) << "Received an invalid message";
-      }
+   if (mRing || mLog) {
+      LOG(WARNING) << "Stakes can't be taken from " << GetBinding();
+      return false;
    }
-   if (message) {
-      zmsg_destroy(&message);
+   RequestShots();
+   bool success = false;
+   zmq_msg_t message;
+   zmq_msg_init(&message);
+   const uint64_t start = Metrics::Now();
+   const int received = Receive(message, timeout, start);
+   if (received > 0 && zmq_msg_size(&message) != sizeof (void*)) {
+      LOG(WARNING) << "Received non-pointer message.";
+      mMetrics.Error();
+   } else if (received > 0) {
+      memcpy(&stake, zmq_msg_data(&message), sizeof (void*));
+      mMetrics.Count(sizeof (void*), start);
+      success = true;
+   } else if (received < 0) {
+      LOG(WARNING) << "Received an invalid message";
+      mMetrics.Error();
    }
+   zmq_msg_close(&message);
    if (!success) {
       stake = NULL;
    }
@@ -251,37 +608,34 @@ bool Vampire::GetStakeNoWait(void*& stake) {
  */
 bool Vampire::GetStakes(std::vector<std::pair<void*, unsigned int> >& stakes,
    const int timeout) {
-   if (!mBody) {
+   if (!mBody && !mLog) {
       LOG(WARNING) << "Socket uninitialized!";
       boost::this_thread::sleep(boost::posix_time::seconds(1));
       return false;
    }
-   bool success = false;
-   zmsg_t* message = NULL;
-   if (zsocket_poll(mBody, timeout)) {
-      message = zmsg_recv(mBody);
-      if (message && zmsg_size(message) == 1) {
-         zframe_t* frame = zmsg_pop(message);
-         if (frame && zframe_size(frame) < (sizeof (std::pair<void*, unsigned int>))) {
-            LOG(WARNING) << "Received non-pointer message.";
-         } else if (frame) {
-            stakes.clear();
-            stakes.assign(reinterpret_cast<std::pair<void*, unsigned int>*> (zframe_data(frame)),
-               reinterpret_cast<std::pair<void*, unsigned int>*> (zframe_data(frame))
-               + (zframe_size(frame) / sizeof (std::pair<void*, unsigned int>)));
-            success = true;
-         }
-         //always delete frame if it exists
-         if (frame) {
-            zframe_destroy(&frame);
-         }
-      } else if (!message || (zmsg_size(message) != 1)) {
-         LOG(WARNING) << "Received invalid message.";
-      }
+   if (mRing || mLog) {
+      LOG(WARNING) << "Stakes can't be taken from " << GetBinding();
+      return false;
    }
-   if (message) {
-      zmsg_destroy(&message);
+   RequestShots();
+   bool success = false;
+   zmq_msg_t message;
+   zmq_msg_init(&message);
+   const uint64_t start = Metrics::Now();
+   const int received = Receive(message, timeout, start);
+   if (received > 0 && zmq_msg_size(&message) < (sizeof (std::pair<void*, unsigned int>))) {
+      LOG(WARNING) << "Received non-pointer message.";
+      mMetrics.Error();
+   } else if (received > 0) {
+      stakes.resize(zmq_msg_size(&message) / sizeof (std::pair<void*, unsigned int>));
+      memcpy(static_cast<void*> (&stakes[0]), zmq_msg_data(&message), stakes.size() * sizeof (std::pair<void*, unsigned int>));
+      mMetrics.Count(zmq_msg_size(&message), start);
+      success = true;
+   } else if (received < 0) {
+      LOG(WARNING) << "Received invalid message.";
+      mMetrics.Error();
    }
+   zmq_msg_close(&message);
    if (!success) {
       stakes.clear();
    }
@@ -301,6 +655,8 @@ void Vampire::Destroy() {
       mContext = NULL;
       mBody = NULL;
    }
+   mRing.reset();
+   mLog.reset();
 }
 
 /**
@@ -1,30 +1,63 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include <zmq.h>
 #include "CZMQToolkit.h"
+#include "Metrics.h"
 struct _zctx_t;
 typedef struct _zctx_t zctx_t;
+class ShmRing;
+class MappedLog;
+class StakeArena;
 class Vampire {
 public:
    explicit Vampire(const std::string& location);
    bool PrepareToBeShot();
    std::string GetBinding() const;
+   int GetFileDescriptor() const;
+   bool IsReadable() const;
    bool GetShot(std::string& wound, const int timeout);
    bool GetStake(void*& stake, const int timeout=1000);
    bool GetStakeNoWait(void*& stake);
    bool GetStakes(std::vector<std::pair<void*, unsigned int> >& stakes,
            const int timeout=1000);
+   template<typename T> bool GetBatch(T* batch, const size_t capacity, size_t& count,
+           const int timeout = 1000);
+   template<typename T> bool GetBatch(std::vector<T>& batch, const int timeout = 1000);
    int GetHighWater();
    void SetHighWater(const int hwm);
    int GetIOThreads();
    void SetIOThreads(const int count);
    void SetOwnSocket(const bool own);
    bool GetOwnSocket();
+   void SetCredit(const size_t credit);
+   size_t GetCredit();
+   void SetConsumer(const std::string& consumer);
+   void SetStakeArena(StakeArena* arena);
+   uint64_t GetOffset() const;
+   bool Seek(const uint64_t offset);
+   bool Commit();
+   const Metrics& GetMetrics() const;
    virtual ~Vampire();
 protected:
    void Destroy();
 private:
-   void setIpcFilePermissions();
+   friend class Poller;
+   // gets the size of a received batch, returns where to copy it or NULL
+   typedef std::function<void*(const size_t)> BatchStorage;
+   bool GetBatchBytes(const size_t elementSize, const BatchStorage& storage, const int timeout);
+   void setIpcFilePermissions(const std::string& location);
+   bool GetShotFromRing(std::string& wound, const int timeout);
+   bool PeekRing(const char*& data, size_t& size, const int timeout);
+   bool GetShotFromLog(std::string& wound, const int timeout);
+   void DrainWakeUps();
+   void RequestShots();
+   int Receive(zmq_msg_t& message, const int timeout, const uint64_t start);
+   void Bitten();
+   bool Polled(const bool ready, const uint64_t start);
    std::string mLocation;
    int mHwm;
    void* mBody;
@@ -32,4 +65,47 @@ private:
    int mLinger;
    int mIOThredCount;
    bool mOwnSocket;
+   std::unique_ptr<ShmRing> mRing;
+   std::unique_ptr<MappedLog> mLog;
+   size_t mCreditWindow;
+   // credit used up and not granted again yet
+   size_t mCredit;
+   std::string mConsumer;
+   uint64_t mOffset;
+   // not owned, prefaulted by PrepareToBeShot
+   StakeArena* mArena;
+   Metrics mMetrics;
 };
+
+/**
+ * Get a batch fired with Rifle::FireBatch straight into the caller's array
+ * @param batch
+ * @param capacity
+ *   Elements that fit in batch, a larger batch is dropped
+ * @param count
+ *   Elements received
+ * @param timeout
+ * @return 
+ *   If a batch was received
+ */
+template<typename T> bool Vampire::GetBatch(T* batch, const size_t capacity, size_t& count,
+        const int timeout) {
+   static_assert(std::is_trivially_copyable<T>::value, "a batch is received as raw bytes");
+   count = 0;
+   return GetBatchBytes(sizeof (T), [&](const size_t size) -> void* {
+      if (size > capacity * sizeof (T)) {
+         return NULL;
+      }
+      count = size / sizeof (T);
+      return batch;
+   }, timeout);
+}
+
+template<typename T> bool Vampire::GetBatch(std::vector<T>& batch, const int timeout) {
+   static_assert(std::is_trivially_copyable<T>::value, "a batch is received as raw bytes");
+   batch.clear();
+   return GetBatchBytes(sizeof (T), [&](const size_t size) -> void* {
+      batch.resize(size / sizeof (T));
+      return batch.data();
+   }, timeout);
+}
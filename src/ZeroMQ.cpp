@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "ZeroMQ.h"
@@ -5,6 +6,7 @@
 #include "CZMQToolkit.h"
 #include "g3log/g3log.hpp"
 #include "Death.h"
+#include "HashRing.h"
 
 /*
  * An overload of the normal free call that would clear message data
@@ -25,8 +27,8 @@ using namespace boost;
  * the child thread number.
  */
 ZeroMQ<void*>::ZeroMQ(const unsigned int id) :
-IComponentQueue::IComponentQueue(), mId(id), mOwnsContext(
-true), mContext(NULL), mSocket(NULL) {
+mId(id), mOwnsContext(
+true), mContext(NULL), mSocket(NULL), mRouting(false), mClientId(0), mLock(NULL) {
    stringstream bindingStream;
    bindingStream << "inproc://voidstar_" << getpid() << "_" << mId;
    mBinding = bindingStream.str();
@@ -39,9 +41,9 @@ true), mContext(NULL), mSocket(NULL) {
  * Inherits access to the context used by the source Queue as well as internal settings
  */
 ZeroMQ<void*>::ZeroMQ(const ZeroMQ<void*>& that) :
-IComponentQueue::IComponentQueue(), mId(that.mId), mBinding(
+mId(that.mId), mBinding(
 that.mBinding), mOwnsContext(false), mContext(that.mContext), mSocket(
-NULL) {
+NULL), mRouting(that.mRouting), mClientId(0), mLock(NULL) {
 
 }
 
@@ -51,9 +53,24 @@ NULL) {
  * Inherits access to the context used by the source Queue as well as internal settings
  */
 ZeroMQ<void*>::ZeroMQ(const ZeroMQ<void*>* that) :
-IComponentQueue::IComponentQueue(), mId(that->mId), mBinding(
+mId(that->mId), mBinding(
 that->mBinding), mOwnsContext(false), mContext(that->mContext), mSocket(
-NULL) {
+NULL), mRouting(that->mRouting), mClientId(0), mLock(NULL) {
+
+}
+
+/**
+ * Client of a routing server
+ *
+ * @param server
+ *   Routing, and initialized before the client is
+ * @param clientId
+ *   The id the server routes to
+ */
+ZeroMQ<void*>::ZeroMQ(const ZeroMQ<void*>& server, const unsigned int clientId) :
+mId(server.mId), mBinding(
+server.mBinding), mOwnsContext(false), mContext(server.mContext), mSocket(
+NULL), mRouting(server.mRouting), mClientId(clientId), mLock(NULL) {
 
 }
 
@@ -64,11 +81,30 @@ NULL) {
  */
 ZeroMQ<void*>::~ZeroMQ() {
    //LOG(DEBUG) << "deconstructor ZeroMQ<void*> ";
-   boost::recursive_mutex::scoped_lock lock(mMutex);
+   auto lock = Lock();
    CloseSocket();
    CloseContext();
 }
 
+/**
+ * Share this side of the queue between threads, must be called before the
+ * other threads use it.
+ *
+ * @param lock
+ *   Held around every socket operation, NULL for no locking
+ */
+void ZeroMQ<void*>::SetExternalLock(std::mutex* lock) {
+   mLock = lock;
+}
+
+/**
+ * @return
+ *   the external lock, held, or no lock at all
+ */
+std::unique_lock<std::mutex> ZeroMQ<void*>::Lock() {
+   return mLock ? std::unique_lock<std::mutex>(*mLock) : std::unique_lock<std::mutex>();
+}
+
 /**
  * Clean up the socket
  */
@@ -103,6 +139,7 @@ void ZeroMQ<void*>::CloseContext() {
  *   false is something goes wrong, if a client has no context
  */
 bool ZeroMQ<void*>::Initialize() {
+   auto lock = Lock();
    if (mOwnsContext) {
       mContext = GetContext();
       mSocket = GetSocket(mContext);
@@ -150,7 +187,11 @@ int ZeroMQ<void*>::GetHighWater() {
 void* ZeroMQ<void*>::GetSocket(void* context) {
    void* socket = NULL;
    if (context != NULL) {
-      socket = zmq_socket(context, ZMQ_PAIR); //TODO switch to PUSH if there are issues in the library with PAIR
+      int type = ZMQ_PAIR; //TODO switch to PUSH if there are issues in the library with PAIR
+      if (mRouting) {
+         type = mOwnsContext ? ZMQ_ROUTER : ZMQ_DEALER;
+      }
+      socket = zmq_socket(context, type);
       if (!SetSendHWM(socket, GetHighWater()) || !SetReceiveHWM(socket, GetHighWater())) {
          zmq_close(socket);
          socket = NULL;
@@ -172,6 +213,13 @@ void ZeroMQ<void*>::ServerSetup(const std::string& binding,
    if (socket == NULL) {
       return;
    }
+   // fail instead of silently dropping pointers to unknown clients
+   const int mandatory = 1;
+   if (mRouting && zmq_setsockopt(socket, ZMQ_ROUTER_MANDATORY, &mandatory, sizeof (mandatory)) != 0) {
+      zmq_close(socket);
+      socket = NULL;
+      return;
+   }
    if (zmq_bind(socket, binding.c_str()) != 0) {
       zmq_close(socket);
       socket = NULL;
@@ -190,6 +238,12 @@ void ZeroMQ<void*>::ClientSetup(const std::string& binding,
    if (socket == NULL) {
       return;
    }
+   const std::string identity = std::to_string(mClientId);
+   if (mRouting && zmq_setsockopt(socket, ZMQ_IDENTITY, identity.data(), identity.size()) != 0) {
+      zmq_close(socket);
+      socket = NULL;
+      return;
+   }
    if (zmq_connect(socket, binding.c_str()) != 0) {
       zmq_close(socket);
       socket = NULL;
@@ -209,6 +263,7 @@ bool ZeroMQ<void*>::WaitForClient(int microseconds) {
    if (!mOwnsContext) {
       return false;
    }
+   auto lock = Lock();
    zmq_msg_t msg;
    if (!InitializeMsg(msg)) {
       return false;
@@ -274,11 +329,14 @@ bool ZeroMQ<void*>::SendClientReady() {
          return false;
       }
    }
+   auto lock = Lock();
    zmq_msg_t msg;
    if (!InitializeMsg(msg)) {
       return false;
    }
-   if (PollForSendSocketReady(-1) < 0) {
+   // a routing client registers without waiting, the server picks it up
+   // with AcceptClients
+   if (!mRouting && PollForSendSocketReady(-1) < 0) {
       return false;
    }
    bool result = (zmq_sendmsg(mSocket, &msg, ZMQ_DONTWAIT) >= 0);
@@ -298,6 +356,7 @@ void* ZeroMQ<void*>::GetPointer(long timeout) {
    if (mOwnsContext) {
       return NULL;
    }
+   auto lock = Lock();
    zmq_msg_t msg;
    if (!InitializeMsg(msg)) {
       return NULL;
@@ -332,6 +391,11 @@ bool ZeroMQ<void*>::SendPointer(void* packet) {
    if (!mOwnsContext) {
       return false;
    }
+   if (mRouting) {
+      LOG(WARNING) << "A routing queue sends with SendPointerTo or SendPointerByHash " << mBinding;
+      return false;
+   }
+   auto lock = Lock();
    zmq_msg_t msg;
    zmq_msg_init_size(&msg, sizeof (void*));
    memcpy(zmq_msg_data(&msg), &packet, sizeof (void*));
@@ -344,6 +408,225 @@ bool ZeroMQ<void*>::SendPointer(void* packet) {
    return result;
 }
 
+/**
+ * Get as many pointers as are queued, up to count, without a message
+ * object or a poll per pointer
+ *
+ * @param packets
+ *   Room for count pointers
+ * @param count
+ * @param timeout
+ *   Timeout in ms to wait for the first pointer
+ * @return
+ *   the number of pointers received
+ */
+size_t ZeroMQ<void*>::GetPointers(void** packets, const size_t count, long timeout) {
+   if (mOwnsContext || mSocket == NULL) {
+      return 0;
+   }
+   auto lock = Lock();
+   size_t received = 0;
+   bool polled = false;
+   while (received < count) {
+      const int bytes = zmq_recv(mSocket, &packets[received], sizeof (void*), ZMQ_DONTWAIT);
+      if (bytes == sizeof (void*)) {
+         received++;
+      } else if (bytes >= 0) {
+         LOG(WARNING) << "Dropped a message of " << bytes << " bytes on " << mBinding;
+      } else if (zmq_errno() == EAGAIN && received == 0 && !polled) {
+         polled = true;
+         if (PollForReceiveSocketReady(timeout) <= 0) {
+            break;
+         }
+      } else {
+         break;
+      }
+   }
+   return received;
+}
+
+/**
+ * Send pointers until count are sent or the high water mark is reached
+ *
+ * @param packets
+ * @param count
+ * @return
+ *   the number of pointers sent, the rest are still owned by the caller
+ */
+size_t ZeroMQ<void*>::SendPointers(void* const* packets, const size_t count) {
+   if (!mOwnsContext || mRouting || mSocket == NULL) {
+      return 0;
+   }
+   auto lock = Lock();
+   size_t sent = 0;
+   while (sent < count && zmq_send(mSocket, &packets[sent], sizeof (void*), ZMQ_DONTWAIT) == sizeof (void*)) {
+      sent++;
+   }
+   return sent;
+}
+
+/**
+ * Route pointers to clients by id, must be called on the server before
+ * Initialize and before clients are copied from it.
+ *
+ * @param routing
+ */
+void ZeroMQ<void*>::SetRouting(const bool routing) {
+   mRouting = routing;
+}
+
+/**
+ * Register the clients that sent SendClientReady since the last call,
+ * without waiting.
+ *
+ * @return
+ *   the number of clients registered now
+ */
+size_t ZeroMQ<void*>::AcceptClients() {
+   if (!mOwnsContext || !mRouting || mSocket == NULL) {
+      return 0;
+   }
+   auto lock = Lock();
+   return Accept();
+}
+
+/**
+ * AcceptClients with the lock held
+ */
+size_t ZeroMQ<void*>::Accept() {
+   char identity[256];
+   int bytes;
+   while ((bytes = zmq_recv(mSocket, identity, sizeof (identity), ZMQ_DONTWAIT)) >= 0) {
+      const std::string client(identity, std::min<size_t>(bytes, sizeof (identity)));
+      int more = 0;
+      size_t moreSize = sizeof (more);
+      while (zmq_getsockopt(mSocket, ZMQ_RCVMORE, &more, &moreSize) == 0 && more) {
+         zmq_recv(mSocket, identity, sizeof (identity), ZMQ_DONTWAIT);
+      }
+      char* end = NULL;
+      const unsigned long id = strtoul(client.c_str(), &end, 10);
+      if (client.empty() || *end != '\0') {
+         LOG(WARNING) << "Ignored a client without an id on " << mBinding;
+         continue;
+      }
+      auto position = std::lower_bound(mClients.begin(), mClients.end(), id);
+      if (position == mClients.end() || *position != id) {
+         mIdentities.insert(mIdentities.begin() + (position - mClients.begin()), client);
+         mClients.insert(position, id);
+         for (size_t replica = 0; replica < HashRing::kPointsPerTarget; ++replica) {
+            mRing.insert(std::make_pair(HashRing::Point(client, replica), client));
+         }
+      }
+   }
+   return mClients.size();
+}
+
+/**
+ * Stop sending pointers by hash to a client, i.e. one that exits. Its
+ * flows move to the other clients, it is registered again by its next
+ * SendClientReady.
+ *
+ * @param clientId
+ * @return
+ *   false if the client was not registered
+ */
+bool ZeroMQ<void*>::RemoveClient(const unsigned int clientId) {
+   auto lock = Lock();
+   if (!std::binary_search(mClients.begin(), mClients.end(), clientId)) {
+      return false;
+   }
+   Forget(std::to_string(clientId));
+   return true;
+}
+
+/**
+ * Unregister a client, with the lock held
+ *
+ * @param identity
+ */
+void ZeroMQ<void*>::Forget(const std::string& identity) {
+   auto found = std::find(mIdentities.begin(), mIdentities.end(), identity);
+   if (found == mIdentities.end()) {
+      return;
+   }
+   mClients.erase(mClients.begin() + (found - mIdentities.begin()));
+   mIdentities.erase(found);
+   for (auto point = mRing.begin(); point != mRing.end();) {
+      if (point->second == identity) {
+         point = mRing.erase(point);
+      } else {
+         ++point;
+      }
+   }
+}
+
+/**
+ * @return
+ *   the ids of the registered clients, in order
+ */
+std::vector<unsigned int> ZeroMQ<void*>::GetClients() const {
+   return mClients;
+}
+
+/**
+ * Send a void* pointer to one client, it does not have to be registered
+ *
+ * @return
+ *   false if the client is not connected or its queue is full
+ */
+bool ZeroMQ<void*>::SendPointerTo(const unsigned int clientId, void* packet) {
+   if (!mOwnsContext || !mRouting) {
+      return false;
+   }
+   auto lock = Lock();
+   return Route(std::to_string(clientId), packet);
+}
+
+/**
+ * Send a void* pointer to the registered client picked by the hash on the
+ * ring, the same hash goes to the same client while it is registered. A
+ * client that went away is unregistered and the pointer goes to the client
+ * that takes over its flows.
+ *
+ * @param hash
+ *   i.e. of the flow the packet belongs to
+ * @return
+ *   false if no client is registered or its queue is full
+ */
+bool ZeroMQ<void*>::SendPointerByHash(const uint64_t hash, void* packet) {
+   if (!mOwnsContext || !mRouting || mSocket == NULL) {
+      return false;
+   }
+   auto lock = Lock();
+   if (mClients.empty() && Accept() == 0) {
+      return false;
+   }
+   const uint64_t key = HashRing::Mix(hash);
+   while (!mRing.empty()) {
+      auto point = mRing.lower_bound(key);
+      const std::string identity = (point == mRing.end() ? mRing.begin() : point)->second;
+      if (Route(identity, packet)) {
+         return true;
+      }
+      if (zmq_errno() != EHOSTUNREACH) {
+         return false;
+      }
+      LOG(WARNING) << "Client " << identity << " of " << mBinding << " went away";
+      Forget(identity);
+   }
+   return false;
+}
+
+/**
+ * Send the identity of the client and the pointer, routers never block
+ */
+bool ZeroMQ<void*>::Route(const std::string& identity, void* packet) {
+   if (zmq_send(mSocket, identity.data(), identity.size(), ZMQ_SNDMORE | ZMQ_DONTWAIT) < 0) {
+      return false;
+   }
+   return zmq_send(mSocket, &packet, sizeof (void*), ZMQ_DONTWAIT) == sizeof (void*);
+}
+
 /**
  * Set the Receive side high water mark for a socket
  *
@@ -3,7 +3,9 @@
 #include <zmq.h>
 #include <zlib.h>
 #include <map>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "IComponentQueue.h"
 #include <boost/thread.hpp>
 
@@ -17,12 +19,30 @@ public:
 
 };
 
+/**
+ * Zero copy queue of pointers between two threads, over an inproc PAIR.
+ *
+ * The server sends and the client receives, each from one thread at a time,
+ * so nothing is locked by default. When a side has to be shared between
+ * threads give it a lock with SetExternalLock, it is held around every
+ * socket operation.
+ *
+ * With SetRouting one server feeds many clients: every client is made with
+ * its own client id and registers with SendClientReady, which never blocks.
+ * The server sends to a client id with SendPointerTo, or spreads flows over
+ * the registered clients with SendPointerByHash so a flow always lands on
+ * the same client. The clients are placed on a consistent hash ring like the
+ * Vampires of a Crossbow: a client registering or going away only moves its
+ * share of the flows. A client that went away is dropped when a send to it
+ * fails, or with RemoveClient.
+ */
 template<>
-class ZeroMQ<void*> : public IComponentQueue {
+class ZeroMQ<void*> {
 public:
    explicit ZeroMQ(const unsigned int id);
    ZeroMQ(const ZeroMQ<void*>& that);
    ZeroMQ(const ZeroMQ<void*>* that);
+   ZeroMQ(const ZeroMQ<void*>& server, const unsigned int clientId);
    virtual ~ZeroMQ();
 
    bool Initialize();
@@ -31,6 +51,16 @@ public:
    bool SendClientReady();
    void* GetPointer(long timeout);
    bool SendPointer(void* packet);
+   size_t GetPointers(void** packets, const size_t count, long timeout);
+   size_t SendPointers(void* const* packets, const size_t count);
+   void SetExternalLock(std::mutex* lock);
+
+   void SetRouting(const bool routing);
+   size_t AcceptClients();
+   std::vector<unsigned int> GetClients() const;
+   bool RemoveClient(const unsigned int clientId);
+   bool SendPointerTo(const unsigned int clientId, void* packet);
+   bool SendPointerByHash(const uint64_t hash, void* packet);
 protected:
    virtual void* GetContext();
    virtual void* GetSocket(void* context);
@@ -47,10 +77,23 @@ protected:
    const bool mOwnsContext;
    void* mContext;
    void* mSocket;
+   bool mRouting;
+   unsigned int mClientId;
 private:
    
    int PollForSendSocketReady(long timeout);
    int PollForReceiveSocketReady(long timeout);
+   std::unique_lock<std::mutex> Lock();
+   size_t Accept();
+   void Forget(const std::string& identity);
+   bool Route(const std::string& identity, void* packet);
+
+   std::mutex* mLock;
+   // registered clients sorted by id, with their socket identities
+   std::vector<unsigned int> mClients;
+   std::vector<std::string> mIdentities;
+   // points of the registered clients on the hash ring
+   std::map<uint64_t, std::string> mRing;
 };
 
 #define ZeroMQ_HEADER_SIZE 0
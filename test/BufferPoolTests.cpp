@@ -0,0 +1,163 @@
+#include <unistd.h>
+#include <cstring>
+#include <future>
+#include <set>
+#include <thread>
+#include <vector>
+#include "BufferPoolTests.h"
+#include "BufferPool.h"
+#include "StakeArena.h"
+#include "Rifle.h"
+#include "Vampire.h"
+#include "StopWatch.h"
+
+TEST_F(BufferPoolTests, AcquireUntilExhausted) {
+   BufferPool pool(100, 4);
+   EXPECT_EQ(100, pool.BufferSize());
+   EXPECT_EQ(4, pool.BufferCount());
+   EXPECT_EQ(4, pool.Available());
+
+   std::set<char*> buffers;
+   for (size_t i = 0; i < 4; i++) {
+      char* buffer = pool.Acquire();
+      ASSERT_NE(nullptr, buffer);
+      EXPECT_TRUE(pool.Owns(buffer));
+      // every buffer is usable in full without touching its neighbours
+      memset(buffer, 'a' + i, pool.BufferSize());
+      buffers.insert(buffer);
+   }
+   EXPECT_EQ(4, buffers.size());
+   EXPECT_EQ(0, pool.Available());
+   EXPECT_EQ(nullptr, pool.Acquire());
+
+   char notPooled[100];
+   EXPECT_FALSE(pool.Owns(notPooled));
+   pool.Release(notPooled);
+   EXPECT_FALSE(pool.Owns(*buffers.begin() + 1));
+   EXPECT_EQ(0, pool.Available());
+
+   for (auto buffer : buffers) {
+      pool.Release(buffer);
+   }
+   EXPECT_EQ(4, pool.Available());
+}
+
+TEST_F(BufferPoolTests, ManyThreadsNeverShareABuffer) {
+   const size_t threadCount = 8;
+   const size_t rounds = 100000;
+   BufferPool pool(sizeof (size_t), threadCount * 2);
+   std::vector<std::thread> threads;
+   std::atomic<size_t> corrupted(0);
+   for (size_t id = 0; id < threadCount; id++) {
+      threads.emplace_back([&pool, &corrupted, id, rounds] {
+         for (size_t round = 0; round < rounds; round++) {
+            char* buffer = pool.Acquire();
+            if (!buffer) {
+               continue;
+            }
+            memcpy(buffer, &id, sizeof (id));
+            std::this_thread::yield();
+            size_t owner;
+            memcpy(&owner, buffer, sizeof (owner));
+            if (owner != id) {
+               corrupted++;
+            }
+            pool.Release(buffer);
+         }
+      });
+   }
+   for (auto& thread : threads) {
+      thread.join();
+   }
+   EXPECT_EQ(0, corrupted);
+   EXPECT_EQ(threadCount * 2, pool.Available());
+}
+
+TEST_F(BufferPoolTests, FiredBuffersReturnToThePool) {
+   std::string location("ipc:///tmp/BufferPoolTests");
+   location.append(std::to_string(getpid()));
+   BufferPool pool(64, 8);
+   {
+      Rifle rifle(location);
+      Vampire vampire(location);
+      ASSERT_TRUE(rifle.Aim());
+      ASSERT_TRUE(vampire.PrepareToBeShot());
+
+      for (size_t shot = 0; shot < 100; shot++) {
+         char* buffer = nullptr;
+         StopWatch timer;
+         while (!(buffer = pool.Acquire()) && timer.ElapsedSec() < 5) {
+            std::this_thread::yield();
+         }
+         ASSERT_NE(nullptr, buffer);
+         const std::string bullet = "shot #" + std::to_string(shot);
+         memcpy(buffer, bullet.data(), bullet.size());
+         ASSERT_TRUE(rifle.FireZeroCopy(buffer, bullet.size(), BufferPool::Free, &pool));
+         std::string wound;
+         ASSERT_TRUE(vampire.GetShot(wound, 1000));
+         EXPECT_EQ(bullet, wound);
+      }
+   }
+   EXPECT_EQ(8, pool.Available());
+}
+
+TEST_F(BufferPoolTests, StakesFromTheArenaAreRecycledByTheVampire) {
+   std::string location("ipc:///tmp/StakeArenaTests");
+   location.append(std::to_string(getpid()));
+   const size_t stakes = 16;
+   StakeArena arena(1500, stakes);
+   ASSERT_EQ(stakes, arena.BufferCount());
+   Rifle rifle(location);
+   Vampire vampire(location);
+   vampire.SetStakeArena(&arena);
+   ASSERT_TRUE(rifle.Aim());
+   EXPECT_EQ(-1, arena.Node());
+
+   const size_t shots = 1000;
+   std::atomic<size_t> received(0);
+   // the consumer prepares the Vampire, which warms the arena on its node
+   // before any stake is fired
+   std::promise<bool> prepared;
+   std::thread consumer([&] {
+      const bool ready = vampire.PrepareToBeShot();
+      prepared.set_value(ready);
+      if (!ready) {
+         return;
+      }
+      StopWatch timer;
+      for (size_t shot = 0; shot < shots && timer.ElapsedSec() < 10;) {
+         void* stake = nullptr;
+         if (vampire.GetStake(stake, 100)) {
+            size_t sequence;
+            memcpy(&sequence, stake, sizeof (sequence));
+            EXPECT_EQ(shot, sequence);
+            arena.Release(stake);
+            received++;
+            shot++;
+         }
+      }
+   });
+
+   const bool ready = prepared.get_future().get();
+   EXPECT_TRUE(ready);
+   EXPECT_LE(0, arena.Node());
+   for (size_t shot = 0; ready && shot < shots; shot++) {
+      char* stake = nullptr;
+      StopWatch timer;
+      while (!(stake = arena.Acquire()) && timer.ElapsedSec() < 5) {
+         std::this_thread::yield();
+      }
+      if (!stake) {
+         ADD_FAILURE() << "no stake was released in time for #" << shot;
+         break;
+      }
+      memcpy(stake, &shot, sizeof (shot));
+      if (!rifle.FireStake(stake)) {
+         ADD_FAILURE() << "could not fire stake #" << shot;
+         break;
+      }
+   }
+   consumer.join();
+   EXPECT_EQ(shots, received);
+   EXPECT_EQ(stakes, arena.Available());
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <czmq.h>
+
+class BufferPoolTests : public ::testing::Test {
+public:
+
+   BufferPoolTests() {
+   };
+
+protected:
+
+   virtual void SetUp() {
+      zctx_interrupted = false;
+   }
+
+   virtual void TearDown() {
+      zctx_interrupted = false;
+   }
+};
@@ -0,0 +1,155 @@
+#include <unistd.h>
+#include <map>
+#include <memory>
+#include "CrossbowTests.h"
+#include "Crossbow.h"
+#include "Vampire.h"
+
+std::string CrossbowTests::GetIpcLocation(const std::string& name) {
+   std::string ipcLocation("ipc:///tmp/CrossbowTests");
+   ipcLocation.append(name);
+   ipcLocation.append(std::to_string(getpid()));
+   ipcLocation.append(".ipc");
+   return ipcLocation;
+}
+
+TEST_F(CrossbowTests, EveryKeyReachesItsVampire) {
+   std::map<std::string, std::unique_ptr<Vampire> > vampires;
+   Crossbow crossbow;
+   EXPECT_FALSE(crossbow.Fire(1, "no targets"));
+   EXPECT_TRUE(crossbow.Target(1).empty());
+   for (const std::string name : {"first", "second", "third"}) {
+      const std::string location = GetIpcLocation(name);
+      vampires[location].reset(new Vampire(location));
+      vampires[location]->SetOwnSocket(true);
+      ASSERT_TRUE(vampires[location]->PrepareToBeShot());
+      ASSERT_TRUE(crossbow.AddTarget(location, false));
+   }
+   EXPECT_FALSE(crossbow.AddTarget(GetIpcLocation("first"), false));
+   EXPECT_EQ(3, crossbow.Targets());
+
+   const uint64_t kKeys = 300;
+   std::map<std::string, size_t> expected;
+   for (uint64_t key = 0; key < kKeys; ++key) {
+      ASSERT_TRUE(crossbow.Fire(key, std::to_string(key)));
+      expected[crossbow.Target(key)]++;
+   }
+   for (auto& vampire : vampires) {
+      // no target is starved
+      EXPECT_LT(kKeys / 10, expected[vampire.first]);
+      std::string shot;
+      size_t shots = 0;
+      while (vampire.second->GetShot(shot, 100)) {
+         EXPECT_EQ(vampire.first, crossbow.Target(std::stoull(shot)));
+         shots++;
+      }
+      EXPECT_EQ(expected[vampire.first], shots);
+   }
+}
+
+TEST_F(CrossbowTests, FewKeysMoveWhenTargetsComeAndGo) {
+   Crossbow crossbow;
+   for (const std::string name : {"a", "b", "c", "d"}) {
+      ASSERT_TRUE(crossbow.AddTarget(GetIpcLocation(name)));
+   }
+   const uint64_t kKeys = 10000;
+   std::vector<std::string> before;
+   for (uint64_t key = 0; key < kKeys; ++key) {
+      before.push_back(crossbow.Target(key));
+   }
+
+   ASSERT_TRUE(crossbow.AddTarget(GetIpcLocation("e")));
+   size_t moved = 0;
+   for (uint64_t key = 0; key < kKeys; ++key) {
+      const std::string after = crossbow.Target(key);
+      if (after != before[key]) {
+         // keys only move to the new target
+         EXPECT_EQ(GetIpcLocation("e"), after);
+         moved++;
+      }
+   }
+   EXPECT_LT(kKeys / 10, moved);
+   EXPECT_GT(kKeys * 3 / 10, moved);
+
+   ASSERT_TRUE(crossbow.RemoveTarget(GetIpcLocation("e")));
+   ASSERT_TRUE(crossbow.RemoveTarget(GetIpcLocation("b")));
+   EXPECT_FALSE(crossbow.RemoveTarget(GetIpcLocation("b")));
+   for (uint64_t key = 0; key < kKeys; ++key) {
+      // only the keys of the removed target move
+      if (before[key] != GetIpcLocation("b")) {
+         EXPECT_EQ(before[key], crossbow.Target(key));
+      } else {
+         EXPECT_NE(before[key], crossbow.Target(key));
+      }
+   }
+}
+
+TEST_F(CrossbowTests, StakesAreBundledPerVampire) {
+   std::map<std::string, std::unique_ptr<Vampire> > vampires;
+   Crossbow crossbow;
+   for (const std::string name : {"left", "right"}) {
+      const std::string location = GetIpcLocation(name);
+      vampires[location].reset(new Vampire(location));
+      vampires[location]->SetOwnSocket(true);
+      ASSERT_TRUE(vampires[location]->PrepareToBeShot());
+      ASSERT_TRUE(crossbow.AddTarget(location, false));
+   }
+   int values[100];
+   std::vector<std::pair<void*, unsigned int> > stakes;
+   for (unsigned int i = 0; i < 100; ++i) {
+      stakes.push_back(std::make_pair(&values[i], i));
+   }
+   std::vector<std::pair<void*, unsigned int> > unsent;
+   ASSERT_TRUE(crossbow.FireStakes(stakes, unsent));
+   EXPECT_TRUE(unsent.empty());
+
+   size_t received = 0;
+   for (auto& vampire : vampires) {
+      std::vector<std::pair<void*, unsigned int> > bundle;
+      ASSERT_TRUE(vampire.second->GetStakes(bundle, 1000));
+      for (const auto& stake : bundle) {
+         EXPECT_EQ(vampire.first, crossbow.Target(stake.second));
+         EXPECT_EQ(&values[stake.second], stake.first);
+      }
+      received += bundle.size();
+      EXPECT_FALSE(vampire.second->GetStakes(bundle, 0));
+   }
+   EXPECT_EQ(stakes.size(), received);
+}
+
+TEST_F(CrossbowTests, StakesThatCouldNotBeFiredAreHandedBack) {
+   const std::string present = GetIpcLocation("present");
+   const std::string absent = GetIpcLocation("absent");
+   Vampire vampire(present);
+   vampire.SetOwnSocket(true);
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   Crossbow crossbow;
+   ASSERT_TRUE(crossbow.AddTarget(present, false));
+   // bound by its Rifle, nobody ever connects to it
+   ASSERT_TRUE(crossbow.AddTarget(absent, true));
+
+   int values[100];
+   std::vector<std::pair<void*, unsigned int> > stakes;
+   for (unsigned int i = 0; i < 100; ++i) {
+      stakes.push_back(std::make_pair(&values[i], i));
+   }
+   std::vector<std::pair<void*, unsigned int> > unsent;
+   EXPECT_FALSE(crossbow.FireStakes(stakes, unsent, 10));
+   ASSERT_FALSE(unsent.empty());
+   for (const auto& stake : unsent) {
+      EXPECT_EQ(absent, crossbow.Target(stake.second));
+      EXPECT_EQ(&values[stake.second], stake.first);
+   }
+
+   std::vector<std::pair<void*, unsigned int> > bundle;
+   ASSERT_TRUE(vampire.GetStakes(bundle, 1000));
+   for (const auto& stake : bundle) {
+      EXPECT_EQ(present, crossbow.Target(stake.second));
+   }
+   EXPECT_EQ(stakes.size(), bundle.size() + unsent.size());
+
+   EXPECT_TRUE(crossbow.RemoveTarget(absent));
+   EXPECT_TRUE(crossbow.RemoveTarget(present));
+   EXPECT_FALSE(crossbow.FireStakes(stakes, unsent, 10));
+   EXPECT_EQ(stakes.size(), unsent.size());
+}
@@ -1,6 +1,8 @@
 
 #include <czmq.h>
 #include <boost/thread.hpp>
+#include <chrono>
+#include <memory>
 
 #include "CrowbarHeadcrabTests.h"
 #include "Death.h"
@@ -14,6 +16,51 @@ TEST_F(CrowbarHeadcrabTests, CrowbarBrokenSocket) {
    EXPECT_FALSE(firstCrowbar.Swing("foo"));
 
 }
+TEST_F(CrowbarHeadcrabTests, CrowbarWieldedBeforeHeadcrabLives) {
+   Crowbar stick(mTarget);
+   stick.SetReconnectInterval(10, 100);
+   stick.MonitorConnection(true);
+
+   auto start = std::chrono::steady_clock::now();
+   ASSERT_TRUE(stick.Wield());
+   auto wieldMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+   EXPECT_LT(wieldMs, 1000) << "Wield should not wait for the Headcrab";
+   EXPECT_FALSE(stick.IsConnected(10));
+
+   Headcrab target(mTarget);
+   ASSERT_TRUE(target.ComeToLife());
+   ASSERT_TRUE(stick.IsConnected(5000));
+
+   std::string wound;
+   ASSERT_TRUE(stick.Swing("abc123"));
+   ASSERT_TRUE(target.GetHitWait(wound, 1000));
+   ASSERT_TRUE(target.SendSplatter(wound));
+   std::string gut;
+   ASSERT_TRUE(stick.WaitForKill(gut, 1000));
+   EXPECT_EQ("abc123", gut);
+}
+
+TEST_F(CrowbarHeadcrabTests, CrowbarWithoutMonitorIsNeverConnected) {
+   Headcrab target(mTarget);
+   ASSERT_TRUE(target.ComeToLife());
+   Crowbar stick(mTarget);
+   ASSERT_TRUE(stick.Wield());
+   EXPECT_FALSE(stick.IsConnected(10));
+}
+
+TEST_F(CrowbarHeadcrabTests, MonitoredCrowbarsComeAndGoOnAHeadcrabContext) {
+   Headcrab target(mTarget);
+   ASSERT_TRUE(target.ComeToLife());
+   for (int i = 0; i < 3; ++i) {
+      // a crowbar often gets the address of the last one, and with it the
+      // name of its inproc monitor endpoint
+      std::unique_ptr<Crowbar> stick(new Crowbar(target));
+      stick->MonitorConnection(true);
+      ASSERT_TRUE(stick->Wield());
+      EXPECT_TRUE(stick->IsConnected(5000));
+   }
+}
+
 TEST_F(CrowbarHeadcrabTests, ipcFilesCleanedOnNormalExit) {
    std::string addressRealPath(mTarget,mTarget.find("ipc://")+6);
    {
@@ -316,6 +363,148 @@ TEST_F(CrowbarHeadcrabTests, SmashAHeadcrabTCP) {
 
 }
 
+TEST_F(CrowbarHeadcrabTests, SmashAHeadcrabNest) {
+   const size_t workers = 4;
+   HeadcrabNest nest(mTarget, workers);
+   EXPECT_EQ(mTarget, nest.GetBinding());
+   EXPECT_EQ(workers, nest.GetWorkerCount());
+   ASSERT_TRUE(nest.ComeToLife([](const std::vector<std::string>& hits, std::vector<std::string>& splatter) {
+      splatter = hits;
+      splatter.push_back("splat");
+      return true;
+   }));
+
+   const int numberOfCrowbars = 3;
+   const int hitsPerCrowbar = 10;
+   std::vector<std::unique_ptr<Crowbar>> crowbars;
+   for (int i = 0; i < numberOfCrowbars; i++) {
+      crowbars.emplace_back(new Crowbar(mTarget));
+      ASSERT_TRUE(crowbars.back()->Wield());
+   }
+   for (int i = 0; i < hitsPerCrowbar; i++) {
+      for (auto& crowbar : crowbars) {
+         std::string expected("abc123");
+         expected.append(std::to_string(i));
+         ASSERT_TRUE(crowbar->Swing(expected));
+         std::vector<std::string> guts;
+         ASSERT_TRUE(crowbar->WaitForKill(guts, 1000));
+         ASSERT_EQ(2, guts.size());
+         EXPECT_EQ(expected, guts[0]);
+         EXPECT_EQ("splat", guts[1]);
+      }
+   }
+
+   // a worker counts a request after its reply went out, wait for the last
+   const uint64_t total = numberOfCrowbars * hitsPerCrowbar;
+   const size_t hitBytes = std::string("abc123").size() + 1;
+   const size_t splatterBytes = hitBytes + std::string("splat").size();
+   std::vector<HeadcrabNest::WorkerStats> stats;
+   uint64_t requests = 0;
+   uint64_t bytesOut = 0;
+   for (int i = 0; i < 1000 && (requests != total || bytesOut != total * splatterBytes); i++) {
+      if (i > 0) {
+         zclock_sleep(1);
+      }
+      stats = nest.GetWorkerStats();
+      requests = 0;
+      bytesOut = 0;
+      for (const auto& worker : stats) {
+         requests += worker.requests;
+         bytesOut += worker.bytesOut;
+      }
+   }
+   ASSERT_EQ(workers, stats.size());
+   EXPECT_EQ(total, requests);
+
+   // the nest spread the requests, every worker accounts for what it served
+   size_t served = 0;
+   for (const auto& worker : stats) {
+      EXPECT_EQ(0, worker.failures);
+      EXPECT_EQ(worker.requests * hitBytes, worker.bytesIn);
+      EXPECT_EQ(worker.requests * splatterBytes, worker.bytesOut);
+      if (worker.requests > 0) {
+         served++;
+      }
+   }
+   EXPECT_LT(1, served);
+}
+
+TEST_F(CrowbarHeadcrabTests, SmashAHeadcrabReusingBuffers) {
+   mTarget = "inproc://headcrabrecycler";
+   Headcrab target(mTarget);
+   ASSERT_TRUE(target.ComeToLife());
+   Crowbar shooter(target);
+   ASSERT_TRUE(shooter.Wield());
+
+   std::vector<std::string> data;
+   data.push_back(std::string(100, 'a'));
+   data.push_back(std::string(200, 'b'));
+   std::vector<std::string> wounds;
+   std::vector<const char*> buffers;
+   for (int i = 0; i < 10; i++) {
+      ASSERT_TRUE(shooter.Flurry(data));
+      ASSERT_TRUE(target.GetHitBlock(wounds));
+      ASSERT_EQ(data, wounds);
+      if (buffers.empty()) {
+         buffers = {wounds[0].data(), wounds[1].data()};
+      }
+      // the same strings are filled in place, nothing was reallocated
+      EXPECT_EQ(buffers[0], wounds[0].data());
+      EXPECT_EQ(buffers[1], wounds[1].data());
+
+      std::vector<std::string> splatter = wounds;
+      ASSERT_TRUE(target.SendSplatter(std::move(splatter)));
+      std::vector<std::string> guts;
+      ASSERT_TRUE(shooter.BlockForKill(guts));
+      ASSERT_EQ(data, guts);
+   }
+
+   std::string wound;
+   ASSERT_TRUE(shooter.Swing("one frame"));
+   ASSERT_TRUE(target.GetHitBlock(wound));
+   EXPECT_EQ("one frame", wound);
+   ASSERT_TRUE(target.SendSplatter(wound));
+   std::string gut;
+   ASSERT_TRUE(shooter.BlockForKill(gut));
+   EXPECT_EQ("one frame", gut);
+}
+
+/**
+ * Microbenchmark of the Headcrab receive/reply path. Reports the round trips per
+ * second and how often the receive buffers had to be reallocated per request,
+ * which should be zero in steady state.
+ */
+TEST_F(CrowbarHeadcrabTests, DISABLED_HeadcrabRecycledBuffersSpeedTest) {
+   mTarget = "inproc://headcrabbenchmark";
+   Headcrab target(mTarget);
+   ASSERT_TRUE(target.ComeToLife());
+   Crowbar shooter(target);
+   ASSERT_TRUE(shooter.Wield());
+
+   std::vector<std::string> data(2, std::string(500, 'a'));
+   std::vector<std::string> wounds;
+   std::vector<std::string> guts;
+   const std::string ack("ok");
+   const char* lastBuffer = nullptr;
+   size_t reallocations = 0;
+   const int numberOfHits = PACKETS_TO_TEST / 10;
+   SetExpectedTime(numberOfHits, data.size() * data[0].size(), 20, 10000L);
+   StartTimedSection();
+   for (int i = 0; i < numberOfHits; i++) {
+      ASSERT_TRUE(shooter.Flurry(data));
+      ASSERT_TRUE(target.GetHitBlock(wounds));
+      if (lastBuffer != wounds[0].data()) {
+         reallocations++;
+         lastBuffer = wounds[0].data();
+      }
+      ASSERT_TRUE(target.SendSplatter(ack));
+      ASSERT_TRUE(shooter.BlockForKill(guts));
+   }
+   EndTimedSection();
+   std::cout << "Receive buffer reallocations per request: "
+           << (reallocations * 1.0) / numberOfHits << std::endl;
+}
+
 void CrowbarHeadcrabTests::Sender(std::string& baseData, int numberOfHits, std::string& binding) {
    Crowbar shooter(binding);
    assert(shooter.Wield());
@@ -13,6 +13,7 @@
 #include <string>
 #include <set>
 #include "Headcrab.h"
+#include "HeadcrabNest.h"
 #include "Crowbar.h"
 #include "ZeroMQTests.h"
 #include <czmq.h>
@@ -0,0 +1,184 @@
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "DpiMsgLRZMQTests.h"
+#include "SendDpiMsgLRZMQ.h"
+#include "ReceiveDpiMsgLRZMQ.h"
+#include "StopWatch.h"
+
+namespace {
+   std::string Record(const size_t index) {
+      return std::string(1 + index % 200, 'a' + index % 26);
+   }
+
+   int64_t NowUs() {
+      using namespace std::chrono;
+      return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+   }
+}
+
+std::string DpiMsgLRZMQTests::GetIpcLocation(const std::string& name) {
+   std::string ipcLocation("ipc:///tmp/DpiMsgLRZMQTests");
+   ipcLocation.append(name);
+   ipcLocation.append(std::to_string(getpid()));
+   ipcLocation.append(".ipc");
+   return ipcLocation;
+}
+
+TEST_F(DpiMsgLRZMQTests, CoalescedRecordsArriveInOrder) {
+   const std::string location = GetIpcLocation("order");
+   SendDpiMsgLRZMQ sender(location);
+   ReceiveDpiMsgLRZMQ receiver(location);
+   sender.SetCoalescing(1024, 1000);
+   receiver.SetCoalescing(true);
+   ASSERT_TRUE(sender.Initialize());
+   ASSERT_TRUE(receiver.Initialize());
+
+   const size_t kRecords = 100;
+   for (size_t i = 0; i < kRecords; ++i) {
+      ASSERT_TRUE(sender.SendData(Record(i)));
+   }
+   ASSERT_TRUE(sender.Flush());
+   EXPECT_EQ(0, sender.Pending());
+   for (size_t i = 0; i < kRecords; ++i) {
+      std::string record;
+      ASSERT_TRUE(receiver.ReceiveDataBlock(record, 1000));
+      EXPECT_EQ(Record(i), record);
+   }
+   std::string record;
+   EXPECT_FALSE(receiver.ReceiveDataBlock(record, 0));
+   // one frame per kilobyte instead of one message per record
+   EXPECT_GT(kRecords / 5, sender.GetMetrics().Messages());
+}
+
+TEST_F(DpiMsgLRZMQTests, DeadlineFlushesAPartialFrame) {
+   const std::string location = GetIpcLocation("deadline");
+   SendDpiMsgLRZMQ sender(location);
+   ReceiveDpiMsgLRZMQ receiver(location);
+   sender.SetCoalescing(64 * 1024, 10);
+   receiver.SetCoalescing(true);
+   ASSERT_TRUE(sender.Initialize());
+   ASSERT_TRUE(receiver.Initialize());
+
+   ASSERT_TRUE(sender.SendData("first"));
+   EXPECT_LT(0, sender.Pending());
+   EXPECT_TRUE(sender.FlushIfDue());
+   EXPECT_LT(0, sender.Pending());
+   std::string record;
+   EXPECT_FALSE(receiver.ReceiveDataBlock(record, 0));
+
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   EXPECT_TRUE(sender.FlushIfDue());
+   EXPECT_EQ(0, sender.Pending());
+   ASSERT_TRUE(receiver.ReceiveDataBlock(record, 1000));
+   EXPECT_EQ("first", record);
+}
+
+TEST_F(DpiMsgLRZMQTests, BatchGetsEveryRecordOfAFrame) {
+   const std::string location = GetIpcLocation("batch");
+   SendDpiMsgLRZMQ sender(location);
+   ReceiveDpiMsgLRZMQ receiver(location);
+   sender.SetCoalescing(64 * 1024, 1000);
+   receiver.SetCoalescing(true);
+   ASSERT_TRUE(sender.Initialize());
+   ASSERT_TRUE(receiver.Initialize());
+
+   for (size_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(sender.SendData(Record(i)));
+   }
+   ASSERT_TRUE(sender.Flush());
+   std::vector<std::string> batch;
+   ASSERT_TRUE(receiver.ReceiveDataBatch(batch, 1000));
+   ASSERT_EQ(3, batch.size());
+   EXPECT_EQ(Record(2), batch[2]);
+   EXPECT_FALSE(receiver.ReceiveDataBatch(batch, 0));
+   EXPECT_TRUE(batch.empty());
+}
+
+TEST_F(DpiMsgLRZMQTests, RecordsOfAFrameThatCannotBeFiredAreCounted) {
+   const std::string location = GetIpcLocation("nobody");
+   SendDpiMsgLRZMQ sender(location);
+   sender.SetCoalescing(64 * 1024, 1000);
+   ASSERT_TRUE(sender.Initialize());
+
+   for (size_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(sender.SendData(Record(i)));
+   }
+   EXPECT_FALSE(sender.Flush(1));
+   EXPECT_EQ(0, sender.Pending());
+   EXPECT_EQ(3, sender.GetMetrics().Dropped());
+   EXPECT_TRUE(sender.Flush(1));
+   EXPECT_EQ(3, sender.GetMetrics().Dropped());
+}
+
+TEST_F(DpiMsgLRZMQTests, FramesThatAreNotWholeRecordsAreDropped) {
+   const std::string location = GetIpcLocation("invalid");
+   SendDpiMsgLRZMQ sender(location);
+   ReceiveDpiMsgLRZMQ receiver(location);
+   receiver.SetCoalescing(true);
+   ASSERT_TRUE(sender.Initialize());
+   ASSERT_TRUE(receiver.Initialize());
+
+   ASSERT_TRUE(sender.SendData("not coalesced"));
+   std::string record;
+   EXPECT_FALSE(receiver.ReceiveDataBlock(record, 1000));
+}
+
+/**
+ * Every record carries the time it was sent, the receiver adds up how long
+ * records took to arrive.
+ */
+void DpiMsgLRZMQTests::CoalescingSpeed(const size_t flushBytes, const size_t records, const size_t recordSize) {
+   const std::string location = GetIpcLocation("speed" + std::to_string(flushBytes));
+   SendDpiMsgLRZMQ sender(location);
+   ReceiveDpiMsgLRZMQ receiver(location);
+   sender.SetQueueSize(10000);
+   receiver.SetQueueSize(10000);
+   sender.SetCoalescing(flushBytes, 1);
+   receiver.SetCoalescing(flushBytes > 0);
+   ASSERT_TRUE(sender.Initialize());
+   ASSERT_TRUE(receiver.Initialize());
+
+   int64_t totalLatency = 0;
+   int64_t maxLatency = 0;
+   size_t received = 0;
+   std::thread consumer([&] {
+      std::string record;
+      while (received < records && receiver.ReceiveDataBlock(record, 1000)) {
+         int64_t sent;
+         memcpy(&sent, record.data(), sizeof (sent));
+         const int64_t latency = NowUs() - sent;
+         totalLatency += latency;
+         maxLatency = std::max(maxLatency, latency);
+         received++;
+      }
+   });
+
+   std::string record(std::max(recordSize, sizeof (int64_t)), 'x');
+   StopWatch timer;
+   // no ASSERT until the consumer is joined, a joinable thread going out of
+   // scope terminates the test runner
+   bool sent = true;
+   for (size_t i = 0; sent && i < records; ++i) {
+      const int64_t now = NowUs();
+      memcpy(&record[0], &now, sizeof (now));
+      sent = sender.SendData(record);
+      EXPECT_TRUE(sent);
+   }
+   EXPECT_TRUE(sender.Flush());
+   consumer.join();
+   ASSERT_EQ(records, received);
+   std::cout << "flush at " << flushBytes << " bytes: "
+           << records * 1000000 / std::max(timer.ElapsedUs(), 1UL) << " msgs/sec, latency avg "
+           << totalLatency / static_cast<int64_t> (records) << " us, max " << maxLatency << " us" << std::endl;
+}
+
+TEST_F(DpiMsgLRZMQTests, DISABLED_CoalescingThresholdsSpeedTest) {
+   for (size_t flushBytes : {0, 1024, 4096, 16384, 65536}) {
+      CoalescingSpeed(flushBytes, 1000000, 150);
+   }
+}
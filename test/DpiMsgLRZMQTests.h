@@ -0,0 +1,25 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <czmq.h>
+#include <string>
+
+class DpiMsgLRZMQTests : public ::testing::Test {
+public:
+
+   DpiMsgLRZMQTests() {
+   };
+
+   static std::string GetIpcLocation(const std::string& name);
+   void CoalescingSpeed(const size_t flushBytes, const size_t records, const size_t recordSize);
+
+protected:
+
+   virtual void SetUp() {
+      zctx_interrupted = false;
+   }
+
+   virtual void TearDown() {
+      zctx_interrupted = false;
+   }
+};
@@ -0,0 +1,112 @@
+#include <unistd.h>
+#include "MappedLogTests.h"
+#include "MappedLog.h"
+
+std::string MappedLogTests::GetDirectory(const std::string& name) {
+   std::string directory("/tmp/MappedLogTests");
+   directory.append(name);
+   directory.append(std::to_string(getpid()));
+   return directory;
+}
+
+TEST_F(MappedLogTests, RecordsComeBackInOrderAcrossSegments) {
+   const std::string directory = GetDirectory("order");
+   MappedLog log(directory, 4096, 4);
+   ASSERT_TRUE(log.Open(false));
+   uint64_t head = log.Begin();
+   std::string record;
+   EXPECT_FALSE(log.Read(head, record));
+   EXPECT_FALSE(log.Append("", 0));
+   EXPECT_FALSE(log.Append(std::string(4096, 'x').data(), 4096));
+
+   const int kRecords = 2000;
+   int read = 0;
+   for (int i = 0; i < kRecords; ++i) {
+      const std::string written(1 + (i * 37) % 700, 'a' + i % 26);
+      // a full log makes room once the oldest segment is read and trimmed
+      while (!log.Append(written.data(), written.size())) {
+         ASSERT_TRUE(log.Read(head, record));
+         EXPECT_EQ(std::string(1 + (read * 37) % 700, 'a' + read % 26), record);
+         read++;
+         log.Trim(head);
+      }
+      EXPECT_GE(4, log.Segments());
+   }
+   while (log.Read(head, record)) {
+      EXPECT_EQ(std::string(1 + (read * 37) % 700, 'a' + read % 26), record);
+      read++;
+   }
+   EXPECT_EQ(kRecords, read);
+   EXPECT_EQ(log.End(), head);
+   log.Clear();
+   EXPECT_EQ(0, log.Segments());
+   EXPECT_EQ(log.Begin(), log.End());
+   rmdir(directory.c_str());
+}
+
+TEST_F(MappedLogTests, ReopenedAndSharedLogsSeeTheSameRecords) {
+   const std::string directory = GetDirectory("reopen");
+   MappedLog writer(directory, 4096, 8);
+   ASSERT_TRUE(writer.Open(false));
+   for (int i = 0; i < 1000; ++i) {
+      const std::string written = std::to_string(i);
+      ASSERT_TRUE(writer.Append(written.data(), written.size()));
+   }
+   EXPECT_LT(1, writer.Segments());
+
+   // another process would open it the same way, the segment size is found
+   MappedLog reader(directory, 1024, 8);
+   ASSERT_TRUE(reader.Open(true));
+   EXPECT_EQ(4096, reader.SegmentBytes());
+   EXPECT_EQ(writer.Begin(), reader.Begin());
+   EXPECT_EQ(writer.End(), reader.End());
+   uint64_t head = reader.Begin();
+   std::string record;
+   for (int i = 0; i < 1000; ++i) {
+      ASSERT_TRUE(reader.Read(head, record));
+      EXPECT_EQ(std::to_string(i), record);
+   }
+   EXPECT_FALSE(reader.Read(head, record));
+   ASSERT_TRUE(writer.Append("later", 5));
+   ASSERT_TRUE(reader.Read(head, record));
+   EXPECT_EQ("later", record);
+   EXPECT_TRUE(writer.Sync());
+
+   MappedLog emptied(directory, 4096, 8);
+   ASSERT_TRUE(emptied.Open(false));
+   EXPECT_EQ(0, emptied.Segments());
+   EXPECT_EQ(emptied.Begin(), emptied.End());
+   rmdir(directory.c_str());
+}
+
+TEST_F(MappedLogTests, ReleasedSegmentsAreReadAgainUntilTrimmed) {
+   const std::string directory = GetDirectory("release");
+   MappedLog writer(directory, 4096, 8);
+   ASSERT_TRUE(writer.Open(false));
+   for (int i = 0; i < 2000; ++i) {
+      const std::string written = std::to_string(i);
+      ASSERT_TRUE(writer.Append(written.data(), written.size()));
+   }
+   ASSERT_LT(2, writer.Segments());
+
+   MappedLog reader(directory, 4096, 8);
+   ASSERT_TRUE(reader.Open(true));
+   uint64_t head = reader.Begin();
+   std::string record;
+   for (int i = 0; i < 2000; ++i) {
+      ASSERT_TRUE(reader.Read(head, record));
+   }
+   reader.Release(head);
+   EXPECT_EQ(1, reader.Segments());
+   EXPECT_EQ(0, reader.Begin());
+   EXPECT_EQ(0, reader.Oldest());
+   uint64_t replay = 0;
+   ASSERT_TRUE(reader.Read(replay, record));
+   EXPECT_EQ("0", record);
+
+   // only what the writer removed is gone for the reader
+   writer.Trim(2 * writer.SegmentBytes());
+   EXPECT_EQ(2 * writer.SegmentBytes(), reader.Oldest());
+   writer.Clear();
+   rmdir(directory.c_str());
+}
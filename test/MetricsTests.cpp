@@ -0,0 +1,90 @@
+#include <unistd.h>
+#include "MetricsTests.h"
+#include "Metrics.h"
+#include "Rifle.h"
+#include "Vampire.h"
+
+std::string MetricsTests::GetIpcLocation(const std::string& name) {
+   std::string ipcLocation("ipc:///tmp/MetricsTests");
+   ipcLocation.append(name);
+   ipcLocation.append(std::to_string(getpid()));
+   ipcLocation.append(".ipc");
+   return ipcLocation;
+}
+
+TEST_F(MetricsTests, LatencyGoesInPowerOfTwoBuckets) {
+   Metrics metrics("Test", "histogram");
+   EXPECT_EQ(0, metrics.LatencyPercentile(50));
+   for (int i = 0; i < 99; ++i) {
+      metrics.Count(10, Metrics::Now());
+   }
+   metrics.Count(10, Metrics::Now() - 1000);
+   EXPECT_EQ(100, metrics.Messages());
+   EXPECT_EQ(1000, metrics.Bytes());
+   EXPECT_GE(4, metrics.LatencyPercentile(50));
+   EXPECT_EQ(1024, metrics.LatencyPercentile(100));
+   EXPECT_EQ(1, metrics.LatencyHistogram()[10]);
+   EXPECT_EQ(Metrics::kLatencyBuckets, metrics.LatencyHistogram().size());
+}
+
+TEST_F(MetricsTests, RifleAndVampireCountShots) {
+   const std::string location = GetIpcLocation("shots");
+   Rifle rifle(location);
+   Vampire vampire(location);
+   ASSERT_TRUE(rifle.Aim());
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   const int kShots = 100;
+   for (int i = 0; i < kShots; ++i) {
+      ASSERT_TRUE(rifle.Fire("0123456789"));
+   }
+   std::string shot;
+   for (int i = 0; i < kShots; ++i) {
+      ASSERT_TRUE(vampire.GetShot(shot, 1000));
+   }
+   EXPECT_FALSE(vampire.GetShot(shot, 0));
+
+   EXPECT_EQ(kShots, rifle.GetMetrics().Messages());
+   EXPECT_EQ(kShots * 10, rifle.GetMetrics().Bytes());
+   EXPECT_EQ(0, rifle.GetMetrics().Timeouts());
+   EXPECT_EQ(kShots, vampire.GetMetrics().Messages());
+   EXPECT_EQ(kShots * 10, vampire.GetMetrics().Bytes());
+   EXPECT_EQ(1, vampire.GetMetrics().Timeouts());
+   EXPECT_EQ(0, vampire.GetMetrics().Errors());
+   EXPECT_LT(0, vampire.GetMetrics().LatencyPercentile(99));
+}
+
+TEST_F(MetricsTests, RifleTimeoutsAreCounted) {
+   // nothing to push to, so the rifle never gets room to fire
+   Rifle rifle(GetIpcLocation("timeout"));
+   ASSERT_TRUE(rifle.Aim());
+   EXPECT_FALSE(rifle.Fire("lost", 20));
+   EXPECT_EQ(0, rifle.GetMetrics().Messages());
+   EXPECT_EQ(1, rifle.GetMetrics().Timeouts());
+   EXPECT_LE(10000, rifle.GetMetrics().BlockedMicroseconds());
+}
+
+TEST_F(MetricsTests, RegistryDumpsEveryEndpoint) {
+   const size_t before = MetricsRegistry::Instance().Size();
+   const std::string location = GetIpcLocation("dump");
+   {
+      Rifle rifle(location);
+      Vampire vampire(location);
+      EXPECT_EQ(before + 2, MetricsRegistry::Instance().Size());
+      ASSERT_TRUE(rifle.Aim());
+      ASSERT_TRUE(vampire.PrepareToBeShot());
+      ASSERT_TRUE(rifle.Fire("dumped"));
+      std::string shot;
+      ASSERT_TRUE(vampire.GetShot(shot, 1000));
+
+      const std::string text = MetricsRegistry::Instance().DumpText();
+      EXPECT_NE(std::string::npos, text.find("Rifle " + location + " messages=1 bytes=6"));
+      EXPECT_NE(std::string::npos, text.find("Vampire " + location + " messages=1 bytes=6"));
+
+      const std::string json = MetricsRegistry::Instance().DumpJson();
+      EXPECT_EQ('[', json.front());
+      EXPECT_EQ(']', json.back());
+      EXPECT_NE(std::string::npos, json.find("{\"endpoint\":\"Rifle\",\"location\":\"" + location
+              + "\",\"messages\":1,\"bytes\":6,"));
+   }
+   EXPECT_EQ(before, MetricsRegistry::Instance().Size());
+}
@@ -382,4 +382,37 @@ TEST_F(NotifierTest, 2Messages2Receivers_RestartReceivers_ExpectFeedback_VectorM
 
    // Shutdown everything
    Shutdown({senderData, receiver1ThreadData, receiver2ThreadData});
-}
\ No newline at end of file
+}
+TEST_F(NotifierTest, NotifyAsync_MissingListenerOnlyWaitsForDeadline) {
+   const size_t expectedHandshakes = 2;
+   auto notifier = Notifier::CreateNotifier(notifierQueue, handshakeQueue, expectedHandshakes);
+   ASSERT_NE(notifier.get(), nullptr);
+   notifier->SetDeadline(std::chrono::milliseconds(500));
+   auto listener = Listener::CreateListener(notifierQueue, handshakeQueue, "OnlyListener");
+   ASSERT_NE(listener.get(), nullptr);
+   // give the subscription time to reach the notifier
+   std::this_thread::sleep_for(std::chrono::seconds(1));
+
+   StopWatch timer;
+   auto notification = notifier->NotifyAsync(vectorToSend);
+   EXPECT_FALSE(notification->IsDone());
+
+   StopWatch listening;
+   while (!listener->NotificationReceived() && listening.ElapsedSec() < kMaxWaitTimeInSec) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+   EXPECT_EQ(vectorToSend, listener->GetMessages());
+   EXPECT_TRUE(listener->SendConfirmation());
+
+   EXPECT_EQ(1, notification->Wait());
+   EXPECT_LT(timer.ElapsedSec(), 5);
+   EXPECT_TRUE(notification->IsDone());
+   auto confirmed = notification->ConfirmedListeners();
+   ASSERT_EQ(1, confirmed.size());
+   EXPECT_NE(std::string::npos, confirmed[0].find("OnlyListener"));
+
+   // a second notification is confirmed independently of the first
+   auto second = notifier->NotifyAsync(vectorToSend);
+   EXPECT_NE(notification->Id(), second->Id());
+   EXPECT_EQ(0, second->Wait());
+}
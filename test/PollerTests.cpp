@@ -0,0 +1,99 @@
+#include <unistd.h>
+#include <map>
+#include "PollerTests.h"
+#include "Poller.h"
+#include "Rifle.h"
+#include "Vampire.h"
+#include "Shotgun.h"
+#include "Alien.h"
+#include "StopWatch.h"
+
+std::string PollerTests::GetIpcLocation(const std::string& name) {
+   std::string ipcLocation("ipc:///tmp/PollerTests");
+   ipcLocation.append(name);
+   ipcLocation.append(std::to_string(getpid()));
+   ipcLocation.append(".ipc");
+   return ipcLocation;
+}
+
+TEST_F(PollerTests, UninitializedAndDuplicateEndpointsAreRejected) {
+   Poller poller;
+   Vampire vampire(GetIpcLocation("uninitialized"));
+   EXPECT_FALSE(poller.Add(vampire, [] {}));
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   EXPECT_FALSE(poller.Add(vampire, nullptr));
+   EXPECT_TRUE(poller.Add(vampire, [] {}));
+   EXPECT_FALSE(poller.Add(vampire, [] {}));
+   EXPECT_EQ(1, poller.Size());
+   EXPECT_TRUE(poller.Remove(vampire));
+   EXPECT_FALSE(poller.Remove(vampire));
+   EXPECT_EQ(0, poller.Size());
+}
+
+TEST_F(PollerTests, OnePollForVampiresAliensAndDescriptors) {
+   const std::string first = GetIpcLocation("first");
+   const std::string second = GetIpcLocation("second");
+   const std::string news = GetIpcLocation("news");
+   Rifle firstRifle(first);
+   Rifle secondRifle(second);
+   Vampire firstVampire(first);
+   Vampire secondVampire(second);
+   ASSERT_TRUE(firstRifle.Aim());
+   ASSERT_TRUE(secondRifle.Aim());
+   ASSERT_TRUE(firstVampire.PrepareToBeShot());
+   ASSERT_TRUE(secondVampire.PrepareToBeShot());
+   Shotgun shotgun;
+   shotgun.Aim(news);
+   Alien alien;
+   alien.PrepareToBeShot(news);
+   int pipeFds[2];
+   ASSERT_EQ(0, pipe(pipeFds));
+   // give the subscription time to reach the shotgun
+   sleep(1);
+
+   std::map<std::string, int> received;
+   Poller poller;
+   ASSERT_TRUE(poller.Add(firstVampire, [&] {
+      std::string shot;
+      while (firstVampire.GetShot(shot, 0)) {
+         received[shot]++;
+      }
+   }));
+   ASSERT_TRUE(poller.Add(secondVampire, [&] {
+      std::string shot;
+      while (secondVampire.GetShot(shot, 0)) {
+         received[shot]++;
+      }
+   }));
+   ASSERT_TRUE(poller.Add(alien, [&] {
+      std::vector<std::string> bullets;
+      alien.GetShot(0, bullets);
+      if (!bullets.empty()) {
+         received[bullets.back()]++;
+      }
+   }));
+   ASSERT_TRUE(poller.AddFileDescriptor(pipeFds[0], [&] {
+      char wakeup;
+      if (read(pipeFds[0], &wakeup, 1) == 1) {
+         received["pipe"]++;
+      }
+   }));
+   EXPECT_EQ(0, poller.Poll(10));
+
+   ASSERT_TRUE(firstRifle.Fire("first"));
+   ASSERT_TRUE(secondRifle.Fire("second"));
+   shotgun.Fire("news");
+   ASSERT_EQ(1, write(pipeFds[1], "x", 1));
+
+   StopWatch timer;
+   while (received.size() < 4 && timer.ElapsedSec() < 5) {
+      EXPECT_LE(0, poller.Poll(100));
+   }
+   EXPECT_EQ(1, received["first"]);
+   EXPECT_EQ(1, received["second"]);
+   EXPECT_EQ(1, received["news"]);
+   EXPECT_EQ(1, received["pipe"]);
+   EXPECT_EQ(0, poller.Poll(10));
+   close(pipeFds[0]);
+   close(pipeFds[1]);
+}
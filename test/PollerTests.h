@@ -0,0 +1,24 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <czmq.h>
+#include <string>
+
+class PollerTests : public ::testing::Test {
+public:
+
+   PollerTests() {
+   };
+
+   static std::string GetIpcLocation(const std::string& name);
+
+protected:
+
+   virtual void SetUp() {
+      zctx_interrupted = false;
+   }
+
+   virtual void TearDown() {
+      zctx_interrupted = false;
+   }
+};
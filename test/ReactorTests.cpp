@@ -0,0 +1,224 @@
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "ReactorTests.h"
+#include "Reactor.h"
+#include "Rifle.h"
+#include "Vampire.h"
+#include "Kraken.h"
+#include "Harpoon.h"
+#include "StopWatch.h"
+
+std::string ReactorTests::GetIpcLocation(const size_t index) {
+   std::string ipcLocation("ipc:///tmp/ReactorTests");
+   ipcLocation.append(std::to_string(getpid()));
+   ipcLocation.append("_");
+   ipcLocation.append(std::to_string(index));
+   ipcLocation.append(".ipc");
+   return ipcLocation;
+}
+
+TEST_F(ReactorTests, OneThreadGetsShotsFromManyVampires) {
+   const size_t queues = 5;
+   const size_t shotsPerQueue = 100;
+   std::vector<std::unique_ptr<Rifle>> rifles;
+   std::vector<std::unique_ptr<Vampire>> vampires;
+   for (size_t i = 0; i < queues; i++) {
+      rifles.emplace_back(new Rifle(GetIpcLocation(i)));
+      vampires.emplace_back(new Vampire(GetIpcLocation(i)));
+      ASSERT_TRUE(rifles.back()->Aim());
+      ASSERT_TRUE(vampires.back()->PrepareToBeShot());
+   }
+
+   Reactor reactor;
+   ASSERT_TRUE(reactor.Start());
+   std::atomic<size_t> received(0);
+   for (auto& vampire : vampires) {
+      auto added = reactor.GetShots(*vampire, [&received](std::string& shot) {
+         EXPECT_EQ("bang", shot);
+         received++;
+      });
+      EXPECT_TRUE(added.get());
+   }
+
+   std::vector<std::future<bool>> fired;
+   for (size_t shot = 0; shot < shotsPerQueue; shot++) {
+      for (auto& rifle : rifles) {
+         fired.push_back(reactor.Fire(*rifle, "bang"));
+      }
+   }
+   for (auto& bullet : fired) {
+      EXPECT_TRUE(bullet.get());
+   }
+
+   StopWatch timer;
+   while (received < queues * shotsPerQueue && timer.ElapsedSec() < 5) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+   EXPECT_EQ(queues * shotsPerQueue, received);
+
+   EXPECT_TRUE(reactor.StopGettingShot(*vampires[0]).get());
+   EXPECT_FALSE(reactor.StopGettingShot(*vampires[0]).get());
+   reactor.Stop();
+   EXPECT_FALSE(reactor.Fire(*rifles[0], "bang").get());
+   EXPECT_FALSE(reactor.Post([] {}));
+}
+
+TEST_F(ReactorTests, FireFailsWithoutAimedRifle) {
+   Reactor reactor;
+   ASSERT_TRUE(reactor.Start());
+   Rifle rifle(GetIpcLocation(0));
+   EXPECT_FALSE(reactor.Fire(rifle, "bang").get());
+   ASSERT_TRUE(rifle.Aim());
+   EXPECT_FALSE(reactor.Fire(rifle, "").get());
+}
+
+TEST_F(ReactorTests, HarpoonChunksAreHeavedOnTheReactorThread) {
+   const std::string location = GetIpcLocation(100);
+   const size_t chunks = 50;
+   Kraken kraken;
+   kraken.MaxWaitInMs(5000);
+   ASSERT_EQ(Kraken::Spear::IMPALED, kraken.SetLocation(location));
+   Harpoon harpoon;
+   ASSERT_EQ(Harpoon::Spear::IMPALED, harpoon.Aim(location));
+
+   Reactor reactor;
+   ASSERT_TRUE(reactor.Start());
+   std::vector<std::string> heaved;
+   std::promise<void> ended;
+   auto added = reactor.Heave(harpoon, [&heaved, &ended](std::vector<uint8_t>& chunk) {
+      if (chunk.empty()) {
+         ended.set_value();
+      } else {
+         heaved.emplace_back(chunk.begin(), chunk.end());
+      }
+   });
+   EXPECT_TRUE(added.get());
+
+   auto sent = std::async(std::launch::async, [&kraken, chunks] {
+      for (size_t chunk = 0; chunk < chunks; chunk++) {
+         const std::string data = std::to_string(chunk);
+         if (kraken.SendTidalWave(Kraken::Chunks(data.begin(), data.end())) != Kraken::Battling::CONTINUE) {
+            return false;
+         }
+      }
+      return kraken.FinalBreach() == Kraken::Battling::CONTINUE;
+   });
+   EXPECT_TRUE(sent.get());
+   EXPECT_EQ(std::future_status::ready, ended.get_future().wait_for(std::chrono::seconds(5)));
+   reactor.Stop();
+   ASSERT_EQ(chunks, heaved.size());
+   for (size_t chunk = 0; chunk < chunks; chunk++) {
+      EXPECT_EQ(std::to_string(chunk), heaved[chunk]);
+   }
+}
+
+TEST_F(ReactorTests, StopFromACallbackStopsAfterIt) {
+   Reactor reactor;
+   ASSERT_TRUE(reactor.Start());
+   std::promise<void> stopped;
+   EXPECT_TRUE(reactor.Post([&reactor, &stopped] {
+      reactor.Stop();
+      stopped.set_value();
+   }));
+   EXPECT_EQ(std::future_status::ready, stopped.get_future().wait_for(std::chrono::seconds(5)));
+   EXPECT_FALSE(reactor.Post([] {}));
+   EXPECT_FALSE(reactor.IsRunning());
+   // joined by the next Start
+   EXPECT_TRUE(reactor.Start());
+   reactor.Stop();
+}
+
+/**
+ * Shots are fired round robin at every queue by one thread, then received by
+ * either one thread per Vampire or by a single reactor thread.
+ * 1000 queues need about 4000 file descriptors, raise ulimit -n first.
+ */
+void ReactorTests::ThreadPerQueueVersusReactor(const size_t queues, const size_t shotsPerQueue) {
+   std::vector<std::unique_ptr<Rifle>> rifles;
+   std::vector<std::unique_ptr<Vampire>> vampires;
+   for (size_t i = 0; i < queues; i++) {
+      rifles.emplace_back(new Rifle(GetIpcLocation(i)));
+      vampires.emplace_back(new Vampire(GetIpcLocation(i)));
+      if (!rifles.back()->Aim() || !vampires.back()->PrepareToBeShot()) {
+         std::cout << queues << " queues: could not create queue #" << i << ", skipped" << std::endl;
+         return;
+      }
+   }
+   const size_t total = queues * shotsPerQueue;
+   const std::string bullet(100, 'x');
+   auto fireAll = [&] {
+      for (size_t shot = 0; shot < shotsPerQueue; shot++) {
+         for (auto& rifle : rifles) {
+            rifle->Fire(bullet);
+         }
+      }
+   };
+
+   std::atomic<size_t> received(0);
+   {
+      StopWatch timer;
+      std::vector<std::thread> threads;
+      for (auto& vampire : vampires) {
+         Vampire* target = vampire.get();
+         threads.emplace_back([target, shotsPerQueue, &received] {
+            std::string shot;
+            for (size_t count = 0; count < shotsPerQueue;) {
+               if (target->GetShot(shot, 100)) {
+                  count++;
+                  received++;
+               }
+            }
+         });
+      }
+      fireAll();
+      for (auto& thread : threads) {
+         thread.join();
+      }
+      std::cout << queues << " queues, thread per queue: " << total * 1000000 / std::max(timer.ElapsedUs(), 1UL)
+              << " shots/sec" << std::endl;
+   }
+
+   received = 0;
+   {
+      StopWatch timer;
+      Reactor reactor;
+      // no ASSERT while the reactor runs, nothing returns before it is stopped
+      bool watched = reactor.Start();
+      for (size_t i = 0; watched && i < vampires.size(); i++) {
+         watched = reactor.GetShots(*vampires[i], [&received](std::string&) {
+            received++;
+         }).get();
+      }
+      EXPECT_TRUE(watched);
+      if (watched) {
+         fireAll();
+         // give up like a Vampire would, once no shot arrived for a second
+         size_t seen = 0;
+         auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+         while (received < total && std::chrono::steady_clock::now() < deadline) {
+            if (received != seen) {
+               seen = received;
+               deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+         }
+         EXPECT_EQ(total, received);
+         std::cout << queues << " queues, one reactor: " << total * 1000000 / std::max(timer.ElapsedUs(), 1UL)
+                 << " shots/sec" << std::endl;
+      }
+      reactor.Stop();
+   }
+}
+
+TEST_F(ReactorTests, DISABLED_ThreadPerQueueVersusReactorSpeedTest) {
+   const size_t totalShots = 1000000;
+   for (size_t queues : {1, 10, 100, 1000}) {
+      ThreadPerQueueVersusReactor(queues, totalShots / queues);
+   }
+}
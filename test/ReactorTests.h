@@ -0,0 +1,25 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <czmq.h>
+#include <string>
+
+class ReactorTests : public ::testing::Test {
+public:
+
+   ReactorTests() {
+   };
+
+   static std::string GetIpcLocation(const size_t index);
+   void ThreadPerQueueVersusReactor(const size_t queues, const size_t shotsPerQueue);
+
+protected:
+
+   virtual void SetUp() {
+      zctx_interrupted = false;
+   }
+
+   virtual void TearDown() {
+      zctx_interrupted = false;
+   }
+};
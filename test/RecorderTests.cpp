@@ -0,0 +1,176 @@
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include "RecorderTests.h"
+#include "Recorder.h"
+#include "Replayer.h"
+#include "Rifle.h"
+#include "Vampire.h"
+#include "MappedLog.h"
+
+std::string RecorderTests::GetIpcLocation(const std::string& name) {
+   std::string ipcLocation("ipc:///tmp/RecorderTests");
+   ipcLocation.append(name);
+   ipcLocation.append(std::to_string(getpid()));
+   ipcLocation.append(".ipc");
+   return ipcLocation;
+}
+
+namespace {
+   std::string GetDirectory(const std::string& name) {
+      return "/tmp/RecorderTests" + name + std::to_string(getpid());
+   }
+
+   void RemoveRecording(const std::string& directory) {
+      MappedLog log(directory);
+      if (log.Open(true)) {
+         log.Clear();
+      }
+      rmdir(directory.c_str());
+   }
+}
+
+TEST_F(RecorderTests, RecordsKeepEveryFrame) {
+   const Recorder::Frames frames = {"topic", "", std::string(1000, 'x')};
+   std::string record;
+   Recorder::Pack(1234, frames, record);
+   uint64_t timestamp = 0;
+   Recorder::Frames unpacked;
+   ASSERT_TRUE(Recorder::Unpack(record, timestamp, unpacked));
+   EXPECT_EQ(1234, timestamp);
+   EXPECT_EQ(frames, unpacked);
+
+   record.pop_back();
+   EXPECT_FALSE(Recorder::Unpack(record, timestamp, unpacked));
+   EXPECT_FALSE(Recorder::Unpack("", timestamp, unpacked));
+}
+
+TEST_F(RecorderTests, ReplayKeepsTheOrderAndPace) {
+   using namespace std::chrono;
+   const std::string directory = GetDirectory("pace");
+   {
+      Recorder recorder(directory);
+      EXPECT_FALSE(recorder.Record("not started"));
+      ASSERT_TRUE(recorder.Start());
+      for (int i = 0; i < 5; ++i) {
+         ASSERT_TRUE(recorder.Record(std::to_string(i)));
+         std::this_thread::sleep_for(milliseconds(20));
+      }
+      EXPECT_EQ(5, recorder.Recorded());
+      EXPECT_EQ(0, recorder.Missed());
+   }
+   Replayer replayer(directory);
+   ASSERT_TRUE(replayer.Open());
+   std::vector<std::string> replayed;
+   auto fire = [&replayed](const Replayer::Frames & frames) {
+      replayed.push_back(frames.front());
+      return true;
+   };
+   steady_clock::time_point start = steady_clock::now();
+   EXPECT_EQ(5, replayer.Replay(fire));
+   // four gaps of 20 ms between the first and the last
+   EXPECT_LE(80, duration_cast<milliseconds>(steady_clock::now() - start).count());
+   EXPECT_EQ(std::vector<std::string>({"0", "1", "2", "3", "4"}), replayed);
+   EXPECT_EQ(0, replayer.Replay(fire));
+
+   replayer.Rewind();
+   replayer.SetSpeed(0);
+   start = steady_clock::now();
+   EXPECT_EQ(5, replayer.Replay(fire));
+   EXPECT_GT(80, duration_cast<milliseconds>(steady_clock::now() - start).count());
+   EXPECT_EQ(10, replayed.size());
+   RemoveRecording(directory);
+}
+
+TEST_F(RecorderTests, StartingAgainRemovesTheEarlierRecording) {
+   const std::string directory = GetDirectory("again");
+   {
+      Recorder recorder(directory);
+      ASSERT_TRUE(recorder.Start());
+      for (int i = 0; i < 3; ++i) {
+         ASSERT_TRUE(recorder.Record("old"));
+      }
+      ASSERT_TRUE(recorder.Start());
+      EXPECT_EQ(0, recorder.Recorded());
+      for (int i = 0; i < 2; ++i) {
+         ASSERT_TRUE(recorder.Record("new"));
+      }
+   }
+   Replayer replayer(directory);
+   ASSERT_TRUE(replayer.Open());
+   replayer.SetSpeed(0);
+   std::vector<std::string> replayed;
+   EXPECT_EQ(2, replayer.Replay([&replayed](const Replayer::Frames & frames) {
+      replayed.push_back(frames.front());
+      return true;
+   }));
+   EXPECT_EQ(std::vector<std::string>({"new", "new"}), replayed);
+   RemoveRecording(directory);
+}
+
+TEST_F(RecorderTests, AnInterruptedReplayGoesOnAtThePace) {
+   using namespace std::chrono;
+   const std::string directory = GetDirectory("resume");
+   {
+      Recorder recorder(directory);
+      ASSERT_TRUE(recorder.Start());
+      for (int i = 0; i < 5; ++i) {
+         ASSERT_TRUE(recorder.Record(std::to_string(i)));
+         std::this_thread::sleep_for(milliseconds(20));
+      }
+   }
+   Replayer replayer(directory);
+   ASSERT_TRUE(replayer.Open());
+   size_t count = 0;
+   auto fire = [&count](const Replayer::Frames&) {
+      if (++count == 2) {
+         zctx_interrupted = true;
+      }
+      return true;
+   };
+   EXPECT_EQ(2, replayer.Replay(fire));
+   zctx_interrupted = false;
+   const steady_clock::time_point start = steady_clock::now();
+   EXPECT_EQ(3, replayer.Replay(fire));
+   // two gaps of 20 ms, not the 80 ms since the start of the recording
+   const auto elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+   EXPECT_LE(40, elapsed);
+   EXPECT_GT(70, elapsed);
+   RemoveRecording(directory);
+}
+
+TEST_F(RecorderTests, TappedShotsAreReplayedThroughARifle) {
+   const std::string directory = GetDirectory("tap");
+   const std::string recorded = GetIpcLocation("recorded");
+   const std::string replayed = GetIpcLocation("replayed");
+   {
+      Rifle rifle(recorded);
+      Vampire vampire(recorded);
+      ASSERT_TRUE(rifle.Aim());
+      ASSERT_TRUE(vampire.PrepareToBeShot());
+      Recorder recorder(directory);
+      ASSERT_TRUE(recorder.Start());
+      std::string shot;
+      for (int i = 0; i < 100; ++i) {
+         ASSERT_TRUE(rifle.Fire(std::to_string(i)));
+         ASSERT_TRUE(recorder.GetShot(vampire, shot, 1000));
+         EXPECT_EQ(std::to_string(i), shot);
+      }
+      EXPECT_FALSE(recorder.GetShot(vampire, shot, 0));
+      EXPECT_EQ(100, recorder.Recorded());
+   }
+   Rifle rifle(replayed);
+   Vampire vampire(replayed);
+   ASSERT_TRUE(rifle.Aim());
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   Replayer replayer(directory);
+   ASSERT_TRUE(replayer.Open());
+   replayer.SetSpeed(0);
+   EXPECT_EQ(100, replayer.Replay(rifle));
+   std::string shot;
+   for (int i = 0; i < 100; ++i) {
+      ASSERT_TRUE(vampire.GetShot(shot, 1000));
+      EXPECT_EQ(std::to_string(i), shot);
+   }
+   RemoveRecording(directory);
+}
@@ -3,6 +3,9 @@
 #include <boost/thread.hpp>
 #include "RifleVampireTests.h"
 #include "Death.h"
+#include "ShmRing.h"
+#include "MappedLog.h"
+#include "PackedStake.h"
 #include "FileIO.h"
 #include <TimeStats.h>
 #include <TriggerTimeStats.h>
@@ -10,9 +13,11 @@
 #include <QAPI.h>
 #include <q/spsc.hpp>
 #include <q/mpmc.hpp>
+#include <chrono>
 #include <future>
 #include <QueueNadoMacros.h>
 #include <limits>
+#include <poll.h>
 
 namespace {
    const int kNoWaitTimeMs = 0;
@@ -668,6 +673,410 @@ TEST_F(RifleVampireTests, ipcFilesCleanedOnFatal) {
    ASSERT_FALSE(FileIO::DoesFileExist(addressRealPath));
 }
 
+TEST_F(RifleVampireTests, VampireFileDescriptorSignalsShots) {
+   std::string location = GetIpcLocation();
+   Rifle rifle(location);
+   Vampire vampire(location);
+   EXPECT_EQ(-1, vampire.GetFileDescriptor());
+   EXPECT_FALSE(vampire.IsReadable());
+   ASSERT_TRUE(rifle.Aim());
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   const int fd = vampire.GetFileDescriptor();
+   ASSERT_GE(fd, 0);
+   EXPECT_FALSE(vampire.IsReadable());
+
+   ASSERT_TRUE(rifle.Fire("one"));
+   ASSERT_TRUE(rifle.Fire("two"));
+   // edge triggered: wait for the descriptor, then drain while readable
+   std::vector<std::string> shots;
+   StopWatch timer;
+   while (shots.size() < 2 && timer.ElapsedSec() < 5) {
+      pollfd item = {fd, POLLIN, 0};
+      poll(&item, 1, 100);
+      while (vampire.IsReadable()) {
+         std::string shot;
+         ASSERT_TRUE(vampire.GetShot(shot, 0));
+         shots.push_back(shot);
+      }
+   }
+   ASSERT_EQ(2, shots.size());
+   EXPECT_EQ("one", shots[0]);
+   EXPECT_EQ("two", shots[1]);
+   EXPECT_FALSE(vampire.IsReadable());
+}
+
+TEST_F(RifleVampireTests, ShmRifleAndVampireShareTheRing) {
+   std::string location = "shm://RifleVampireTests" + std::to_string(getpid());
+   Rifle rifle(location);
+   Vampire vampire(location);
+   ASSERT_TRUE(rifle.Aim());
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   EXPECT_FALSE(rifle.FireStake(&rifle));
+   EXPECT_FALSE(rifle.Fire(std::string(ShmRing::kDefaultCapacity, 'x'), kNoWaitTimeMs));
+
+   // a waiting vampire is woken up by the next shot
+   std::string shot;
+   auto waiting = std::async(std::launch::async, [&] {
+      return vampire.GetShot(shot, 5000);
+   });
+   zclock_sleep(100);
+   ASSERT_TRUE(rifle.Fire("wake up"));
+   ASSERT_TRUE(waiting.get());
+   EXPECT_EQ("wake up", shot);
+   EXPECT_FALSE(vampire.GetShot(shot, kNoWaitTimeMs));
+
+   // more than the ring holds, so it wraps around while shots are taken
+   const int kShots = 20000;
+   auto shots = std::async(std::launch::async, [&] {
+      std::string wound;
+      for (int i = 0; i < kShots; ++i) {
+         if (!vampire.GetShot(wound, kLongWaitTimeMs) ||
+                 wound != std::string(1 + i % 1000, 'a' + i % 26)) {
+            return i;
+         }
+      }
+      return kShots;
+   });
+   for (int i = 0; i < kShots; ++i) {
+      ASSERT_TRUE(rifle.Fire(std::string(1 + i % 1000, 'a' + i % 26)));
+   }
+   EXPECT_EQ(kShots, shots.get());
+}
+
+TEST_F(RifleVampireTests, BatchesArePackedAndLandInCallerStorage) {
+   EXPECT_EQ(sizeof (void*) + sizeof (uint32_t), sizeof (PackedStake));
+   std::string location = GetIpcLocation();
+   Rifle rifle(location);
+   Vampire vampire(location);
+   ASSERT_TRUE(rifle.Aim());
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+
+   std::vector<PackedStake> stakes;
+   for (uint32_t i = 0; i < SIZE_OF_STAKE_BUNDLE; ++i) {
+      stakes.push_back({reinterpret_cast<void*> (i + 1), i});
+   }
+   ASSERT_TRUE(rifle.FireBatch(stakes));
+   std::vector<PackedStake> received;
+   ASSERT_TRUE(vampire.GetBatch(received, kLongWaitTimeMs));
+   ASSERT_EQ(stakes.size(), received.size());
+   for (size_t i = 0; i < stakes.size(); ++i) {
+      EXPECT_EQ(stakes[i].stake, received[i].stake);
+      EXPECT_EQ(stakes[i].hash, received[i].hash);
+   }
+
+   PackedStake storage[SIZE_OF_STAKE_BUNDLE];
+   size_t count = 0;
+   ASSERT_TRUE(rifle.FireBatch(stakes.data(), 10));
+   ASSERT_TRUE(vampire.GetBatch(storage, SIZE_OF_STAKE_BUNDLE, count, kLongWaitTimeMs));
+   EXPECT_EQ(10, count);
+   EXPECT_EQ(stakes[9].hash, storage[9].hash);
+
+   // too many for the storage, or not whole elements, is dropped
+   ASSERT_TRUE(rifle.FireBatch(stakes.data(), 11));
+   EXPECT_FALSE(vampire.GetBatch(storage, 10, count, kLongWaitTimeMs));
+   EXPECT_EQ(0, count);
+   const std::vector<uint8_t> bytes(13, 1);
+   ASSERT_TRUE(rifle.FireBatch(bytes));
+   EXPECT_FALSE(vampire.GetBatch(received, kLongWaitTimeMs));
+   EXPECT_TRUE(received.empty());
+   EXPECT_FALSE(rifle.FireBatch(std::vector<PackedStake>()));
+}
+
+TEST_F(RifleVampireTests, CreditFlowSkipsTheVampireWithoutCredit) {
+   std::string location = GetIpcLocation();
+   Rifle rifle(location);
+   rifle.SetCreditFlow(true);
+   ASSERT_TRUE(rifle.Aim());
+   // no vampire, no credit
+   EXPECT_FALSE(rifle.Fire("nobody", 10));
+
+   const int kCredit = 10;
+   const int kShots = 200;
+   Vampire slow(location);
+   slow.SetCredit(kCredit);
+   ASSERT_TRUE(slow.PrepareToBeShot());
+   Vampire fast(location);
+   fast.SetCredit(kCredit);
+   ASSERT_TRUE(fast.PrepareToBeShot());
+
+   auto fastShots = std::async(std::launch::async, [&] {
+      std::string shot;
+      int shots = 0;
+      while (fast.GetShot(shot, 500)) {
+         shots++;
+      }
+      return shots;
+   });
+   for (int i = 0; i < kShots; ++i) {
+      ASSERT_TRUE(rifle.Fire(std::to_string(i), kLongWaitTimeMs));
+   }
+   // the slow vampire never asked for more than its first credit
+   std::string shot;
+   int slowShots = 0;
+   while (slow.GetShot(shot, 100)) {
+      slowShots++;
+   }
+   EXPECT_GE(kCredit, slowShots);
+   EXPECT_EQ(kShots, slowShots + fastShots.get());
+}
+
+TEST_F(RifleVampireTests, CreditFlowVampireSkipsTheEndOfAMisfire) {
+   std::string location = GetIpcLocation();
+   // plays a credit flow Rifle whose bullet did not go out after the identity
+   zctx_t* context = zctx_new();
+   void* router = zsocket_new(context, ZMQ_ROUTER);
+   ASSERT_LE(0, zsocket_bind(router, location.c_str()));
+   Vampire vampire(location);
+   vampire.SetCredit(10);
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   std::string shot;
+   EXPECT_FALSE(vampire.GetShot(shot, 0));
+   zmsg_t* grant = zmsg_recv(router);
+   ASSERT_TRUE(grant != NULL);
+   zframe_t* identity = zmsg_pop(grant);
+   zmsg_destroy(&grant);
+
+   zframe_send(&identity, router, ZFRAME_MORE | ZFRAME_REUSE);
+   zmq_send(router, NULL, 0, 0);
+   const auto start = std::chrono::steady_clock::now();
+   EXPECT_FALSE(vampire.GetShot(shot, 100));
+   // the empty frame is skipped, the wait is not cut short
+   EXPECT_LE(90, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+   zframe_send(&identity, router, ZFRAME_MORE | ZFRAME_REUSE);
+   zmq_send(router, NULL, 0, 0);
+   zframe_send(&identity, router, ZFRAME_MORE);
+   zmq_send(router, "bullet", 6, 0);
+   ASSERT_TRUE(vampire.GetShot(shot, 1000));
+   EXPECT_EQ("bullet", shot);
+   EXPECT_EQ(0, vampire.GetMetrics().Errors());
+   zctx_destroy(&context);
+}
+
+TEST_F(RifleVampireTests, OverloadPoliciesDropWithoutBlocking) {
+   // nothing to push to, so there is never room
+   Rifle newest(GetIpcLocation());
+   newest.SetOverload(Rifle::Overload::DROP_NEWEST);
+   ASSERT_TRUE(newest.Aim());
+   StopWatch watch;
+   EXPECT_FALSE(newest.Fire("dropped", kLongWaitTimeMs));
+   EXPECT_GT(kLongWaitTimeMs * 1000UL / 2, watch.ElapsedUs());
+   EXPECT_EQ(1, newest.GetMetrics().Dropped());
+
+   Rifle sample(GetIpcLocation());
+   sample.SetOverload(Rifle::Overload::SAMPLE, 4);
+   ASSERT_TRUE(sample.Aim());
+   for (int i = 0; i < 12; ++i) {
+      EXPECT_FALSE(sample.Fire("sampled", kLongWaitTimeMs));
+   }
+   EXPECT_EQ(12, sample.GetMetrics().Dropped());
+   // only the first and every fourth after it looked for room
+   EXPECT_EQ(3, sample.GetMetrics().Timeouts());
+
+   std::string location = GetIpcLocation();
+   Rifle oldest(location);
+   oldest.SetOverload(Rifle::Overload::DROP_OLDEST, 5);
+   ASSERT_TRUE(oldest.Aim());
+   for (int i = 0; i < 8; ++i) {
+      EXPECT_TRUE(oldest.Fire(std::to_string(i), kLongWaitTimeMs));
+   }
+   EXPECT_EQ(5, oldest.Held());
+   EXPECT_EQ(3, oldest.GetMetrics().Dropped());
+
+   Vampire vampire(location);
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   EXPECT_TRUE(oldest.FireHeld(kLongWaitTimeMs));
+   EXPECT_EQ(0, oldest.Held());
+   std::string shot;
+   for (int i = 3; i < 8; ++i) {
+      ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+      EXPECT_EQ(std::to_string(i), shot);
+   }
+   EXPECT_EQ(3, oldest.GetMetrics().Dropped());
+}
+
+TEST_F(RifleVampireTests, SpilledBulletsAreFiredInOrderOnceThereIsRoom) {
+   const std::string directory = "/tmp/RifleVampireTestsSpill" + std::to_string(getpid());
+   std::string location = GetIpcLocation();
+   TestRifle rifle(location);
+   rifle.SetSpill(directory, 4096, 4);
+   rifle.SetOverload(Rifle::Overload::DROP_NEWEST);
+   ASSERT_TRUE(rifle.Aim());
+   // nothing to push to, every bullet is spilled until the spill is full
+   int spilled = 0;
+   while (rifle.Fire(std::to_string(spilled), kLongWaitTimeMs)) {
+      spilled++;
+   }
+   EXPECT_LT(1000, spilled);
+   EXPECT_LE(4096 * 3, rifle.Spilled());
+   EXPECT_EQ(1, rifle.GetMetrics().Dropped());
+
+   Vampire vampire(location);
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   std::string shot;
+   int shots = 0;
+   while (shots < spilled) {
+      rifle.FireHeld(0);
+      while (vampire.GetShot(shot, 10)) {
+         ASSERT_EQ(std::to_string(shots), shot);
+         shots++;
+      }
+      ASSERT_FALSE(zctx_interrupted);
+   }
+   EXPECT_EQ(0, rifle.Spilled());
+   EXPECT_TRUE(rifle.Fire("after", kLongWaitTimeMs));
+   ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+   EXPECT_EQ("after", shot);
+   rifle.Destroy();
+   EXPECT_EQ(0, rmdir(directory.c_str()));
+}
+
+namespace {
+   void RemoveLog(const std::string& directory) {
+      MappedLog log(directory);
+      if (log.Open(true)) {
+         log.Clear();
+      }
+      rmdir(directory.c_str());
+   }
+}
+
+TEST_F(RifleVampireTests, LogKeepsShotsForEveryConsumerAcrossRestarts) {
+   const std::string directory = "/tmp/RifleVampireTestsLog" + std::to_string(getpid());
+   const std::string location = "log://" + directory;
+   RemoveLog(directory);
+   const int kShots = 100;
+   {
+      TestRifle rifle(location);
+      ASSERT_TRUE(rifle.Aim());
+      for (int i = 0; i < kShots / 2; ++i) {
+         ASSERT_TRUE(rifle.Fire(std::to_string(i)));
+      }
+      // a restarted rifle appends after what is there
+      rifle.Destroy();
+      ASSERT_TRUE(rifle.Aim());
+      for (int i = kShots / 2; i < kShots; ++i) {
+         ASSERT_TRUE(rifle.Fire(std::to_string(i)));
+      }
+      EXPECT_FALSE(rifle.FireStake(&rifle));
+   }
+   std::string shot;
+   uint64_t replay = 0;
+   {
+      Vampire vampire(location);
+      vampire.SetConsumer("first");
+      ASSERT_TRUE(vampire.PrepareToBeShot());
+      replay = vampire.GetOffset();
+      for (int i = 0; i < kShots / 2; ++i) {
+         ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+         EXPECT_EQ(std::to_string(i), shot);
+      }
+      EXPECT_TRUE(vampire.Commit());
+      // taken but not committed, so taken again after the restart
+      ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+   }
+   {
+      Vampire vampire(location);
+      vampire.SetConsumer("first");
+      ASSERT_TRUE(vampire.PrepareToBeShot());
+      for (int i = kShots / 2; i < kShots; ++i) {
+         ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+         EXPECT_EQ(std::to_string(i), shot);
+      }
+      EXPECT_FALSE(vampire.GetShot(shot, 10));
+      ASSERT_TRUE(vampire.Seek(replay));
+      ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+      EXPECT_EQ("0", shot);
+   }
+   {
+      Vampire vampire(location);
+      vampire.SetConsumer("second");
+      ASSERT_TRUE(vampire.PrepareToBeShot());
+      ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+      EXPECT_EQ("0", shot);
+   }
+   RemoveLog(directory);
+}
+
+TEST_F(RifleVampireTests, LogSeeksBackToSegmentsAlreadyRead) {
+   const std::string directory = "/tmp/RifleVampireTestsLogSeek" + std::to_string(getpid());
+   const std::string location = "log://" + directory;
+   RemoveLog(directory);
+   const int kShots = 2000;
+   {
+      // small segments, the rifle and vampire go on with the size found
+      MappedLog log(directory, 4096, 16);
+      ASSERT_TRUE(log.Open(false));
+      for (int i = 0; i < kShots; ++i) {
+         const std::string bullet = std::to_string(i);
+         ASSERT_TRUE(log.Append(bullet.data(), bullet.size()));
+      }
+      ASSERT_LT(2, log.Segments());
+   }
+   Vampire vampire(location);
+   ASSERT_TRUE(vampire.PrepareToBeShot());
+   std::string shot;
+   for (int i = 0; i < kShots; ++i) {
+      ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+      EXPECT_EQ(std::to_string(i), shot);
+   }
+   ASSERT_TRUE(vampire.Seek(0));
+   for (int i = 0; i < kShots; ++i) {
+      ASSERT_TRUE(vampire.GetShot(shot, kLongWaitTimeMs));
+      EXPECT_EQ(std::to_string(i), shot);
+   }
+   RemoveLog(directory);
+}
+
+TEST_F(RifleVampireTests, LogIsTrimmedOnlyWhereEveryConsumerCommitted) {
+   const std::string directory = "/tmp/RifleVampireTestsLogTrim" + std::to_string(getpid());
+   const std::string location = "log://" + directory;
+   RemoveLog(directory);
+   auto segments = [&directory] {
+      MappedLog log(directory);
+      return log.Open(true) ? log.Segments() : 0;
+   };
+   {
+      // small segments, the rifle goes on with the size found
+      MappedLog log(directory, 4096, MappedLog::kDefaultMaxSegments);
+      ASSERT_TRUE(log.Open(false));
+      ASSERT_TRUE(log.Append("seed", 4));
+   }
+   Vampire first(location);
+   first.SetConsumer("first");
+   ASSERT_TRUE(first.PrepareToBeShot());
+   Vampire second(location);
+   second.SetConsumer("second");
+   ASSERT_TRUE(second.PrepareToBeShot());
+   TestRifle rifle(location);
+   ASSERT_TRUE(rifle.Aim());
+
+   const std::string bullet(100, 'x');
+   size_t fired = 0;
+   while (rifle.Fire(bullet, 0)) {
+      fired++;
+   }
+   const size_t full = segments();
+   EXPECT_EQ(MappedLog::kDefaultMaxSegments, full);
+
+   std::string shot;
+   for (size_t i = 0; i <= fired; ++i) {
+      ASSERT_TRUE(first.GetShot(shot, kLongWaitTimeMs));
+   }
+   ASSERT_TRUE(first.Commit());
+   // the second consumer still needs every shot
+   EXPECT_FALSE(rifle.Fire(bullet, 10));
+   EXPECT_EQ(full, segments());
+
+   for (size_t i = 0; i < fired / 2; ++i) {
+      ASSERT_TRUE(second.GetShot(shot, kLongWaitTimeMs));
+   }
+   ASSERT_TRUE(second.Commit());
+   EXPECT_TRUE(rifle.Fire(bullet, 10));
+   EXPECT_GT(full, segments());
+   RemoveLog(directory);
+}
+
 TEST_F(RifleVampireTests, RifleOwnsSocketOneRifleOneVampireIPCLargeSize) {
    if (geteuid() == 0) {
       std::string location = GetIpcLocation();
@@ -2252,3 +2661,42 @@ TEST_F(RifleVampireTests, MultileRiflesSocketOwnerTest) {
 
 }
 
+/**
+ * Fire and get shot through a log:// location, each side in its own thread,
+ * to see the MB/s the memory mapped segments sustain.
+ */
+TEST_F(RifleVampireTests, DISABLED_LogQueueSpeedTest) {
+   const std::string directory = "/tmp/RifleVampireTestsLogSpeed" + std::to_string(getpid());
+   const std::string location = "log://" + directory;
+   for (size_t size : {100, 1024, 16384}) {
+      RemoveLog(directory);
+      const size_t shots = 512 * 1024 * 1024 / size;
+      Rifle rifle(location);
+      ASSERT_TRUE(rifle.Aim());
+      Vampire vampire(location);
+      ASSERT_TRUE(vampire.PrepareToBeShot());
+      StopWatch timer;
+      auto taken = std::async(std::launch::async, [&] {
+         std::string shot;
+         size_t count = 0;
+         while (count < shots && vampire.GetShot(shot, kLongWaitTimeMs)) {
+            // committing now and then lets the rifle reuse the disk
+            if (++count % 10000 == 0) {
+               vampire.Commit();
+            }
+         }
+         vampire.Commit();
+         return count;
+      });
+      const std::string bullet(size, 'x');
+      for (size_t i = 0; i < shots; ++i) {
+         ASSERT_TRUE(rifle.Fire(bullet));
+      }
+      const uint64_t fired = timer.ElapsedUs();
+      ASSERT_EQ(shots, taken.get());
+      const uint64_t elapsed = std::max(timer.ElapsedUs(), 1UL);
+      std::cout << size << " byte shots: fired " << shots * size / std::max(fired, 1UL) << " MB/s, taken "
+              << shots * size / elapsed << " MB/s, " << shots * 1000000 / elapsed << " shots/sec" << std::endl;
+   }
+   RemoveLog(directory);
+}
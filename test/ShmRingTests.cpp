@@ -0,0 +1,112 @@
+#include <unistd.h>
+#include <memory>
+#include "ShmRingTests.h"
+#include "ShmRing.h"
+
+std::string ShmRingTests::GetLocation(const std::string& name) {
+   std::string location("shm://ShmRingTests");
+   location.append(name);
+   location.append(std::to_string(getpid()));
+   return location;
+}
+
+TEST_F(ShmRingTests, RecordsArePeekedInPlaceUntilConsumed) {
+   const std::string location = GetLocation("peek");
+   ShmRing producer(location, true, 4096);
+   ShmRing consumer(location, false);
+   ASSERT_TRUE(producer.IsOpen());
+   ASSERT_TRUE(consumer.IsOpen());
+   EXPECT_EQ(4096, consumer.Capacity());
+
+   const char* data = NULL;
+   size_t size = 0;
+   EXPECT_FALSE(consumer.Peek(data, size));
+   ASSERT_TRUE(producer.Write("first", 5));
+   ASSERT_TRUE(producer.Write("second", 6));
+   ASSERT_TRUE(consumer.Peek(data, size));
+   EXPECT_EQ("first", std::string(data, size));
+   // not consumed, so it is seen again
+   ASSERT_TRUE(consumer.Peek(data, size));
+   EXPECT_EQ("first", std::string(data, size));
+   consumer.Consume();
+   std::string record;
+   ASSERT_TRUE(consumer.Read(record));
+   EXPECT_EQ("second", record);
+   EXPECT_FALSE(consumer.Read(record));
+
+   // a peeked record is not overwritten while the ring is full
+   const std::string large(2000, 'x');
+   ASSERT_TRUE(producer.Write(large.data(), large.size()));
+   ASSERT_TRUE(consumer.Peek(data, size));
+   while (producer.Write("fill", 4)) {
+   }
+   EXPECT_EQ(large, std::string(data, size));
+   consumer.Consume();
+   EXPECT_TRUE(producer.Write("fill", 4));
+}
+
+TEST_F(ShmRingTests, AnOwnerReplacesARingLeftBehind) {
+   const std::string location = GetLocation("stale");
+   EXPECT_FALSE(ShmRing(location, false).IsOpen());
+   // the owner of the first ring crashed, its records and size stay behind
+   std::unique_ptr<ShmRing> crashed(new ShmRing(location, true, 4096));
+   ASSERT_TRUE(crashed->Write("stale", 5));
+
+   ShmRing owner(location, true, 8192);
+   ShmRing consumer(location, false);
+   ASSERT_TRUE(owner.IsOpen());
+   ASSERT_TRUE(consumer.IsOpen());
+   EXPECT_EQ(8192, owner.Capacity());
+   EXPECT_EQ(8192, consumer.Capacity());
+   std::string record;
+   EXPECT_FALSE(consumer.Read(record));
+   ASSERT_TRUE(owner.Write("fresh", 5));
+   ASSERT_TRUE(consumer.Read(record));
+   EXPECT_EQ("fresh", record);
+}
+
+TEST_F(ShmRingTests, TheOtherSideMapsTheRingOnceItIsCreated) {
+   const std::string location = GetLocation("later");
+   ShmRing consumer(location, false);
+   ShmRing producer(location, false);
+   EXPECT_FALSE(consumer.IsOpen());
+   const char* data = NULL;
+   size_t size = 0;
+   EXPECT_FALSE(consumer.Peek(data, size));
+   EXPECT_FALSE(producer.Write("early", 5));
+
+   ShmRing owner(location, true, 4096);
+   ASSERT_TRUE(owner.IsOpen());
+   ASSERT_TRUE(owner.Write("first", 5));
+   std::string record;
+   ASSERT_TRUE(consumer.Read(record));
+   EXPECT_EQ("first", record);
+   EXPECT_EQ(4096, consumer.Capacity());
+   ASSERT_TRUE(producer.Write("second", 6));
+   ASSERT_TRUE(owner.Read(record));
+   EXPECT_EQ("second", record);
+}
+
+TEST_F(ShmRingTests, TheOtherSideMovesOnToTheRingOfANewOwner) {
+   const std::string location = GetLocation("moved");
+   std::unique_ptr<ShmRing> crashed(new ShmRing(location, true, 4096));
+   ShmRing consumer(location, false);
+   ShmRing producer(location, false);
+   ASSERT_TRUE(consumer.IsOpen());
+   ASSERT_TRUE(crashed->Write("old", 3));
+   std::string record;
+   ASSERT_TRUE(consumer.Read(record));
+   EXPECT_EQ("old", record);
+
+   ShmRing owner(location, true, 8192);
+   ASSERT_TRUE(owner.Write("new", 3));
+   ASSERT_TRUE(consumer.Read(record));
+   EXPECT_EQ("new", record);
+   EXPECT_EQ(8192, consumer.Capacity());
+   ASSERT_TRUE(producer.Write("back", 4));
+   ASSERT_TRUE(owner.Read(record));
+   EXPECT_EQ("back", record);
+   // the owner that was replaced does not remove the new ring
+   crashed.reset();
+   EXPECT_TRUE(ShmRing(location, false).IsOpen());
+}
@@ -144,6 +144,131 @@ TEST_F(ShotgunAlienTests, ShootOneAlienTenThousandTimesIPC) {
 }
 
 
+TEST_F(ShotgunAlienTests, AlienOnlyGetsShotForItsTopic) {
+   std::string location = ShotgunAlienTests::GetTcpLocation();
+   Shotgun shotgun;
+   shotgun.Aim(location);
+   Alien alien;
+   alien.Subscribe("weather");
+   alien.PrepareToBeShot(location);
+   Alien everything;
+   everything.PrepareToBeShot(location);
+   // give the subscriptions time to reach the Shotgun
+   sleep(1);
+
+   std::vector<std::string> sports = {"goal!"};
+   std::vector<std::string> weather = {"sunny", "warm"};
+   shotgun.Fire("sports", sports);
+   shotgun.Fire("weather.stockholm", weather);
+
+   std::string topic;
+   std::vector<std::string> bullets;
+   alien.GetShot(1000, topic, bullets);
+   EXPECT_EQ("weather.stockholm", topic);
+   EXPECT_EQ(weather, bullets);
+   alien.GetShot(100, topic, bullets);
+   EXPECT_TRUE(bullets.empty());
+
+   everything.GetShot(1000, topic, bullets);
+   EXPECT_EQ("sports", topic);
+   EXPECT_EQ(sports, bullets);
+   everything.GetShot(1000, topic, bullets);
+   EXPECT_EQ("weather.stockholm", topic);
+
+   alien.Unsubscribe("weather");
+   alien.Subscribe("sports");
+   sleep(1);
+   shotgun.Fire("weather", weather);
+   shotgun.Fire("sports", sports);
+   alien.GetShot(1000, topic, bullets);
+   EXPECT_EQ("sports", topic);
+   EXPECT_EQ(sports, bullets);
+}
+
+TEST_F(ShotgunAlienTests, AlienShotInPlaceByZeroCopyShotgun) {
+   std::string location = ShotgunAlienTests::GetTcpLocation();
+   Shotgun shotgun;
+   shotgun.Aim(location);
+   Alien alien;
+   alien.PrepareToBeShot(location);
+   sleep(1);
+
+   const std::string large(4 * 1024 * 1024, 'r');
+   std::vector<std::string> bullets = {large, "small"};
+   shotgun.Fire("rules", std::move(bullets));
+
+   Alien::Shot shot;
+   EXPECT_TRUE(shot.Empty());
+   ASSERT_TRUE(alien.GetShot(1000, shot));
+   ASSERT_FALSE(shot.Empty());
+   EXPECT_EQ("rules", shot.Topic());
+   ASSERT_EQ(2, shot.Size());
+   EXPECT_EQ(large.size(), shot.Bullet(0).size());
+   EXPECT_TRUE(shot.Bullet(0) == large);
+   EXPECT_EQ("small", shot.Bullet(1));
+
+   EXPECT_FALSE(alien.GetShot(100, shot));
+   EXPECT_TRUE(shot.Empty());
+   EXPECT_EQ(0, shot.Size());
+}
+
+TEST_F(ShotgunAlienTests, LateAlienGetsLastValues) {
+   std::string location = ShotgunAlienTests::GetTcpLocation();
+   Shotgun shotgun;
+   shotgun.SetLastValueCache(true);
+   shotgun.Aim(location);
+
+   std::vector<std::string> stale = {"cloudy"};
+   std::vector<std::string> weather = {"sunny", "warm"};
+   std::vector<std::string> sports = {"goal!"};
+   shotgun.Fire("weather.stockholm", stale);
+   shotgun.Fire("weather.stockholm", weather);
+   shotgun.Fire("sports", sports);
+
+   Alien alien;
+   alien.Subscribe("weather");
+   alien.PrepareToBeShot(location);
+   shotgun.Reload(1000);
+
+   std::string topic;
+   std::vector<std::string> bullets;
+   alien.GetShot(1000, topic, bullets);
+   EXPECT_EQ("weather.stockholm", topic);
+   EXPECT_EQ(weather, bullets);
+   alien.GetShot(100, topic, bullets);
+   EXPECT_TRUE(bullets.empty());
+}
+
+TEST_F(ShotgunAlienTests, ConflatingAlienOnlyGetsNewestPerTopic) {
+   std::string location = ShotgunAlienTests::GetTcpLocation();
+   Shotgun shotgun;
+   shotgun.Aim(location);
+   Alien alien;
+   alien.SetConflate(true);
+   alien.PrepareToBeShot(location);
+   sleep(1);
+
+   for (int i = 0; i < 100; i++) {
+      shotgun.Fire("price", {std::to_string(i)});
+      shotgun.Fire("volume", {std::to_string(i * 10)});
+   }
+   // let every update arrive before the first read
+   sleep(1);
+
+   std::string topic;
+   std::vector<std::string> bullets;
+   alien.GetShot(1000, topic, bullets);
+   EXPECT_EQ("price", topic);
+   ASSERT_EQ(1, bullets.size());
+   EXPECT_EQ("99", bullets[0]);
+   alien.GetShot(1000, topic, bullets);
+   EXPECT_EQ("volume", topic);
+   ASSERT_EQ(1, bullets.size());
+   EXPECT_EQ("990", bullets[0]);
+   alien.GetShot(100, topic, bullets);
+   EXPECT_TRUE(bullets.empty());
+}
+
 TEST_F(ShotgunAlienTests, AlienThatCantBeShot) {
    Alien alien;
    std::string location("bad_location");
@@ -2,6 +2,9 @@
 #include "zlib.h"
 #include <time.h>
 #include "boost/thread.hpp"
+#include <map>
+#include <mutex>
+#include <vector>
 
 #include "ZeroMQTests.h"
 #include "MockZeroMQ.h"
@@ -254,6 +257,162 @@ TEST_F(ZeroMQTests, ZeroCopyPacketBroadcasterSendDataToReadyClientPerformanceTes
    free(packet);
 }
 
+TEST_F(ZeroMQTests, PointersAreSentAndReceivedInBatches) {
+   ZeroMQ<void*> serverQueue(3);
+   ASSERT_TRUE(serverQueue.Initialize());
+   ZeroMQ<void*> clientQueue(serverQueue);
+   ASSERT_TRUE(clientQueue.Initialize());
+
+   int values[10];
+   void* packets[10];
+   for (int i = 0; i < 10; i++) {
+      packets[i] = &values[i];
+   }
+   EXPECT_EQ(0, clientQueue.SendPointers(packets, 10));
+   ASSERT_EQ(10, serverQueue.SendPointers(packets, 10));
+
+   void* received[16];
+   EXPECT_EQ(0, serverQueue.GetPointers(received, 16, 0));
+   ASSERT_EQ(4, clientQueue.GetPointers(received, 4, 100));
+   ASSERT_EQ(6, clientQueue.GetPointers(received + 4, 12, 100));
+   for (int i = 0; i < 10; i++) {
+      EXPECT_EQ(packets[i], received[i]);
+   }
+   EXPECT_EQ(0, clientQueue.GetPointers(received, 16, 10));
+
+   // never blocks, stops at the high water mark
+   std::vector<void*> flood(serverQueue.GetHighWater() * 4, packets[0]);
+   const size_t sent = serverQueue.SendPointers(flood.data(), flood.size());
+   EXPECT_LT(0, sent);
+   EXPECT_GT(flood.size(), sent);
+}
+
+TEST_F(ZeroMQTests, ExternalLockSharesTheServerBetweenThreads) {
+   ZeroMQ<void*> serverQueue(4);
+   ASSERT_TRUE(serverQueue.Initialize());
+   ZeroMQ<void*> clientQueue(serverQueue);
+   ASSERT_TRUE(clientQueue.Initialize());
+   std::mutex serverLock;
+   serverQueue.SetExternalLock(&serverLock);
+
+   const int kPerThread = 1000;
+   int value;
+   auto send = [&serverQueue, &value] {
+      for (int i = 0; i < kPerThread; i++) {
+         EXPECT_TRUE(serverQueue.SendPointer(&value));
+      }
+   };
+   boost::thread first(send);
+   boost::thread second(send);
+
+   int received = 0;
+   void* packets[64];
+   for (int polls = 0; received < 2 * kPerThread && polls < 10000; polls++) {
+      const size_t count = clientQueue.GetPointers(packets, 64, 10);
+      for (size_t i = 0; i < count; i++) {
+         EXPECT_EQ(&value, packets[i]);
+      }
+      received += count;
+   }
+   first.join();
+   second.join();
+   EXPECT_EQ(2 * kPerThread, received);
+}
+
+TEST_F(ZeroMQTests, RoutingServerSendsToClientsByIdAndByHash) {
+   ZeroMQ<void*> serverQueue(5);
+   serverQueue.SetRouting(true);
+   ASSERT_TRUE(serverQueue.Initialize());
+   ZeroMQ<void*> firstClient(serverQueue, 1);
+   ZeroMQ<void*> secondClient(serverQueue, 2);
+   ASSERT_TRUE(firstClient.Initialize());
+   ASSERT_TRUE(secondClient.Initialize());
+
+   int value;
+   EXPECT_FALSE(serverQueue.SendPointer(&value));
+   EXPECT_FALSE(serverQueue.SendPointerTo(3, &value));
+   EXPECT_FALSE(serverQueue.SendPointerByHash(0, &value));
+   ASSERT_TRUE(serverQueue.SendPointerTo(2, &value));
+   EXPECT_TRUE(firstClient.GetPointer(10) == NULL);
+   EXPECT_EQ(&value, secondClient.GetPointer(100));
+
+   // registering never blocks, registering twice counts once
+   ASSERT_TRUE(firstClient.SendClientReady());
+   ASSERT_TRUE(secondClient.SendClientReady());
+   ASSERT_TRUE(secondClient.SendClientReady());
+   for (int i = 0; i < 100 && serverQueue.AcceptClients() < 2; i++) {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+   }
+   EXPECT_EQ((std::vector<unsigned int>{1, 2}), serverQueue.GetClients());
+
+   // a flow always lands on the same client
+   const uint64_t kFlows = 100;
+   int flows[kFlows];
+   std::map<void*, ZeroMQ<void*>*> landed;
+   for (int round = 0; round < 2; round++) {
+      for (uint64_t hash = 0; hash < kFlows; hash++) {
+         ASSERT_TRUE(serverQueue.SendPointerByHash(hash, &flows[hash]));
+      }
+      for (auto client : {&firstClient, &secondClient}) {
+         while (void* flow = client->GetPointer(10)) {
+            if (round == 0) {
+               landed[flow] = client;
+            } else {
+               EXPECT_EQ(client, landed[flow]);
+            }
+         }
+      }
+   }
+   EXPECT_EQ(kFlows, landed.size());
+
+   // a client joining only takes flows from the others
+   {
+      ZeroMQ<void*> thirdClient(serverQueue, 3);
+      ASSERT_TRUE(thirdClient.Initialize());
+      ASSERT_TRUE(thirdClient.SendClientReady());
+      for (int i = 0; i < 100 && serverQueue.AcceptClients() < 3; i++) {
+         boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+      }
+      for (uint64_t hash = 0; hash < kFlows; hash++) {
+         ASSERT_TRUE(serverQueue.SendPointerByHash(hash, &flows[hash]));
+      }
+      size_t moved = 0;
+      while (thirdClient.GetPointer(10)) {
+         moved++;
+      }
+      for (auto client : {&firstClient, &secondClient}) {
+         while (void* flow = client->GetPointer(10)) {
+            EXPECT_EQ(client, landed[flow]);
+         }
+      }
+      EXPECT_LT(0, moved);
+      EXPECT_GT(kFlows / 2, moved);
+   }
+
+   // the third client went away and is removed, its flows go back to where
+   // they were
+   EXPECT_TRUE(serverQueue.RemoveClient(3));
+   EXPECT_FALSE(serverQueue.RemoveClient(3));
+   for (uint64_t hash = 0; hash < kFlows; hash++) {
+      ASSERT_TRUE(serverQueue.SendPointerByHash(hash, &flows[hash]));
+   }
+   EXPECT_EQ((std::vector<unsigned int>{1, 2}), serverQueue.GetClients());
+   size_t received = 0;
+   for (auto client : {&firstClient, &secondClient}) {
+      while (void* flow = client->GetPointer(10)) {
+         EXPECT_EQ(client, landed[flow]);
+         received++;
+      }
+   }
+   EXPECT_EQ(kFlows, received);
+
+   EXPECT_TRUE(serverQueue.RemoveClient(1));
+   EXPECT_FALSE(serverQueue.RemoveClient(1));
+   EXPECT_EQ((std::vector<unsigned int>{2}), serverQueue.GetClients());
+   ASSERT_TRUE(serverQueue.SendPointerByHash(0, &flows[0]));
+   EXPECT_EQ(&flows[0], secondClient.GetPointer(100));
+}
+
 TEST_F(ZeroMQTests, ConcequencesOfFailedSetSendHWMOnPointerQueue) {
 #ifdef QN_DEBUG
    MockZeroMQPacket mockServer(1);